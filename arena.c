@@ -0,0 +1,130 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Bump allocator of a run, released at once and reused by the next one.
+ */
+
+#include <stdlib.h>
+#include "arena.h"
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+/* Past this size, the blocks of a run are released instead of kept for the next one */
+#define ARENA_KEPT_MAX (16 * 1024 * 1024)
+
+/* Every allocation is aligned for any type */
+#define ARENA_ALIGN 16
+#define ALIGN_UP(n) (((n) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+#define HEADER_SIZE ALIGN_UP(sizeof(ArenaBlock))
+
+void arena_init(Arena *a)
+{
+    a->blocks = NULL;
+    a->total = 0;
+    a->scratch = NULL;
+    a->scratchLen = 0;
+}
+
+static void free_blocks(Arena *a)
+{
+    ArenaBlock *b, *next;
+
+    for (b = a->blocks; b != NULL; b = next)
+    {
+        next = b->next;
+        free(b);
+    }
+
+    a->blocks = NULL;
+    a->total = 0;
+}
+
+static ArenaBlock *add_block(Arena *a, size_t size)
+{
+    ArenaBlock *b;
+
+    if ((b = malloc(HEADER_SIZE + size)) == NULL)
+        return NULL;
+
+    b->next = a->blocks;
+    b->size = size;
+    b->used = 0;
+    a->blocks = b;
+    a->total += size;
+
+    return b;
+}
+
+void arena_free(Arena *a)
+{
+    free_blocks(a);
+    free(a->scratch);
+    arena_init(a);
+}
+
+void arena_reset(Arena *a)
+{
+    const size_t total = a->total;
+
+    /* A single block is enough for what the previous run needed */
+    if (total > ARENA_KEPT_MAX)
+        free_blocks(a);
+    else if (a->blocks != NULL && a->blocks->next != NULL)
+    {
+        free_blocks(a);
+        add_block(a, total);
+    }
+    else if (a->blocks != NULL)
+        a->blocks->used = 0;
+}
+
+void *arena_alloc(Arena *a, size_t len)
+{
+    ArenaBlock *b = a->blocks;
+    void *p;
+
+    if (len > (size_t)-1 - HEADER_SIZE - ARENA_ALIGN)
+        return NULL;
+
+    len = ALIGN_UP(len > 0 ? len : 1);
+
+    /* Chain a new block, doubling the room so that the blocks stay few */
+    if (b == NULL || b->used + len > b->size)
+    {
+        size_t size = a->total > ARENA_BLOCK_SIZE ? a->total : ARENA_BLOCK_SIZE;
+
+        if (size < len)
+            size = len;
+
+        if ((b = add_block(a, size)) == NULL)
+            return NULL;
+    }
+
+    p = (char*)b + HEADER_SIZE + b->used;
+    b->used += len;
+
+    return p;
+}
+
+void *arena_scratch(Arena *a, size_t len)
+{
+    char *grown;
+    size_t capacity;
+
+    /* The same region is handed out each time, only growing */
+    if (len > a->scratchLen || a->scratch == NULL)
+    {
+        capacity = a->scratchLen > 0 ? a->scratchLen : 256;
+        while (capacity < len)
+            capacity = capacity * 2 > capacity ? capacity * 2 : len;
+
+        if ((grown = realloc(a->scratch, capacity)) == NULL)
+            return NULL;
+
+        a->scratch = grown;
+        a->scratchLen = capacity;
+    }
+
+    return a->scratch;
+}
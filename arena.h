@@ -0,0 +1,35 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Bump allocator of a run, released at once and reused by the next one.
+ */
+
+#ifndef ARENA_H_INCLUDED
+#define ARENA_H_INCLUDED
+
+#include <stddef.h>
+
+typedef struct ArenaBlock
+{
+    struct ArenaBlock *next;
+    size_t size;
+    size_t used;
+} ArenaBlock;
+
+typedef struct Arena
+{
+    ArenaBlock *blocks;
+    size_t total;
+    char *scratch;
+    size_t scratchLen;
+} Arena;
+
+void arena_init(Arena *a);
+void arena_free(Arena *a);
+void arena_reset(Arena *a);
+
+void *arena_alloc(Arena *a, size_t len);
+void *arena_scratch(Arena *a, size_t len);
+
+#endif
@@ -0,0 +1,220 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Multi-pattern matching automaton (Aho-Corasick) built from the searches.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "automaton.h"
+#include "report.h"
+
+#define NEXT(ac, s, c) (ac)->next[(size_t)(s) * (ac)->classCount + (ac)->classes[(unsigned char)(c)]]
+
+static void automaton_zero(Automaton *ac)
+{
+    ac->classCount = 0;
+    ac->stateCount = 0;
+    ac->next = NULL;
+    ac->dict = NULL;
+    ac->depth = NULL;
+    ac->out = NULL;
+}
+
+int automaton_build(Automaton *ac, const Rule *rules, size_t count)
+{
+    size_t i, j, maxStates = 1, head = 0, tail = 0;
+    uint32_t *fail = NULL, *queue = NULL;
+
+    automaton_zero(ac);
+
+    /* Only the characters used by the searches need their own class, the others share the class 0 */
+    memset(ac->classes, 0, sizeof(ac->classes));
+    ac->classCount = 1;
+    for (i = 0; i < count; i++)
+    {
+        for (j = 0; j < rules[i].searchLen; j++)
+        {
+            const unsigned char c = (unsigned char)rules[i].search[j];
+
+            if (ac->classes[c] == 0)
+                ac->classes[c] = (uint16_t)ac->classCount++;
+        }
+        maxStates += rules[i].searchLen;
+    }
+
+    /* Allocate for the worst case where no prefix is shared */
+    ac->next = calloc(maxStates * ac->classCount, sizeof(uint32_t));
+    ac->dict = calloc(maxStates, sizeof(uint32_t));
+    ac->depth = calloc(maxStates, sizeof(uint32_t));
+    ac->out = malloc(maxStates * sizeof(long));
+    fail = calloc(maxStates, sizeof(uint32_t));
+    queue = malloc(maxStates * sizeof(uint32_t));
+
+    if (ac->next == NULL || ac->dict == NULL || ac->depth == NULL || ac->out == NULL || fail == NULL || queue == NULL)
+    {
+        report_error("Failed to allocate memory for the matching automaton: %s!\n", strerror(errno));
+        free(fail);
+        free(queue);
+        automaton_free(ac);
+        return 0;
+    }
+
+    /* Build the trie of the searches, the root being the state 0 */
+    ac->out[0] = -1;
+    ac->stateCount = 1;
+    for (i = 0; i < count; i++)
+    {
+        uint32_t s = 0;
+
+        for (j = 0; j < rules[i].searchLen; j++)
+        {
+            uint32_t *t = &NEXT(ac, s, rules[i].search[j]);
+
+            if (*t == 0)
+            {
+                *t = (uint32_t)ac->stateCount;
+                ac->depth[ac->stateCount] = ac->depth[s] + 1;
+                ac->out[ac->stateCount] = -1;
+                ac->stateCount++;
+            }
+            s = *t;
+        }
+
+        /* With duplicated searches, the first rule keeps the priority */
+        if (ac->out[s] < 0)
+            ac->out[s] = (long)i;
+    }
+
+    /* Compute the failure links breadth-first and complete the transitions with them */
+    queue[tail++] = 0;
+    while (head < tail)
+    {
+        const uint32_t s = queue[head++];
+
+        for (j = 0; j < ac->classCount; j++)
+        {
+            uint32_t *t = &ac->next[(size_t)s * ac->classCount + j];
+
+            if (*t != 0 && ac->depth[*t] == ac->depth[s] + 1)
+            {
+                const uint32_t f = s == 0 ? 0 : ac->next[(size_t)fail[s] * ac->classCount + j];
+
+                fail[*t] = f;
+
+                /* Link to the longest suffix reporting a match */
+                ac->dict[*t] = ac->out[f] >= 0 ? f : ac->dict[f];
+                queue[tail++] = *t;
+            }
+            else if (s != 0)
+                *t = ac->next[(size_t)fail[s] * ac->classCount + j];
+        }
+    }
+
+    free(fail);
+    free(queue);
+
+    return 1;
+}
+
+void automaton_free(Automaton *ac)
+{
+    free(ac->next);
+    free(ac->dict);
+    free(ac->depth);
+    free(ac->out);
+    automaton_zero(ac);
+}
+
+int hits_push(HitList *hits, size_t rule, size_t position)
+{
+    if (hits->count >= hits->capacity)
+    {
+        const size_t capacity = hits->capacity == 0 ? 64 : hits->capacity * 2;
+        Hit *grown;
+
+        if ((grown = realloc(hits->hits, capacity * sizeof(Hit))) == NULL)
+            return 0;
+
+        hits->hits = grown;
+        hits->capacity = capacity;
+    }
+
+    hits->hits[hits->count].rule = rule;
+    hits->hits[hits->count].position = position;
+    hits->count++;
+
+    return 1;
+}
+
+int automaton_scan(const Automaton *ac, const char *str, size_t len, size_t *strLen, HitList *hits)
+{
+    size_t i;
+    uint32_t s = 0, o;
+
+    /* Drive the automaton over the string until its termination, reporting every match */
+    for (i = 0; i < len && str[i] != 0; i++)
+    {
+        s = NEXT(ac, s, str[i]);
+
+        for (o = ac->out[s] >= 0 ? s : ac->dict[s]; o != 0; o = ac->dict[o])
+        {
+            if (!hits_push(hits, (size_t)ac->out[o], i + 1 - ac->depth[o]))
+                return 0;
+        }
+    }
+
+    *strLen = i;
+
+    return 1;
+}
+
+int automaton_feed(const Automaton *ac, const char *str, size_t len, HitList *hits)
+{
+    size_t i;
+    uint32_t s = 0, o;
+
+    /* Drive the automaton over all the bytes, the null ones being part of the strings (UTF-16) */
+    for (i = 0; i < len; i++)
+    {
+        s = NEXT(ac, s, str[i]);
+
+        for (o = ac->out[s] >= 0 ? s : ac->dict[s]; o != 0; o = ac->dict[o])
+        {
+            if (!hits_push(hits, (size_t)ac->out[o], i + 1 - ac->depth[o]))
+                return 0;
+        }
+    }
+
+    return 1;
+}
+
+long automaton_match_whole(const Automaton *ac, const char *str, size_t len, size_t *strLen)
+{
+    size_t i;
+    uint32_t s = 0;
+
+    for (i = 0; i < len && str[i] != 0; i++)
+        s = NEXT(ac, s, str[i]);
+
+    *strLen = i;
+
+    /* The whole string matches only if the state spells it entirely */
+    return ac->depth[s] == i ? ac->out[s] : -1;
+}
+
+void hits_init(HitList *hits)
+{
+    hits->hits = NULL;
+    hits->count = 0;
+    hits->capacity = 0;
+}
+
+void hits_free(HitList *hits)
+{
+    free(hits->hits);
+    hits_init(hits);
+}
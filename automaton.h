@@ -0,0 +1,51 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Multi-pattern matching automaton (Aho-Corasick) built from the searches.
+ */
+
+#ifndef AUTOMATON_H_INCLUDED
+#define AUTOMATON_H_INCLUDED
+
+#include <stdint.h>
+#include "rules.h"
+
+/* Deterministic automaton, the transitions are indexed by classes of characters */
+typedef struct Automaton
+{
+    uint16_t classes[256];
+    size_t classCount;
+    size_t stateCount;
+    uint32_t *next;
+    uint32_t *dict;
+    uint32_t *depth;
+    long *out;
+} Automaton;
+
+/* A match of a rule, located by its start in the string */
+typedef struct Hit
+{
+    size_t rule;
+    size_t position;
+} Hit;
+
+typedef struct HitList
+{
+    Hit *hits;
+    size_t count;
+    size_t capacity;
+} HitList;
+
+int automaton_build(Automaton *ac, const Rule *rules, size_t count);
+void automaton_free(Automaton *ac);
+
+int automaton_scan(const Automaton *ac, const char *str, size_t len, size_t *strLen, HitList *hits);
+int automaton_feed(const Automaton *ac, const char *str, size_t len, HitList *hits);
+long automaton_match_whole(const Automaton *ac, const char *str, size_t len, size_t *strLen);
+
+void hits_init(HitList *hits);
+void hits_free(HitList *hits);
+int hits_push(HitList *hits, size_t rule, size_t position);
+
+#endif
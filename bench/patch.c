@@ -0,0 +1,403 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Benchmark of the program over synthetic ELF and PE executables.
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#define DEFAULT_SIZE 16
+#define DEFAULT_SECTIONS 16
+#define DEFAULT_LENGTH 24
+#define DEFAULT_FILES 16
+#define ROUNDS 3
+
+/* Found once in every few strings, whole or within a longer one */
+#define SEARCH "Old Company"
+#define REPLACE "New Company"
+#define MATCH_EVERY 32
+
+/* The rules of the batch, and those undoing them */
+#define RULES SEARCH "\t" REPLACE "\nabc\tABC\n"
+#define RULES_BACK REPLACE "\t" SEARCH "\nABC\tabc\n"
+
+#define FILLER_SIZE 256
+#define PE_IMAGE_BASE 0x140000000ull
+
+/* The shape of the generated executables */
+typedef struct Format
+{
+    const char *name;
+    int elf;
+    int bits64;
+    int bigEndian;
+} Format;
+
+static const Format formats[] = {
+    { "elf32-lsb", 1, 0, 0 },
+    { "elf32-msb", 1, 0, 1 },
+    { "elf64-lsb", 1, 1, 0 },
+    { "elf64-msb", 1, 1, 1 },
+    { "pe32+",     0, 1, 0 }
+};
+
+static void put(unsigned char *p, unsigned long long value, size_t len, int bigEndian)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++)
+        p[bigEndian ? len - 1 - i : i] = (unsigned char)(value >> (8 * i));
+}
+
+/* Fill the strings table with strings of lengths spread around the mean, some of them holding the search */
+static size_t generate(unsigned char *data, size_t len, size_t mean)
+{
+    static const char letters[] = "abcdefghijklmnopqrstuvwxyz      %/.-";
+    const size_t searchLen = sizeof(SEARCH) - 1;
+    size_t i = 0, count = 0, l, k;
+
+    srand(42);
+    while (i + 1 < len)
+    {
+        const int kind = rand() % MATCH_EVERY;
+
+        l = 1 + (size_t)rand() % (2 * mean - 1);
+        if (kind == 0)
+            l = searchLen;
+        else if (kind == 1 && l < searchLen + 2)
+            l = searchLen + 2;
+        if (i + l + 1 > len)
+            l = len - i - 1;
+
+        for (k = 0; k < l; k++)
+            data[i + k] = (unsigned char)letters[rand() % (sizeof(letters) - 1)];
+
+        /* Either the whole string, or within another one */
+        if ((kind == 0 || kind == 1) && l >= searchLen)
+            memcpy(&data[i + (kind == 1 ? 1 : 0)], SEARCH, searchLen);
+
+        i += l;
+        data[i++] = 0;
+        count++;
+
+        /* Some strings are followed by an alignment padding */
+        while (i < len && (i & 3) != 0 && rand() % 2)
+            data[i++] = 0;
+    }
+
+    return count;
+}
+
+static int write_file(const char *path, const unsigned char *data, size_t len)
+{
+    FILE *f;
+    int ok;
+
+    if ((f = fopen(path, "wb")) == NULL)
+        return 0;
+
+    ok = fwrite(data, len, 1, f) == 1;
+
+    return fclose(f) == 0 && ok;
+}
+
+/* Strings table first, then the filler sections, the names and the section table (as laid out by the linkers) */
+static unsigned char *build_elf(const Format *fmt, const unsigned char *strings, size_t stringsLen, size_t sections, size_t *len)
+{
+    const size_t headerLen = fmt->bits64 ? 64 : 52, entryLen = fmt->bits64 ? 64 : 40;
+    const size_t count = sections + 3;
+    const int be = fmt->bigEndian;
+    size_t namesOffset, namesLen, tableOffset, i, offset;
+    unsigned char *elf, *e;
+    char name[32];
+
+    namesLen = 1 + sizeof(".rodata") + sizeof(".shstrtab") + sections * 16;
+    namesOffset = 0x1000 + stringsLen + sections * FILLER_SIZE;
+    tableOffset = (namesOffset + namesLen + 7) & ~(size_t)7;
+    *len = tableOffset + count * entryLen;
+
+    if ((elf = calloc(*len, 1)) == NULL)
+        return NULL;
+
+    /* Identification and executable header */
+    memcpy(elf, "\x7f" "ELF", 4);
+    elf[4] = fmt->bits64 ? 2 : 1;
+    elf[5] = be ? 2 : 1;
+    elf[6] = 1;
+    put(&elf[0x10], 2, 2, be);
+    put(&elf[0x12], fmt->bits64 ? 62 : 3, 2, be);
+    put(&elf[0x14], 1, 4, be);
+    if (fmt->bits64)
+    {
+        put(&elf[0x28], tableOffset, 8, be);
+        put(&elf[0x34], headerLen, 2, be);
+        put(&elf[0x3a], entryLen, 2, be);
+        put(&elf[0x3c], count, 2, be);
+        put(&elf[0x3e], count - 1, 2, be);
+    }
+    else
+    {
+        put(&elf[0x20], tableOffset, 4, be);
+        put(&elf[0x28], headerLen, 2, be);
+        put(&elf[0x2e], entryLen, 2, be);
+        put(&elf[0x30], count, 2, be);
+        put(&elf[0x32], count - 1, 2, be);
+    }
+
+    memcpy(&elf[0x1000], strings, stringsLen);
+
+    /* Names of the sections, the first entry being left empty */
+    offset = namesOffset + 1;
+    for (i = 1; i < count; i++)
+    {
+        const size_t size = i == 1 ? stringsLen : (i + 1 < count ? FILLER_SIZE : namesLen);
+        const size_t at = i == 1 ? 0x1000 : (i + 1 < count ? 0x1000 + stringsLen + (i - 2) * FILLER_SIZE : namesOffset);
+
+        if (i == 1)
+            strcpy(name, ".rodata");
+        else if (i + 1 < count)
+            sprintf(name, ".data.%lu", (unsigned long)(i - 2));
+        else
+            strcpy(name, ".shstrtab");
+
+        e = &elf[tableOffset + i * entryLen];
+        put(e, offset - namesOffset, 4, be);
+        put(&e[4], i + 1 < count ? 1 : 3, 4, be);
+        if (fmt->bits64)
+        {
+            put(&e[8], i + 1 < count ? 0x2 : 0, 8, be);
+            put(&e[16], i + 1 < count ? 0x400000 + at : 0, 8, be);
+            put(&e[24], at, 8, be);
+            put(&e[32], size, 8, be);
+        }
+        else
+        {
+            put(&e[8], i + 1 < count ? 0x2 : 0, 4, be);
+            put(&e[12], i + 1 < count ? 0x8000000 + at : 0, 4, be);
+            put(&e[16], at, 4, be);
+            put(&e[20], size, 4, be);
+        }
+
+        strcpy((char*)&elf[offset], name);
+        offset += strlen(name) + 1;
+    }
+
+    return elf;
+}
+
+/* Headers first, then the strings table and the filler sections */
+static unsigned char *build_pe(const unsigned char *strings, size_t stringsLen, size_t sections, size_t *len)
+{
+    const size_t count = sections + 1, headerAt = 0x80;
+    const size_t tableAt = headerAt + 24 + 240;
+    const size_t dataAt = (tableAt + count * 40 + 0x1ff) & ~(size_t)0x1ff;
+    size_t i, at;
+    unsigned char *pe, *e;
+    char name[16];
+
+    *len = dataAt + stringsLen + sections * FILLER_SIZE;
+    if ((pe = calloc(*len, 1)) == NULL)
+        return NULL;
+
+    memcpy(pe, "MZ", 2);
+    put(&pe[0x3c], headerAt, 4, 0);
+
+    /* Signature, file header (AMD64) and the start of the PE32+ optional header */
+    memcpy(&pe[headerAt], "PE\0\0", 4);
+    put(&pe[headerAt + 4], 0x8664, 2, 0);
+    put(&pe[headerAt + 6], count, 2, 0);
+    put(&pe[headerAt + 20], 240, 2, 0);
+    put(&pe[headerAt + 22], 0x22, 2, 0);
+    put(&pe[headerAt + 24], 0x20b, 2, 0);
+    put(&pe[headerAt + 24 + 24], PE_IMAGE_BASE, 8, 0);
+
+    memcpy(&pe[dataAt], strings, stringsLen);
+
+    for (i = 0; i < count; i++)
+    {
+        const size_t size = i == 0 ? stringsLen : FILLER_SIZE;
+
+        at = i == 0 ? dataAt : dataAt + stringsLen + (i - 1) * FILLER_SIZE;
+        if (i == 0)
+            strcpy(name, ".rdata");
+        else
+            sprintf(name, ".d%lu", (unsigned long)(i - 1));
+
+        /* Initialized data, readable (the name fills the 8 bytes without termination, the header being zeroed) */
+        e = &pe[tableAt + i * 40];
+        memcpy(e, name, strlen(name) < 8 ? strlen(name) : 8);
+        put(&e[8], size, 4, 0);
+        put(&e[12], 0x1000 + at, 4, 0);
+        put(&e[16], size, 4, 0);
+        put(&e[20], at, 4, 0);
+        put(&e[36], 0x40000040, 4, 0);
+    }
+
+    return pe;
+}
+
+static double now(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+/* Run a command several times keeping the best time, the replacements being undone after each run */
+static double run(const char *command, const char *undo)
+{
+    double best = 0, start, elapsed;
+    int r;
+
+    for (r = 0; r < ROUNDS; r++)
+    {
+        start = now();
+        if (system(command) != 0)
+            return -1;
+        elapsed = now() - start;
+
+        if (undo != NULL && system(undo) != 0)
+            return -1;
+
+        if (r == 0 || elapsed < best)
+            best = elapsed;
+    }
+
+    return best;
+}
+
+static void report(const char *format, const char *operation, double seconds, size_t len, size_t strings)
+{
+    if (seconds < 0)
+    {
+        printf("%-10s %-8s %12s\n", format, operation, "failed");
+        return;
+    }
+
+    printf("%-10s %-8s %12.1f MB/s %10.1f ns/string\n", format, operation,
+        seconds > 0 ? (double)len / seconds / 1e6 : 0.0, strings > 0 ? seconds * 1e9 / (double)strings : 0.0);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *program = argc > 1 ? argv[1] : "./string-patch";
+    const size_t len = (size_t)(argc > 2 ? atol(argv[2]) : DEFAULT_SIZE) * 1024 * 1024;
+    const size_t sections = (size_t)(argc > 3 ? atol(argv[3]) : DEFAULT_SECTIONS);
+    const size_t mean = (size_t)(argc > 4 && atol(argv[4]) > 0 ? atol(argv[4]) : DEFAULT_LENGTH);
+    const size_t files = (size_t)(argc > 5 && atol(argv[5]) > 0 ? atol(argv[5]) : DEFAULT_FILES);
+    char dir[64], path[128], out[128], rules[128], rulesBack[128], command[1024], undo[1024];
+    unsigned char *strings, *exe;
+    size_t count, exeLen, f, i;
+    int ret = 0;
+
+    if (len == 0 || sections > 60000)
+    {
+        fputs("Usage: patch-bench [<program>] [<MB of strings>] [<other sections (up to 60000)>] [<mean string length>] [<files of the batch>]\n", stderr);
+        return 1;
+    }
+
+    if ((strings = malloc(len)) == NULL)
+    {
+        fputs("Failed to allocate the strings table!\n", stderr);
+        return 1;
+    }
+    count = generate(strings, len, mean);
+
+    /* The executables are written in a directory of their own, removed afterwards */
+    sprintf(dir, "string-patch-bench.%ld", (long)getpid());
+    if (mkdir(dir, 0700) != 0)
+    {
+        fputs("Failed to create the directory of the executables!\n", stderr);
+        free(strings);
+        return 1;
+    }
+    sprintf(out, "%s/out", dir);
+    sprintf(rules, "%s/rules", dir);
+    sprintf(rulesBack, "%s/rules.back", dir);
+
+    printf("Patching %lu MB of strings (%lu strings of %lu bytes on average) along %lu other sections, best of %d rounds\n",
+        (unsigned long)(len / 1024 / 1024), (unsigned long)count, (unsigned long)mean, (unsigned long)sections, ROUNDS);
+
+    for (f = 0; f < sizeof(formats) / sizeof(formats[0]) && ret == 0; f++)
+    {
+        const Format *fmt = &formats[f];
+
+        exe = fmt->elf ? build_elf(fmt, strings, len, sections, &exeLen) : build_pe(strings, len, sections, &exeLen);
+        sprintf(path, "%s/%s", dir, fmt->name);
+        if (exe == NULL || !write_file(path, exe, exeLen))
+        {
+            fputs("Failed to write the executable!\n", stderr);
+            free(exe);
+            ret = 1;
+            break;
+        }
+        free(exe);
+
+        sprintf(command, "%s %s > /dev/null", program, path);
+        report(fmt->name, "list", run(command, NULL), len, count);
+
+        sprintf(command, "%s -e %s \"%s\" \"%s\" > /dev/null", program, path, SEARCH, REPLACE);
+        sprintf(undo, "%s -e %s \"%s\" \"%s\" > /dev/null", program, path, REPLACE, SEARCH);
+        report(fmt->name, "exact", run(command, undo), len, count);
+
+        sprintf(command, "%s %s \"%s\" \"%s\" > /dev/null", program, path, SEARCH, REPLACE);
+        sprintf(undo, "%s %s \"%s\" \"%s\" > /dev/null", program, path, REPLACE, SEARCH);
+        report(fmt->name, "lenient", run(command, undo), len, count);
+
+        sprintf(command, "%s -o %s %s \"%s\" \"%s\" > /dev/null", program, out, path, SEARCH, REPLACE);
+        report(fmt->name, "copy", run(command, NULL), len, count);
+
+        remove(out);
+        remove(path);
+    }
+
+    /* Several files patched by a single run, with several rules */
+    if (ret == 0)
+    {
+        exe = build_elf(&formats[2], strings, len, sections, &exeLen);
+        for (i = 0; i < files && exe != NULL && ret == 0; i++)
+        {
+            sprintf(path, "%s/batch.%lu", dir, (unsigned long)i);
+            if (!write_file(path, exe, exeLen))
+                ret = 1;
+        }
+
+        if (exe == NULL || ret != 0 || !write_file(rules, (const unsigned char*)RULES, sizeof(RULES) - 1) ||
+            !write_file(rulesBack, (const unsigned char*)RULES_BACK, sizeof(RULES_BACK) - 1))
+        {
+            fputs("Failed to write the executables!\n", stderr);
+            ret = 1;
+        }
+        else
+        {
+            sprintf(command, "%s -r %s %s/batch.* > /dev/null", program, rules, dir);
+            sprintf(undo, "%s -r %s %s/batch.* > /dev/null", program, rulesBack, dir);
+            report("batch", "rules", run(command, undo), len * files, count * files);
+        }
+        free(exe);
+
+        for (i = 0; i < files; i++)
+        {
+            sprintf(path, "%s/batch.%lu", dir, (unsigned long)i);
+            remove(path);
+        }
+        remove(rules);
+        remove(rulesBack);
+    }
+
+    rmdir(dir);
+    free(strings);
+
+    return ret;
+}
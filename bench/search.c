@@ -0,0 +1,221 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Microbenchmark of the string searches over a synthetic strings table.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../rules.h"
+#include "../automaton.h"
+#include "../search.h"
+#include "../scan.h"
+
+#define DEFAULT_SIZE 64
+#define ROUNDS 4
+
+/* Former matcher (restarting on a mismatch), kept as a reference */
+static size_t scan_restart(const char *data, const char *search, size_t searchLen, size_t len)
+{
+    size_t i, c = 0, count = 0;
+
+    for (i = 0; i < len; i++)
+    {
+        if (data[i] == search[c])
+            c++;
+        else
+            c = 0;
+
+        if (c >= searchLen)
+        {
+            c = 0;
+            count++;
+        }
+    }
+
+    return count;
+}
+
+static size_t scan_needle(const char *data, const Needle *needle, size_t len)
+{
+    const char *p;
+    size_t i = 0, count = 0;
+
+    while (i < len && (p = needle_find(needle, &data[i], len - i)) != NULL)
+    {
+        i = (size_t)(p - data) + needle->len;
+        count++;
+    }
+
+    return count;
+}
+
+static size_t scan_automaton(const char *data, const Automaton *ac, size_t len, HitList *hits)
+{
+    size_t i = 0, curLen = 1, count = 0;
+
+    while (i < len)
+    {
+        if (data[i] == 0)
+        {
+            i++;
+            continue;
+        }
+
+        hits->count = 0;
+        automaton_scan(ac, &data[i], len - i, &curLen, hits);
+        count += hits->count;
+        i += curLen;
+    }
+
+    return count;
+}
+
+/* Former walk through the strings (one byte at a time), kept as a reference */
+static size_t strings_bytewise(const char *data, size_t len)
+{
+    size_t i, l = 0, count = 0;
+
+    for (i = 0; i < len; i++)
+    {
+        if (data[i] == 0)
+        {
+            if (l > 0)
+                count++;
+            l = 0;
+        }
+        else
+            l++;
+    }
+
+    return count;
+}
+
+static size_t strings_scan(const char *data, size_t len)
+{
+    size_t i = 0, l, count = 0;
+
+    while (i < len)
+    {
+        i += scan_skip(&data[i], len - i, 0);
+        l = scan_find(&data[i], len - i, 0);
+        if (i + l >= len)
+            break;
+
+        count++;
+        i += l;
+    }
+
+    return count;
+}
+
+/* Fill the table with words looking like the ones of an usual .rodata */
+static void generate(char *data, size_t len)
+{
+    static const char *const words[] = {
+        "error", "failed", "to", "open", "the", "file", "%s", "invalid", "argument",
+        "/usr/lib", "config", "version", "aaab", "warning", "memory", "%d", "of", "unknown"
+    };
+    size_t i = 0;
+
+    srand(42);
+    while (i < len)
+    {
+        const int n = 1 + rand() % 8;
+        int w;
+
+        for (w = 0; w < n && i < len; w++)
+        {
+            const char *word = words[rand() % (sizeof(words) / sizeof(words[0]))];
+            size_t l = strlen(word);
+
+            if (i + l + 1 > len)
+                l = len - i - 1;
+
+            memcpy(&data[i], word, l);
+            i += l;
+            if (i < len)
+                data[i++] = w + 1 < n ? ' ' : 0;
+        }
+
+        /* Some strings are followed by an alignment padding */
+        while (i < len && (i & 3) != 0 && rand() % 2)
+            data[i++] = 0;
+    }
+}
+
+static void report(const char *name, clock_t elapsed, size_t len, size_t count)
+{
+    const double seconds = (double)elapsed / CLOCKS_PER_SEC / ROUNDS;
+
+    printf("%-12s %10.1f MB/s %10lu found\n", name, seconds > 0 ? (double)len / seconds / 1e6 : 0.0, (unsigned long)count);
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t len = (size_t)(argc > 1 ? atol(argv[1]) : DEFAULT_SIZE) * 1024 * 1024;
+    const char *search = argc > 2 ? argv[2] : "aab";
+    size_t count = 0;
+    char *data;
+    RuleSet rules;
+    Automaton ac;
+    Needle needle;
+    HitList hits;
+    clock_t start;
+    int r;
+
+    scan_init();
+
+    if ((data = malloc(len)) == NULL)
+    {
+        fputs("Failed to allocate the strings table!\n", stderr);
+        return 1;
+    }
+    generate(data, len);
+
+    rules_init(&rules);
+    rules_add(&rules, search, "");
+    automaton_build(&ac, rules.rules, rules.count);
+    needle_init(&needle, rules.rules[0].search, rules.rules[0].searchLen);
+    hits_init(&hits);
+
+    printf("Searching \"%s\" in %lu MB\n", search, (unsigned long)(len / 1024 / 1024));
+
+    start = clock();
+    for (r = 0; r < ROUNDS; r++)
+        count = scan_restart(data, search, strlen(search), len);
+    report("restart", clock() - start, len, count);
+
+    start = clock();
+    for (r = 0; r < ROUNDS; r++)
+        count = scan_needle(data, &needle, len);
+    report("kmp+memchr", clock() - start, len, count);
+
+    start = clock();
+    for (r = 0; r < ROUNDS; r++)
+        count = scan_automaton(data, &ac, len, &hits);
+    report("automaton", clock() - start, len, count);
+
+    puts("Walking through the strings");
+
+    start = clock();
+    for (r = 0; r < ROUNDS; r++)
+        count = strings_bytewise(data, len);
+    report("bytewise", clock() - start, len, count);
+
+    start = clock();
+    for (r = 0; r < ROUNDS; r++)
+        count = strings_scan(data, len);
+    report("scan", clock() - start, len, count);
+
+    hits_free(&hits);
+    needle_free(&needle);
+    automaton_free(&ac);
+    rules_free(&rules);
+    free(data);
+
+    return 0;
+}
@@ -0,0 +1,634 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Persistent index of the sections and their strings, kept in a cache directory.
+ */
+
+#define _GNU_SOURCE
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "cache.h"
+#include "report.h"
+
+#define CACHE_MAGIC "SPINDEX4"
+
+/* Only the beginning of the file is hashed (along with its size and time), hashing it all would cost a full read */
+#define HASHED_PREFIX (64 * 1024)
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME  0x100000001b3ULL
+
+/* The strings are stored as three 64 bits fields, sorted by length then offset */
+#define RECORD_SIZE 24
+#define COPY_RECORDS 4096
+
+#define NOT_INDEXED ((uint64_t)-1)
+
+/* Reads or writes the fields of an index while hashing them */
+typedef struct Stream
+{
+    FILE *file;
+    uint64_t hash;
+    int ok;
+} Stream;
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t len)
+{
+    const unsigned char *p = data;
+    size_t i;
+
+    /* FNV-1a */
+    for (i = 0; i < len; i++)
+        hash = (hash ^ p[i]) * FNV_PRIME;
+
+    return hash;
+}
+
+static void stream_init(Stream *s, FILE *file)
+{
+    s->file = file;
+    s->hash = FNV_OFFSET;
+    s->ok = 1;
+}
+
+static void read_bytes(Stream *s, void *data, size_t len)
+{
+    if (s->ok && len > 0)
+    {
+        s->ok = fread(data, len, 1, s->file) == 1;
+        s->hash = hash_bytes(s->hash, data, len);
+    }
+}
+
+static uint64_t read_u64(Stream *s)
+{
+    uint64_t value = 0;
+
+    read_bytes(s, &value, sizeof(value));
+
+    return value;
+}
+
+static void write_bytes(Stream *s, const void *data, size_t len)
+{
+    if (s->ok && len > 0)
+    {
+        s->hash = hash_bytes(s->hash, data, len);
+        s->ok = fwrite(data, len, 1, s->file) == 1;
+    }
+}
+
+static void write_u64(Stream *s, uint64_t value)
+{
+    write_bytes(s, &value, sizeof(value));
+}
+
+static int compute_key(CacheKey *key, FILE *f)
+{
+    struct stat st;
+    char *buffer;
+    size_t r;
+
+    if (fstat(fileno(f), &st) != 0)
+        return 0;
+
+    key->size = (uint64_t)st.st_size;
+    key->mtime = (uint64_t)st.st_mtime;
+#ifdef __linux__
+    key->mtimeNsec = (uint64_t)st.st_mtim.tv_nsec;
+#else
+    key->mtimeNsec = 0;
+#endif
+
+    if ((buffer = malloc(HASHED_PREFIX)) == NULL || fseek(f, 0, SEEK_SET) != 0)
+    {
+        free(buffer);
+        return 0;
+    }
+
+    r = fread(buffer, 1, HASHED_PREFIX, f);
+    key->hash = hash_bytes(FNV_OFFSET, buffer, r);
+    free(buffer);
+
+    return !ferror(f);
+}
+
+static char *index_path(const char *dir, const char *filename)
+{
+    static const char digits[] = "0123456789abcdef";
+    char *absolute, *path;
+    uint64_t hash;
+    size_t i, len = strlen(dir);
+
+    /* The index is named after the absolute path of the file */
+#ifdef _WIN32
+    absolute = _fullpath(NULL, filename, 0);
+#else
+    absolute = realpath(filename, NULL);
+#endif
+    hash = hash_bytes(FNV_OFFSET, absolute != NULL ? absolute : filename, strlen(absolute != NULL ? absolute : filename));
+    free(absolute);
+
+    if ((path = malloc(len + 1 + 16 + sizeof(".idx"))) == NULL)
+        return NULL;
+
+    memcpy(path, dir, len);
+    path[len++] = '/';
+    for (i = 0; i < 16; i++)
+        path[len++] = digits[(hash >> (60 - i * 4)) & 0xf];
+    strcpy(&path[len], ".idx");
+
+    return path;
+}
+
+static void release(Cache *c)
+{
+    size_t i;
+
+    if (c->indexes != NULL)
+    {
+        for (i = 0; i < c->table.count; i++)
+            strindex_free(&c->indexes[i]);
+    }
+
+    free(c->indexes);
+    free(c->stored);
+    free(c->positions);
+    sections_free(&c->table);
+
+    c->indexes = NULL;
+    c->stored = NULL;
+    c->positions = NULL;
+    c->hasSections = 0;
+}
+
+static int alloc_sections(Cache *c)
+{
+    const size_t count = c->table.count > 0 ? c->table.count : 1;
+    size_t i;
+
+    c->indexes = malloc(count * sizeof(StringIndex));
+    c->stored = malloc(count * sizeof(uint64_t));
+    c->positions = malloc(count * sizeof(uint64_t));
+
+    if (c->indexes == NULL || c->stored == NULL || c->positions == NULL)
+        return 0;
+
+    for (i = 0; i < c->table.count; i++)
+    {
+        strindex_init(&c->indexes[i]);
+        c->stored[i] = NOT_INDEXED;
+        c->positions[i] = 0;
+    }
+
+    c->hasSections = 1;
+
+    return 1;
+}
+
+static int read_sections(Stream *s, SectionTable *table)
+{
+    char *name;
+    size_t i, nameLen;
+
+    table->nameMax = (size_t)read_u64(s);
+    table->count = (size_t)read_u64(s);
+
+    /* An absurd count means the index is damaged */
+    if (!s->ok || table->count > 65536)
+        return 0;
+
+    if ((table->sections = calloc(table->count > 0 ? table->count : 1, sizeof(Section))) == NULL)
+        return 0;
+
+    for (i = 0; i < table->count && s->ok; i++)
+    {
+        Section *sec = &table->sections[i];
+
+        /* The names are kept terminated in the index */
+        nameLen = (size_t)read_u64(s);
+        if (!s->ok || nameLen == 0 || nameLen > 4096 || (name = malloc(nameLen)) == NULL)
+            return 0;
+
+        read_bytes(s, name, nameLen);
+        name[nameLen - 1] = 0;
+        sec->name = name;
+
+        sec->offset = (long)read_u64(s);
+        sec->size = (size_t)read_u64(s);
+        sec->memSize = read_u64(s);
+        sec->address = read_u64(s);
+        sec->type = (uint32_t)read_u64(s);
+        sec->flags = read_u64(s);
+    }
+
+    return s->ok;
+}
+
+static void free_names(SectionTable *table)
+{
+    size_t i;
+
+    for (i = 0; i < table->count && table->sections != NULL; i++)
+        free((void*)table->sections[i].name);
+
+    free(table->sections);
+}
+
+static void load(Cache *c)
+{
+    char magic[sizeof(CACHE_MAGIC) - 1];
+    SectionTable table;
+    Stream s;
+    uint64_t checksum;
+    size_t i;
+
+    if ((c->file = fopen(c->path, "rb")) == NULL)
+        return;
+
+    /* Only the table of the sections and the location of their strings are read upfront */
+    stream_init(&s, c->file);
+    read_bytes(&s, magic, sizeof(magic));
+
+    /* An index of another version of the file is worthless */
+    if (!s.ok || memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0 ||
+        read_u64(&s) != c->key.size || read_u64(&s) != c->key.mtime || read_u64(&s) != c->key.mtimeNsec || read_u64(&s) != c->key.hash || !s.ok)
+    {
+        fclose(c->file);
+        c->file = NULL;
+        return;
+    }
+
+    table.sections = NULL;
+    table.count = 0;
+    if (read_sections(&s, &table) && sections_copy(&c->table, &table) && alloc_sections(c))
+    {
+        for (i = 0; i < c->table.count; i++)
+        {
+            c->stored[i] = read_u64(&s);
+            c->positions[i] = read_u64(&s);
+        }
+
+        /* The header ends with its hash, in case it was damaged */
+        checksum = s.hash;
+        if (read_u64(&s) != checksum || !s.ok)
+            release(c);
+    }
+    else
+        release(c);
+
+    free_names(&table);
+
+    if (!c->hasSections)
+    {
+        fclose(c->file);
+        c->file = NULL;
+    }
+}
+
+static int read_record(FILE *f, uint64_t position, uint64_t record[3])
+{
+    return fseek(f, (long)position, SEEK_SET) == 0 && fread(record, RECORD_SIZE, 1, f) == 1;
+}
+
+static uint64_t lower_bound(FILE *f, uint64_t position, uint64_t count, uint64_t len, int *ok)
+{
+    uint64_t lo = 0, hi = count, mid, record[3];
+
+    /* Find the first string of the given length among those sorted by length */
+    while (lo < hi && *ok)
+    {
+        mid = lo + (hi - lo) / 2;
+
+        if (!(*ok = read_record(f, position + mid * RECORD_SIZE, record)))
+            break;
+
+        if (record[1] < len)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+static int compare_lengths(const void *a, const void *b)
+{
+    const size_t la = *(const size_t*)a, lb = *(const size_t*)b;
+
+    return la < lb ? -1 : (la > lb ? 1 : 0);
+}
+
+static int compare_offsets(const void *a, const void *b)
+{
+    const Span *sa = a, *sb = b;
+
+    return sa->offset < sb->offset ? -1 : (sa->offset > sb->offset ? 1 : 0);
+}
+
+static int compare_spans(const void *a, const void *b)
+{
+    const Span *sa = a, *sb = b;
+
+    if (sa->len != sb->len)
+        return sa->len < sb->len ? -1 : 1;
+    return compare_offsets(a, b);
+}
+
+static int lookup_stored(const Cache *c, size_t section, size_t *lens, size_t lenCount, StringIndex *found)
+{
+    const uint64_t size = c->table.sections[section].size;
+    uint64_t (*records)[3] = NULL;
+    uint64_t first, last, j;
+    size_t i;
+    int ok = 1;
+
+    qsort(lens, lenCount, sizeof(size_t), compare_lengths);
+
+    for (i = 0; i < lenCount && ok; i++)
+    {
+        if (i > 0 && lens[i] == lens[i - 1])
+            continue;
+
+        first = lower_bound(c->file, c->positions[section], c->stored[section], lens[i], &ok);
+        last = lower_bound(c->file, c->positions[section], c->stored[section], lens[i] + 1, &ok);
+
+        if (!ok || last <= first)
+            continue;
+
+        /* Read all the strings of this length at once */
+        free(records);
+        if ((records = malloc((size_t)(last - first) * RECORD_SIZE)) == NULL ||
+            fseek(c->file, (long)(c->positions[section] + first * RECORD_SIZE), SEEK_SET) != 0 ||
+            fread(records, RECORD_SIZE, (size_t)(last - first), c->file) != (size_t)(last - first))
+        {
+            ok = 0;
+            break;
+        }
+
+        for (j = 0; j < last - first && ok; j++)
+        {
+            /* Make sure the strings stay within their section */
+            if (records[j][0] < size && records[j][2] < size - records[j][0] && records[j][1] <= records[j][2])
+                ok = strindex_push(found, (size_t)records[j][0], (size_t)records[j][1], (size_t)records[j][2]);
+        }
+    }
+
+    free(records);
+
+    return ok;
+}
+
+int cache_open(Cache *c, const char *dir, const char *filename, FILE *f)
+{
+    c->path = NULL;
+    c->file = NULL;
+    c->hasSections = 0;
+    c->indexes = NULL;
+    c->stored = NULL;
+    c->positions = NULL;
+    c->modified = 0;
+    sections_init(&c->table);
+
+    if (!compute_key(&c->key, f) || (c->path = index_path(dir, filename)) == NULL)
+    {
+        report_error("Failed to identify the file for the index: %s!\n", strerror(errno));
+        return 0;
+    }
+
+    /* The cache directory is created on its first use */
+#ifdef _WIN32
+    _mkdir(dir);
+#else
+    mkdir(dir, 0777);
+#endif
+
+    load(c);
+
+    return 1;
+}
+
+static int copy_records(FILE *from, uint64_t position, uint64_t count, Stream *to)
+{
+    char *buffer;
+    uint64_t done = 0;
+    size_t n;
+
+    if ((buffer = malloc(COPY_RECORDS * RECORD_SIZE)) == NULL || fseek(from, (long)position, SEEK_SET) != 0)
+    {
+        free(buffer);
+        return 0;
+    }
+
+    while (done < count && to->ok)
+    {
+        n = count - done < COPY_RECORDS ? (size_t)(count - done) : COPY_RECORDS;
+
+        if (fread(buffer, RECORD_SIZE, n, from) != n)
+            to->ok = 0;
+        write_bytes(to, buffer, n * RECORD_SIZE);
+        done += n;
+    }
+
+    free(buffer);
+
+    return to->ok;
+}
+
+static int write_index(Cache *c, FILE *f)
+{
+    Stream s;
+    uint64_t position;
+    size_t i, j;
+
+    stream_init(&s, f);
+    write_bytes(&s, CACHE_MAGIC, sizeof(CACHE_MAGIC) - 1);
+    write_u64(&s, c->key.size);
+    write_u64(&s, c->key.mtime);
+    write_u64(&s, c->key.mtimeNsec);
+    write_u64(&s, c->key.hash);
+    write_u64(&s, c->table.nameMax);
+    write_u64(&s, c->table.count);
+
+    /* The header is followed by the strings of every section */
+    position = sizeof(CACHE_MAGIC) - 1 + 6 * 8 + c->table.count * 16 + 8;
+    for (i = 0; i < c->table.count; i++)
+    {
+        const Section *sec = &c->table.sections[i];
+        const size_t nameLen = strlen(sec->name) + 1;
+
+        write_u64(&s, nameLen);
+        write_bytes(&s, sec->name, nameLen);
+        write_u64(&s, (uint64_t)sec->offset);
+        write_u64(&s, sec->size);
+        write_u64(&s, sec->memSize);
+        write_u64(&s, sec->address);
+        write_u64(&s, sec->type);
+        write_u64(&s, sec->flags);
+
+        position += 8 + nameLen + 6 * 8;
+    }
+
+    for (i = 0; i < c->table.count; i++)
+    {
+        const uint64_t count = c->stored[i];
+
+        write_u64(&s, count);
+        write_u64(&s, count != NOT_INDEXED ? position : 0);
+
+        if (count != NOT_INDEXED)
+            position += count * RECORD_SIZE;
+    }
+    write_u64(&s, s.hash);
+
+    for (i = 0; i < c->table.count && s.ok; i++)
+    {
+        StringIndex *index = &c->indexes[i];
+
+        if (c->stored[i] == NOT_INDEXED)
+            continue;
+
+        /* The strings kept from the former index are copied as they are */
+        if (c->positions[i] != NOT_INDEXED)
+        {
+            copy_records(c->file, c->positions[i], c->stored[i], &s);
+            continue;
+        }
+
+        /* Sort the strings by length, for the exact searches to only read those as long as them */
+        qsort(index->spans, index->count, sizeof(Span), compare_spans);
+        for (j = 0; j < index->count && s.ok; j++)
+        {
+            write_u64(&s, index->spans[j].offset);
+            write_u64(&s, index->spans[j].len);
+            write_u64(&s, index->spans[j].available);
+        }
+    }
+
+    return s.ok;
+}
+
+void cache_close(Cache *c, int save)
+{
+    char *temp = NULL;
+    FILE *f;
+    int ok = 0;
+
+    /* Write the index aside, then replace the former one at once */
+    if (save && c->modified && c->hasSections && (temp = malloc(strlen(c->path) + sizeof(".tmp"))) != NULL)
+    {
+        strcpy(temp, c->path);
+        strcat(temp, ".tmp");
+
+        if ((f = fopen(temp, "wb")) != NULL)
+        {
+            ok = write_index(c, f);
+            ok = fclose(f) == 0 && ok;
+        }
+    }
+
+    if (c->file != NULL)
+        fclose(c->file);
+    c->file = NULL;
+
+    if (temp != NULL)
+    {
+#ifdef _WIN32
+        remove(c->path);
+#endif
+        if (!ok || rename(temp, c->path) != 0)
+        {
+            report_error("Failed to write the index: %s!\n", strerror(errno));
+            remove(temp);
+        }
+
+        free(temp);
+    }
+
+    release(c);
+    free(c->path);
+    c->path = NULL;
+}
+
+const SectionTable *cache_sections(const Cache *c)
+{
+    return c != NULL && c->hasSections ? &c->table : NULL;
+}
+
+void cache_put_sections(Cache *c, const SectionTable *table)
+{
+    if (c == NULL)
+        return;
+
+    /* A new table makes the former strings meaningless */
+    release(c);
+    if (c->file != NULL)
+        fclose(c->file);
+    c->file = NULL;
+
+    if (sections_copy(&c->table, table) && alloc_sections(c))
+        c->modified = 1;
+    else
+        release(c);
+}
+
+int cache_has_index(const Cache *c, size_t section)
+{
+    return c != NULL && c->hasSections && section < c->table.count && c->stored[section] != NOT_INDEXED;
+}
+
+int cache_lookup(const Cache *c, size_t section, size_t *lens, size_t lenCount, StringIndex *found)
+{
+    const StringIndex *index;
+    size_t i, j;
+    int ok = 1;
+
+    if (!cache_has_index(c, section))
+        return 0;
+
+    /* The strings of the former index are read from the disk */
+    if (c->positions[section] != NOT_INDEXED)
+        ok = lookup_stored(c, section, lens, lenCount, found);
+    else
+    {
+        index = &c->indexes[section];
+        for (i = 0; i < index->count && ok; i++)
+        {
+            for (j = 0; j < lenCount && index->spans[i].len != lens[j]; j++);
+
+            if (j < lenCount)
+                ok = strindex_push(found, index->spans[i].offset, index->spans[i].len, index->spans[i].available);
+        }
+    }
+
+    /* The strings are handed in the order of the table */
+    if (ok && found->count > 1)
+        qsort(found->spans, found->count, sizeof(Span), compare_offsets);
+
+    return ok;
+}
+
+void cache_put_index(Cache *c, size_t section, StringIndex *index)
+{
+    /* The cache takes over the index, it isn't stored anywhere yet */
+    if (c != NULL && c->hasSections && section < c->table.count)
+    {
+        strindex_free(&c->indexes[section]);
+        c->indexes[section] = *index;
+        c->stored[section] = index->count;
+        c->positions[section] = NOT_INDEXED;
+        c->modified = 1;
+    }
+    else
+        strindex_free(index);
+
+    strindex_init(index);
+}
@@ -0,0 +1,48 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Persistent index of the sections and their strings, kept in a cache directory.
+ */
+
+#ifndef CACHE_H_INCLUDED
+#define CACHE_H_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+#include "sections.h"
+#include "strindex.h"
+
+/* Identifies a version of a file, the index being discarded when it doesn't match */
+typedef struct CacheKey
+{
+    uint64_t size;
+    uint64_t mtime;
+    uint64_t mtimeNsec;
+    uint64_t hash;
+} CacheKey;
+
+typedef struct Cache
+{
+    char *path;
+    FILE *file;
+    CacheKey key;
+    SectionTable table;
+    int hasSections;
+    StringIndex *indexes;
+    uint64_t *stored;
+    uint64_t *positions;
+    int modified;
+} Cache;
+
+int cache_open(Cache *c, const char *dir, const char *filename, FILE *f);
+void cache_close(Cache *c, int save);
+
+const SectionTable *cache_sections(const Cache *c);
+void cache_put_sections(Cache *c, const SectionTable *table);
+
+int cache_has_index(const Cache *c, size_t section);
+int cache_lookup(const Cache *c, size_t section, size_t *lens, size_t lenCount, StringIndex *found);
+void cache_put_index(Cache *c, size_t section, StringIndex *index);
+
+#endif
@@ -8,275 +8,836 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include "common.h"
+#include "automaton.h"
+#include "search.h"
+#include "scan.h"
+#include "pattern.h"
+#include "report.h"
 
-static unsigned int count_occurrences(const char *str, const char *word, size_t *strLen, size_t wordLen, size_t len)
+static size_t available_length(const char *str, size_t len)
+{
+    /* The string may take over its termination and the padding following it, up to the next string */
+    const size_t end = scan_find(str, len, 0);
+    const size_t next = end + scan_skip(&str[end], len - end, 0);
+
+    /* A termination is kept before the next string (or at the very end) */
+    return next - 1;
+}
+
+static size_t string_length(const char *str, size_t len)
+{
+    return scan_find(str, len, 0);
+}
+
+static size_t wide_available(const char *str, size_t len)
+{
+    /* As for the bytes, a null character is kept before the next string */
+    const size_t end = scan_find_wide(str, len);
+    const size_t next = end + scan_skip_wide(&str[end], len - end);
+
+    return next - 2;
+}
+
+static int compare_hits(const void *a, const void *b)
+{
+    const Hit *ha = a, *hb = b;
+
+    /* Order by position, then by priority of the rules */
+    if (ha->position != hb->position)
+        return ha->position < hb->position ? -1 : 1;
+    if (ha->rule != hb->rule)
+        return ha->rule < hb->rule ? -1 : 1;
+    return 0;
+}
+
+static size_t substituted_length(const RuleSet *rules, const HitList *hits, size_t inputLen, int *inPlace)
 {
-    size_t c = 0;
-    unsigned int count = 0;
+    size_t h, i = 0, len = inputLen;
 
-    *strLen = 0;
-    while ((*strLen) < len)
+    *inPlace = 1;
+
+    /* Keep the leftmost matches that don't overlap with a previous one */
+    for (h = 0; h < hits->count; h++)
     {
-        /* End the search */
-        if (str[(*strLen)] == 0)
-            return count;
+        const Hit *hit = &hits->hits[h];
+        const Rule *rule = &rules->rules[hit->rule];
 
-        /* Count the matches */
-        if (str[(*strLen)] == word[c])
-            c++;
-        else
-            c = 0;
+        if (hit->position < i)
+            continue;
 
-        if (c >= wordLen)
-        {
-            c = 0;
-            count++;
-        }
-        (*strLen)++;
+        len = len - rule->searchLen + rule->replaceLen;
+        i = hit->position + rule->searchLen;
+
+        /* The output may only be written over the input as long as it lags behind it */
+        if (len > inputLen)
+            *inPlace = 0;
     }
 
-    return count;
+    return len;
 }
 
-static size_t available_length(const char *str, size_t len)
+static void string_substitute_in_place(char *str, const RuleSet *rules, const HitList *hits, size_t inputLen)
 {
-    size_t i = 0;
-    char lc = 1;
+    size_t h, i = 0, j = 0;
 
-    /* Walk through the string to detect the end of it */
-    while (i < len)
+    /* Substitute like string_substitute, the write position trailing the read one */
+    for (h = 0; h < hits->count; h++)
     {
-        if (str[i] != 0 && lc == 0)
-            return i - 1;
+        const Hit *hit = &hits->hits[h];
+        const Rule *rule = &rules->rules[hit->rule];
+
+        if (hit->position < i)
+            continue;
+
+        if (j < i)
+            memmove(&str[j], &str[i], hit->position - i);
+        j += hit->position - i;
+        memcpy(&str[j], rule->replace, rule->replaceLen);
+        j += rule->replaceLen;
+        i = hit->position + rule->searchLen;
+    }
+
+    if (j < i)
+        memmove(&str[j], &str[i], inputLen - i);
+}
+
+static void string_substitute(char *output, const char *input, const RuleSet *rules, const HitList *hits, size_t inputLen)
+{
+    size_t h, i = 0, j = 0;
+
+    /* Keep the leftmost matches that don't overlap with a previous one */
+    for (h = 0; h < hits->count; h++)
+    {
+        const Hit *hit = &hits->hits[h];
+        const Rule *rule = &rules->rules[hit->rule];
+
+        if (hit->position < i)
+            continue;
+
+        /* Copy the input up to the match, then write the replacement instead */
+        memcpy(&output[j], &input[i], hit->position - i);
+        j += hit->position - i;
+        memcpy(&output[j], rule->replace, rule->replaceLen);
+        j += rule->replaceLen;
+        i = hit->position + rule->searchLen;
+    }
+
+    /* Copy the rest of the input */
+    memcpy(&output[j], &input[i], inputLen - i);
+}
 
-        /* Save the last character */
-        lc = str[i];
-        i++;
+int print_status(int ret)
+{
+    /* Print a status message in case there's an error remaining */
+    switch (ret)
+    {
+        case 0: puts("The operation completed successfully."); break;
+        case 1: report_error("The string could not be found!\n"); break;
+        case 2: report_error("One or more strings couldn't be replaced because they didn't fit!\n"); break;
     }
 
-    /* Occurs if the string is located at the very end */
-    return len - 1;
+    return ret;
 }
 
-static void string_substitute(char *output, const char *input, const char *search, const char *replace, size_t searchLen, size_t replaceLen, size_t inputLen)
+/* Keep the worst outcome among the strings, a failure (above 2) prevailing */
+static int worst_status(int ret, int r)
 {
-    size_t i = 0, j = 0, c = 0;
+    return ret > 2 || r == 0 ? ret : r;
+}
 
-    while (i < inputLen)
+/* Count the outcome of a string, returning its status */
+static int tally_patch(Tally *tally, size_t matches, int fit)
+{
+    if (tally != NULL)
     {
-        if (input[i] == search[c])
-            c++;
+        tally->matches += matches;
+        if (fit)
+            tally->replaced++;
         else
-        {
-            c++;
-            memcpy(&output[j], &input[i] - (c-1), c);
-            j += c;
-            c = 0;
-        }
+            tally->skipped++;
+    }
+
+    return fit ? 0 : 2;
+}
 
-        if (c >= searchLen)
+/* Write a string substituted apart over the former one, or only record it when it's planned */
+static int write_string(char *data, size_t offset, size_t curLen, size_t available, const char *buffer, size_t newLen, size_t matches, RangeList *dirty, Plan *plan, Tally *tally)
+{
+    /* Only record the change when it's planned */
+    if (plan != NULL)
+    {
+        if (!plan_add(plan, offset, curLen, newLen > 0 ? buffer : "", newLen, available))
         {
-            /* Write the replacement instead of copying the input */
-            memcpy(&output[j], replace, replaceLen);
-            j += replaceLen;
-            c = 0;
+            report_error("Failed to allocate memory for the changes: %s!\n", strerror(errno));
+            return 7;
         }
-        i++;
+        return tally_patch(tally, matches, newLen <= available);
     }
+
+    if (newLen > available)
+        return tally_patch(tally, matches, 0);
+
+    /* Write the string */
+    memcpy(&data[offset], buffer, newLen);
+
+    /* Add zeros padding */
+    memset(&data[offset] + newLen, 0, available - newLen);
+
+    /* Past the end of both strings, the padding was already made of zeros */
+    if (dirty != NULL)
+        ranges_add(dirty, offset, newLen > curLen ? newLen : curLen);
+
+    return tally_patch(tally, matches, 1);
 }
 
-int search_and_replace(char *data, const char *search, const char *replace, size_t len)
+static int patch_string(char *data, size_t offset, size_t curLen, size_t available, const RuleSet *rules, const HitList *hits, Arena *scratch, RangeList *dirty, Plan *plan, Tally *tally)
 {
-    const size_t searchLen = strlen(search);
-    const size_t replaceLen = strlen(replace);
-    size_t i, c = 0, offset = 0, curLen;
-    int ret = 1, state = 0;
-    char *buffer = NULL;
+    int inPlace;
+    const size_t newLen = substituted_length(rules, hits, curLen, &inPlace);
+    char *buffer;
+
+    /* The replacements which don't fit are only of interest to a plan */
+    if (newLen > available && plan == NULL)
+        return tally_patch(tally, hits->count, 0);
+
+    /* Unless it grows, the string is substituted over itself in a single pass */
+    if (inPlace && plan == NULL)
+    {
+        string_substitute_in_place(&data[offset], rules, hits, curLen);
+
+        /* Only the end of the former string is left to clear, its padding was already made of zeros
+           (an unterminated string at the end of the table keeps its last character, as if written from a copy) */
+        memset(&data[offset] + newLen, 0, (curLen < available ? curLen : available) - newLen);
 
-    for (i = 0; i < len; i++)
+        if (dirty != NULL)
+            ranges_add(dirty, offset, curLen);
+
+        return tally_patch(tally, hits->count, 1);
+    }
+
+    /* The substitued string is built in the scratch region, reused from one string to the next */
+    if ((buffer = arena_scratch(scratch, newLen)) == NULL)
     {
-        if (state == 0)
+        report_error("Failed to allocate memory for the replacement: %s!\n", strerror(errno));
+        return 7;
+    }
+
+    /* Proceed to the substitution in the string */
+    string_substitute(buffer, &data[offset], rules, hits, curLen);
+
+    return write_string(data, offset, curLen, available, buffer, newLen, hits->count, dirty, plan, tally);
+}
+
+static int patch_string_exact(char *data, size_t offset, size_t available, const Rule *rule, RangeList *dirty, Plan *plan, Tally *tally)
+{
+    if (plan != NULL && !plan_add(plan, offset, rule->searchLen, rule->replace, rule->replaceLen, available))
+    {
+        report_error("Failed to allocate memory for the changes: %s!\n", strerror(errno));
+        return 7;
+    }
+
+    if (rule->replaceLen > available)
+        return tally_patch(tally, 1, 0);
+
+    /* Only record the change when it's planned */
+    if (plan != NULL)
+        return tally_patch(tally, 1, 1);
+
+    /* Write the string */
+    memcpy(&data[offset], rule->replace, rule->replaceLen);
+
+    /* Add zeros padding */
+    memset(&data[offset] + rule->replaceLen, 0, available - rule->replaceLen);
+
+    if (dirty != NULL)
+        ranges_add(dirty, offset, rule->replaceLen > rule->searchLen ? rule->replaceLen : rule->searchLen);
+
+    return tally_patch(tally, 1, 1);
+}
+
+static int replace_single(char *data, const RuleSet *rules, size_t len, HitList *hits, Arena *scratch, RangeList *dirty, Plan *plan, Tally *tally)
+{
+    const Needle *needle = rules->needle;
+    const char *p;
+    size_t i = 0, start, end, pos;
+    int ret = 1;
+
+    /* Search the whole section at once, the strings without any match are never walked */
+    while (i < len && ret <= 2 && (p = needle_find(needle, &data[i], len - i)) != NULL)
+    {
+        pos = (size_t)(p - data);
+
+        /* Delimit the string containing the match */
+        for (start = pos; start > i && data[start - 1] != 0; start--);
+        end = pos + string_length(&data[pos], len - pos);
+
+        /* Collect the other matches of the string */
+        hits->count = 0;
+        do
         {
-            /* Treat the null characters as terminations */
-            if (data[i] == 0)
-                continue;
-            else
+            if (!hits_push(hits, 0, pos - start))
             {
-                offset = i;
-                state = 2;
+                report_error("Failed to allocate memory for the matches: %s!\n", strerror(errno));
+                return 7;
             }
+            pos += needle->len;
         }
-        else if (state == 1)
+        while ((p = needle_find(needle, &data[pos], end - pos)) != NULL && (pos = (size_t)(p - data)) < end);
+
+        if (ret == 1)
+            ret = 0;
+        ret = worst_status(ret, patch_string(data, start, end - start, available_length(&data[start], len - start), rules, hits, scratch, dirty, plan, tally));
+
+        i = end;
+    }
+
+    return ret;
+}
+
+static int replace_multiple(char *data, const RuleSet *rules, size_t len, HitList *hits, Arena *scratch, RangeList *dirty, Plan *plan, Tally *tally)
+{
+    size_t i = 0, curLen;
+    int ret = 1;
+
+    while (i < len && ret <= 2)
+    {
+        /* Treat the null characters as terminations */
+        if (data[i] == 0)
         {
-            if (data[i] == 0)
-                state = 0;
+            i += scan_skip(&data[i], len - i, 0);
             continue;
         }
-        else
+
+        /* Collect all the matches of the string in a single pass */
+        hits->count = 0;
+        if (!automaton_scan(rules->automaton, &data[i], len - i, &curLen, hits))
         {
-            if (data[i] == 0)
-            {
-                c = 0;
-                state = 0;
-            }
+            report_error("Failed to allocate memory for the matches: %s!\n", strerror(errno));
+            return 7;
         }
 
-        /* Match the search character by character */
-        if (data[i] == search[c])
-            c++;
-        else
-            c = 0;
-
         /* If a match is found */
-        if (c >= searchLen)
+        if (hits->count > 0)
         {
-            c = 0;
-            state = 1;
             if (ret == 1)
                 ret = 0;
 
-            /* Count the occurrences of the search */
-            const size_t count = count_occurrences(&data[offset], search, &curLen, searchLen, len - offset);
+            if (hits->count > 1)
+                qsort(hits->hits, hits->count, sizeof(Hit), compare_hits);
+
+            ret = worst_status(ret, patch_string(data, i, curLen, available_length(&data[i], len - i), rules, hits, scratch, dirty, plan, tally));
+        }
 
-            /* Compute the required length */
-            const size_t newLen = curLen + count * (replaceLen - searchLen);
-            const size_t available = available_length(&data[offset], len - offset);
-            if (newLen > available)
+        i += curLen;
+    }
+
+    return ret;
+}
+
+/* Collect the matches within a UTF-16 string, those which don't start on a character being dropped */
+static int wide_hits(const RuleSet *rules, const char *str, size_t curLen, HitList *hits)
+{
+    size_t pos = 0, h, n;
+    const char *p;
+
+    hits->count = 0;
+
+    if (rules->needle != NULL)
+    {
+        while (pos < curLen && (p = needle_find(rules->needle, &str[pos], curLen - pos)) != NULL)
+        {
+            pos = (size_t)(p - str);
+            if (pos % 2 != 0)
             {
-                ret = 2;
+                pos++;
                 continue;
             }
 
-            /* Allocate a buffer to store the substitued string */
-            if (buffer != NULL)
+            if (!hits_push(hits, 0, pos))
+                return 0;
+            pos += rules->needle->len;
+        }
+
+        return 1;
+    }
+
+    if (!automaton_feed(rules->automaton, str, curLen, hits))
+        return 0;
+
+    for (h = n = 0; h < hits->count; h++)
+    {
+        if (hits->hits[h].position % 2 == 0)
+            hits->hits[n++] = hits->hits[h];
+    }
+    hits->count = n;
+
+    if (hits->count > 1)
+        qsort(hits->hits, hits->count, sizeof(Hit), compare_hits);
+
+    return 1;
+}
+
+/* Find the rule matching a whole UTF-16 string, the first one of the rules having the priority */
+static long wide_whole(const RuleSet *rules, const HitList *hits, size_t curLen)
+{
+    size_t h;
+
+    for (h = 0; h < hits->count && hits->hits[h].position == 0; h++)
+    {
+        if (rules->rules[hits->hits[h].rule].searchLen == curLen)
+            return (long)hits->hits[h].rule;
+    }
+
+    return -1;
+}
+
+static int replace_wide(char *data, const RuleSet *rules, size_t len, int exact, HitList *hits, Arena *scratch, RangeList *dirty, Plan *plan, Tally *tally)
+{
+    size_t i = 0, curLen;
+    int ret = 1;
+    long whole;
+
+    /* The characters are made of two bytes from the start of the table, a byte left over isn't part of any */
+    len -= len % 2;
+
+    while (i < len && ret <= 2)
+    {
+        /* Treat the null characters as terminations */
+        if (data[i] == 0 && data[i + 1] == 0)
+        {
+            i += scan_skip_wide(&data[i], len - i);
+            continue;
+        }
+
+        curLen = scan_find_wide(&data[i], len - i);
+        if (!wide_hits(rules, &data[i], curLen, hits))
+        {
+            report_error("Failed to allocate memory for the matches: %s!\n", strerror(errno));
+            return 7;
+        }
+
+        /* A string must be terminated to be matched whole */
+        if (exact)
+        {
+            if (i + curLen < len && (whole = wide_whole(rules, hits, curLen)) >= 0)
             {
-                if ((buffer = realloc(buffer, newLen)) == NULL)
-                    continue;
+                if (ret == 1)
+                    ret = 0;
+                ret = worst_status(ret, patch_string_exact(data, i, wide_available(&data[i], len - i), &rules->rules[whole], dirty, plan, tally));
             }
-            else
+        }
+        else if (hits->count > 0)
+        {
+            if (ret == 1)
+                ret = 0;
+            ret = worst_status(ret, patch_string(data, i, curLen, wide_available(&data[i], len - i), rules, hits, scratch, dirty, plan, tally));
+        }
+
+        i += curLen;
+    }
+
+    return ret;
+}
+
+static int replace_patterns(char *data, const RuleSet *rules, size_t len, int whole, Arena *scratch, RangeList *dirty, Plan *plan, Tally *tally)
+{
+    const Pattern *re = rules->pattern;
+    PatternVm vm;
+    PatternMatch m;
+    char *buffer = NULL;
+    size_t i = 0, curLen, pos, newLen, need, matches;
+    int ret = 1;
+
+    if (!pattern_vm_init(&vm, re))
+    {
+        report_error("Failed to allocate memory for the patterns: %s!\n", strerror(errno));
+        return 7;
+    }
+
+    while (i < len && ret <= 2)
+    {
+        /* Treat the null characters as terminations */
+        if (data[i] == 0)
+        {
+            i += scan_skip(&data[i], len - i, 0);
+            continue;
+        }
+
+        /* The automaton rules out most of the strings in a single pass, a string must be terminated to be matched whole */
+        curLen = string_length(&data[i], len - i);
+        if ((whole && i + curLen >= len) || !pattern_candidate(re, &data[i], curLen))
+        {
+            i += curLen;
+            continue;
+        }
+
+        /* Substitute the matches one after the other in the scratch region, the replacements being expanded with their groups */
+        pos = newLen = matches = 0;
+        while (pos < curLen && pattern_find(&vm, &data[i], curLen, pos, whole, &m))
+        {
+            need = newLen + (m.groups[0] - pos) + pattern_expand(&rules->rules[m.rule], &m, &data[i], NULL) + (curLen - m.groups[1]);
+            if ((buffer = arena_scratch(scratch, need)) == NULL)
             {
-                if ((buffer = malloc(newLen)) == NULL)
-                    continue;
+                report_error("Failed to allocate memory for the replacement: %s!\n", strerror(errno));
+                ret = 7; goto RET;
             }
 
-            /* Proceed to the substitution in the string */
-            string_substitute(buffer, &data[offset], search, replace, searchLen, replaceLen, curLen);
+            memcpy(&buffer[newLen], &data[i + pos], m.groups[0] - pos);
+            newLen += m.groups[0] - pos;
+            newLen += pattern_expand(&rules->rules[m.rule], &m, &data[i], &buffer[newLen]);
+            pos = m.groups[1];
+            matches++;
 
-            /* Write the string */
-            memcpy(&data[offset], buffer, newLen);
+            if (whole)
+                break;
+        }
 
-            /* Add zeros padding */
-            memset(&data[offset] + newLen, 0, available - newLen);
+        /* If a match is found, the rest of the string follows the last one */
+        if (matches > 0)
+        {
+            memcpy(&buffer[newLen], &data[i + pos], curLen - pos);
+            newLen += curLen - pos;
+
+            if (ret == 1)
+                ret = 0;
+            ret = worst_status(ret, write_string(data, i, curLen, available_length(&data[i], len - i), buffer, newLen, matches, dirty, plan, tally));
         }
+
+        i += curLen;
     }
 
-    free(buffer);
+RET:
+    pattern_vm_free(&vm);
 
-    /* Print a status message in case there's an error remaining */
-    switch (ret)
-    {
-        case 0: puts("The operation completed successfully."); break;
-        case 1: fputs("The string could not be found!\n", stderr); break;
-        case 2: fputs("One or more strings couldn't be replaced because they didn't fit!\n", stderr); break;
-    }
+    return ret;
+}
+
+int search_and_replace(char *data, const RuleSet *rules, size_t len, RangeList *dirty, Plan *plan, Arena *arena, Tally *tally)
+{
+    HitList hits;
+    int ret;
+
+    if (rules->pattern != NULL)
+        return replace_patterns(data, rules, len, 0, arena, dirty, plan, tally);
+
+    hits_init(&hits);
+
+    if (rules->utf16)
+        ret = replace_wide(data, rules, len, 0, &hits, arena, dirty, plan, tally);
+    else if (rules->needle != NULL)
+        ret = replace_single(data, rules, len, &hits, arena, dirty, plan, tally);
+    else
+        ret = replace_multiple(data, rules, len, &hits, arena, dirty, plan, tally);
+
+    hits_free(&hits);
 
     return ret;
 }
 
-int search_and_replace_exact(char *data, const char *search, const char *replace, size_t len)
+int search_and_replace_exact(char *data, const RuleSet *rules, size_t len, RangeList *dirty, Plan *plan, Arena *arena, Tally *tally)
 {
-    const size_t searchLen = strlen(search);
-    const size_t replaceLen = strlen(replace);
-    size_t i, c = 0, offset = 0;
-    int ret = 1, state = 0;
+    size_t i = 0, curLen;
+    int ret = 1;
+    long r;
+
+    if (rules->pattern != NULL)
+        return replace_patterns(data, rules, len, 1, arena, dirty, plan, tally);
+
+    /* The whole strings are found by their matches starting them */
+    if (rules->utf16)
+    {
+        HitList hits;
+
+        hits_init(&hits);
+        ret = replace_wide(data, rules, len, 1, &hits, NULL, dirty, plan, tally);
+        hits_free(&hits);
 
-    for (i = 0; i < len; i++)
+        return ret;
+    }
+
+    if (rules->needle != NULL)
     {
-        if (state == 0)
+        const Needle *needle = rules->needle;
+        const char *p;
+
+        /* Only the occurrences delimited by terminations on both sides are whole strings */
+        while (i < len && ret <= 2 && (p = needle_find(needle, &data[i], len - i)) != NULL)
         {
-            /* Treat the null characters as terminations */
-            if (data[i] == 0)
-                continue;
-            else
+            const size_t pos = (size_t)(p - data);
+
+            i = pos + needle->len;
+            if ((pos == 0 || data[pos - 1] == 0) && i < len && data[i] == 0)
             {
-                offset = i;
-                state = 2;
+                if (ret == 1)
+                    ret = 0;
+                ret = worst_status(ret, patch_string_exact(data, pos, available_length(&data[pos], len - pos), &rules->rules[0], dirty, plan, tally));
             }
         }
-        else if (state == 1)
+
+        return ret;
+    }
+
+    while (i < len && ret <= 2)
+    {
+        /* Treat the null characters as terminations */
+        if (data[i] == 0)
         {
-            if (data[i] == 0)
-                state = 0;
+            i += scan_skip(&data[i], len - i, 0);
             continue;
         }
 
-        /* Match the search character by character */
-        if (data[i] == search[c])
-            c++;
-        else
+        /* Find the rule matching the whole string, it must be terminated to be matched */
+        r = automaton_match_whole(rules->automaton, &data[i], len - i, &curLen);
+        if (i + curLen >= len)
+            break;
+
+        /* If a match is found */
+        if (r >= 0)
         {
-            c = 0;
-            state = 1;
+            if (ret == 1)
+                ret = 0;
+            ret = worst_status(ret, patch_string_exact(data, i, available_length(&data[i], len - i), &rules->rules[r], dirty, plan, tally));
         }
 
+        i += curLen;
+    }
+
+    return ret;
+}
+
+int search_and_replace_indexed(char *data, const RuleSet *rules, size_t len, const StringIndex *index, RangeList *dirty, Plan *plan, Tally *tally)
+{
+    size_t i, maxLen = 0, curLen;
+    int ret = 1;
+    long r;
+
+    for (i = 0; i < rules->count; i++)
+    {
+        if (rules->rules[i].searchLen > maxLen)
+            maxLen = rules->rules[i].searchLen;
+    }
+
+    /* Only the strings as long as a search may match it entirely */
+    for (i = 0; i < index->count && ret <= 2; i++)
+    {
+        const Span *span = &index->spans[i];
+
+        /* The index may be outdated, the strings are checked against the table */
+        if (span->len > maxLen || span->offset + span->len >= len || data[span->offset + span->len] != 0 ||
+            (span->offset > 0 && data[span->offset - 1] != 0) || span->available != available_length(&data[span->offset], len - span->offset))
+            continue;
+
+        if (rules->needle != NULL)
+            r = span->len == rules->rules[0].searchLen && memcmp(&data[span->offset], rules->rules[0].search, span->len) == 0 ? 0 : -1;
+        else
+            r = automaton_match_whole(rules->automaton, &data[span->offset], span->len + 1, &curLen);
+
         /* If a match is found */
-        if (c > searchLen && data[i] == 0)
+        if (r >= 0)
         {
-            c = 0;
-            state = 0;
             if (ret == 1)
                 ret = 0;
+            ret = worst_status(ret, patch_string_exact(data, span->offset, span->available, &rules->rules[r], dirty, plan, tally));
+        }
+    }
 
-            const size_t available = available_length(&data[offset], len - offset);
-            if (replaceLen > available)
-            {
-                ret = 2;
-                continue;
-            }
+    return ret;
+}
+
+static int count_patterns(const char *data, const RuleSet *rules, size_t len, int whole, unsigned long limit, unsigned long *found)
+{
+    unsigned long count = 0;
+    size_t i = 0, curLen, pos;
+    PatternVm vm;
+    PatternMatch m;
 
-            /* Write the string */
-            memcpy(&data[offset], replace, replaceLen);
+    if (!pattern_vm_init(&vm, rules->pattern))
+    {
+        report_error("Failed to allocate memory for the patterns: %s!\n", strerror(errno));
+        return 7;
+    }
+
+    while (i < len && (limit == 0 || count < limit))
+    {
+        /* Treat the null characters as terminations */
+        if (data[i] == 0)
+        {
+            i += scan_skip(&data[i], len - i, 0);
+            continue;
+        }
 
-            /* Add zeros padding */
-            memset(&data[offset] + replaceLen, 0, available - replaceLen);
+        /* A string must be terminated to be matched whole */
+        curLen = string_length(&data[i], len - i);
+        if ((!whole || i + curLen < len) && pattern_candidate(rules->pattern, &data[i], curLen))
+        {
+            for (pos = 0; pos < curLen && (limit == 0 || count < limit) && pattern_find(&vm, &data[i], curLen, pos, whole, &m); pos = m.groups[1])
+            {
+                count++;
+                if (whole)
+                    break;
+            }
         }
+
+        i += curLen;
     }
 
-    /* Print a status message in case there's an error remaining */
-    switch (ret)
+    pattern_vm_free(&vm);
+    *found = count;
+
+    return 0;
+}
+
+static int count_wide(const char *data, const RuleSet *rules, size_t len, int exact, unsigned long limit, unsigned long *found)
+{
+    unsigned long count = 0;
+    size_t i = 0, curLen;
+    HitList hits;
+    int ret = 0;
+
+    hits_init(&hits);
+    len -= len % 2;
+
+    while (i < len && (limit == 0 || count < limit))
     {
-        case 0: puts("The operation completed successfully."); break;
-        case 1: fputs("The string could not be found!\n", stderr); break;
-        case 2: fputs("One or more strings couldn't be replaced because they didn't fit!\n", stderr); break;
+        /* Treat the null characters as terminations */
+        if (data[i] == 0 && data[i + 1] == 0)
+        {
+            i += scan_skip_wide(&data[i], len - i);
+            continue;
+        }
+
+        curLen = scan_find_wide(&data[i], len - i);
+        if (!wide_hits(rules, &data[i], curLen, &hits))
+        {
+            report_error("Failed to allocate memory for the matches: %s!\n", strerror(errno));
+            ret = 7;
+            break;
+        }
+
+        /* A string must be terminated to be matched whole */
+        if (exact)
+            count += i + curLen < len && wide_whole(rules, &hits, curLen) >= 0;
+        else
+            count += hits.count;
+
+        i += curLen;
     }
 
+    hits_free(&hits);
+    *found = limit > 0 && count > limit ? limit : count;
+
     return ret;
 }
 
-void print_strings(const char *data, size_t offset_start, size_t len)
+int search_count(const char *data, const RuleSet *rules, size_t len, int exact, unsigned long limit, unsigned long *found)
 {
-    size_t i, l = 0;
-    const char *s = NULL;
+    unsigned long count = 0;
+    size_t i = 0, curLen;
+    HitList hits;
+    int ret = 0;
+
+    *found = 0;
+
+    if (rules->utf16)
+        return count_wide(data, rules, len, exact, limit, found);
 
-    for (i = 0; i < len; i++)
+    /* Count the occurrences of a single search (or the strings equal to it), up to the limit */
+    if (rules->needle != NULL)
     {
+        const Needle *needle = rules->needle;
+        const char *p;
+
+        while (i < len && (limit == 0 || count < limit) && (p = needle_find(needle, &data[i], len - i)) != NULL)
+        {
+            const size_t pos = (size_t)(p - data);
+
+            i = pos + needle->len;
+            if (!exact || ((pos == 0 || data[pos - 1] == 0) && i < len && data[i] == 0))
+                count++;
+        }
+        *found = count;
+
+        return 0;
+    }
+
+    if (rules->pattern != NULL)
+        return count_patterns(data, rules, len, exact, limit, found);
+
+    hits_init(&hits);
+
+    while (i < len && (limit == 0 || count < limit))
+    {
+        /* Treat the null characters as terminations */
         if (data[i] == 0)
         {
-            if (l > 0)
-            {
-                /* Print the string (may contains unprintable characters) */
-                printf("%08X:%.*s\n", offset_start + i - l, l, s);
+            i += scan_skip(&data[i], len - i, 0);
+            continue;
+        }
 
-                l = 0;
-                s = NULL;
-            }
+        if (exact)
+        {
+            /* A string must be terminated to be matched whole */
+            if (automaton_match_whole(rules->automaton, &data[i], len - i, &curLen) >= 0 && i + curLen < len)
+                count++;
         }
         else
         {
-            if (s == NULL)
-                s = &data[i];
-            l++;
+            hits.count = 0;
+            if (!automaton_scan(rules->automaton, &data[i], len - i, &curLen, &hits))
+            {
+                report_error("Failed to allocate memory for the matches: %s!\n", strerror(errno));
+                ret = 7;
+                break;
+            }
+            count += hits.count;
+        }
+
+        i += curLen;
+    }
+
+    hits_free(&hits);
+
+    /* The last string may hold more matches than needed */
+    *found = limit > 0 && count > limit ? limit : count;
+
+    return ret;
+}
+
+void print_strings(Listing *out, const char *data, size_t offset_start, size_t len)
+{
+    size_t i = 0, l;
+
+    /* The UTF-16 strings are converted when listed */
+    if (out->utf16)
+    {
+        len -= len % 2;
+        while (i < len)
+        {
+            i += scan_skip_wide(&data[i], len - i);
+            l = scan_find_wide(&data[i], len - i);
+
+            if (i + l >= len)
+                break;
+
+            listing_string(out, &data[i], offset_start + i, l);
+            i += l;
         }
+        return;
+    }
+
+    while (i < len)
+    {
+        /* Skip the terminations, then the string up to its own */
+        i += scan_skip(&data[i], len - i, 0);
+        l = scan_find(&data[i], len - i, 0);
+
+        /* An unterminated string isn't listed */
+        if (i + l >= len)
+            break;
+
+        listing_string(out, &data[i], offset_start + i, l);
+        i += l;
     }
 }
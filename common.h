@@ -8,9 +8,22 @@
 #ifndef COMMON_H_INCLUDED
 #define COMMON_H_INCLUDED
 
-int search_and_replace(char *data, const char *search, const char *replace, size_t len);
-int search_and_replace_exact(char *data, const char *search, const char *replace, size_t len);
+#include "rules.h"
+#include "ranges.h"
+#include "listing.h"
+#include "strindex.h"
+#include "plan.h"
+#include "arena.h"
+#include "stats.h"
 
-void print_strings(const char *data, size_t offset_start, size_t len);
+int search_and_replace(char *data, const RuleSet *rules, size_t len, RangeList *dirty, Plan *plan, Arena *arena, Tally *tally);
+int search_and_replace_exact(char *data, const RuleSet *rules, size_t len, RangeList *dirty, Plan *plan, Arena *arena, Tally *tally);
+int search_and_replace_indexed(char *data, const RuleSet *rules, size_t len, const StringIndex *index, RangeList *dirty, Plan *plan, Tally *tally);
+
+int search_count(const char *data, const RuleSet *rules, size_t len, int exact, unsigned long limit, unsigned long *found);
+
+int print_status(int ret);
+
+void print_strings(Listing *out, const char *data, size_t offset_start, size_t len);
 
 #endif
@@ -0,0 +1,389 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Patch files recording the bytes changed in an executable, applied to or reverted from its copies.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "delta.h"
+#include "fileio.h"
+#include "report.h"
+
+/* A line of text per change: <offset> <bytes before> <bytes after>, in hexadecimal */
+#define DELTA_HEADER "string-patch 1"
+
+/* The bytes left as they were between two changes are kept in a single one below this length */
+#define DELTA_GAP 8
+
+static const char hexDigits[] = "0123456789ABCDEF";
+
+void delta_init(Delta *d)
+{
+    d->file = NULL;
+    d->changes = NULL;
+    d->count = 0;
+    d->capacity = 0;
+}
+
+void delta_free(Delta *d)
+{
+    size_t i;
+
+    for (i = 0; i < d->count; i++)
+    {
+        free(d->changes[i].before);
+        free(d->changes[i].after);
+    }
+
+    free(d->changes);
+    delta_init(d);
+}
+
+int delta_create(Delta *d, const char *path)
+{
+    if ((d->file = fopen(path, "wb")) == NULL)
+        return 0;
+
+    return fputs(DELTA_HEADER "\n", d->file) >= 0;
+}
+
+static int write_change(Delta *d, long offset, const unsigned char *before, const unsigned char *after, size_t len)
+{
+    char *line;
+    size_t i, j = 0;
+    unsigned long value = (unsigned long)offset;
+    int n, ret;
+
+    if ((line = malloc(4 * len + 24)) == NULL)
+        return 0;
+
+    /* The offset takes 8 digits at least, as in the listings */
+    for (n = 0; n < 8 || (value >> (4 * n)) != 0; n++);
+    while (n-- > 0)
+        line[j++] = hexDigits[(value >> (4 * n)) & 0xf];
+
+    line[j++] = ' ';
+    for (i = 0; i < len; i++)
+    {
+        line[j++] = hexDigits[before[i] >> 4];
+        line[j++] = hexDigits[before[i] & 0xf];
+    }
+
+    line[j++] = ' ';
+    for (i = 0; i < len; i++)
+    {
+        line[j++] = hexDigits[after[i] >> 4];
+        line[j++] = hexDigits[after[i] & 0xf];
+    }
+    line[j++] = '\n';
+
+    ret = fwrite(line, j, 1, d->file) == 1;
+    free(line);
+
+    return ret;
+}
+
+int delta_add(Delta *d, FILE *f, long offset, const char *data, size_t len)
+{
+    const unsigned char *after = (const unsigned char*)data;
+    unsigned char *before;
+    size_t i = 0, start, end, equal;
+    int ret = 1;
+
+    if (len == 0)
+        return 1;
+
+    /* The former bytes are read from the input, before it's overwritten */
+    if ((before = (unsigned char*)file_read_at(f, offset, len)) == NULL)
+        return 0;
+
+    /* Only the bytes which differ are recorded, the short runs left as they were being kept within a change */
+    while (i < len && ret)
+    {
+        for (; i < len && before[i] == after[i]; i++);
+        if (i >= len)
+            break;
+
+        start = end = i;
+        while (i < len)
+        {
+            if (before[i] != after[i])
+            {
+                end = ++i;
+                continue;
+            }
+
+            for (equal = i; i < len && before[i] == after[i] && i - equal < DELTA_GAP; i++);
+            if (i - equal >= DELTA_GAP || i >= len)
+                break;
+        }
+
+        ret = write_change(d, offset + (long)start, &before[start], &after[start], end - start);
+    }
+
+    free(before);
+
+    return ret;
+}
+
+int delta_add_ranges(Delta *d, FILE *f, long offset, const char *data, size_t len, const RangeList *ranges)
+{
+    size_t i;
+
+    /* Compare everything if the modified ranges are unknown */
+    if (ranges->whole)
+        return delta_add(d, f, offset, data, len);
+
+    for (i = 0; i < ranges->count; i++)
+    {
+        if (!delta_add(d, f, offset + (long)ranges->ranges[i].offset, &data[ranges->ranges[i].offset], ranges->ranges[i].len))
+            return 0;
+    }
+
+    return 1;
+}
+
+int delta_close(Delta *d)
+{
+    const int ret = d->file == NULL || fclose(d->file) == 0;
+
+    d->file = NULL;
+
+    return ret;
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+/* Decode a field of hexadecimal digits, returning its length (0 if it isn't one) */
+static size_t parse_field(const char *line, size_t len, size_t *pos)
+{
+    const size_t start = *pos;
+
+    while (*pos < len && hex_value(line[*pos]) >= 0)
+        (*pos)++;
+
+    return *pos - start;
+}
+
+static void decode_bytes(unsigned char *out, const char *hex, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++)
+        out[i] = (unsigned char)(hex_value(hex[2 * i]) << 4 | hex_value(hex[2 * i + 1]));
+}
+
+static int parse_change(Delta *d, const char *line, size_t len)
+{
+    size_t pos = 0, offsetLen, beforeLen, afterLen, i;
+    const char *before, *after;
+    unsigned long offset = 0;
+    DeltaChange *change;
+
+    /* <offset> <bytes before> <bytes after>, both sides being as long */
+    offsetLen = parse_field(line, len, &pos);
+    if (offsetLen == 0 || offsetLen > 2 * sizeof(long) || pos >= len || line[pos++] != ' ')
+        return 0;
+    before = &line[pos];
+    beforeLen = parse_field(line, len, &pos);
+    if (pos >= len || line[pos++] != ' ')
+        return 0;
+    after = &line[pos];
+    afterLen = parse_field(line, len, &pos);
+    if (pos != len || beforeLen == 0 || beforeLen % 2 != 0 || afterLen != beforeLen)
+        return 0;
+
+    for (i = 0; i < offsetLen; i++)
+        offset = offset << 4 | (unsigned long)hex_value(line[i]);
+    if (offset > (unsigned long)((~0UL) >> 1))
+        return 0;
+
+    if (d->count >= d->capacity)
+    {
+        const size_t capacity = d->capacity == 0 ? 64 : d->capacity * 2;
+
+        if ((change = realloc(d->changes, capacity * sizeof(DeltaChange))) == NULL)
+            return -1;
+
+        d->changes = change;
+        d->capacity = capacity;
+    }
+
+    change = &d->changes[d->count];
+    change->offset = (long)offset;
+    change->len = beforeLen / 2;
+    change->before = malloc(change->len);
+    change->after = malloc(change->len);
+    if (change->before == NULL || change->after == NULL)
+    {
+        free(change->before);
+        free(change->after);
+        return -1;
+    }
+
+    decode_bytes(change->before, before, change->len);
+    decode_bytes(change->after, after, change->len);
+    d->count++;
+
+    return 1;
+}
+
+int delta_load(Delta *d, const char *path)
+{
+    FILE *f;
+    char *text;
+    long size;
+    size_t pos = 0, end, len, line = 0;
+    int r, ret = 0;
+
+    if ((f = fopen(path, "rb")) == NULL)
+    {
+        report_error("Failed to open the patch file: %s!\n", strerror(errno));
+        return 3;
+    }
+
+    /* The patch is read whole, its changes being applied to every file */
+    if (fseek(f, 0, SEEK_END) != 0 || (size = ftell(f)) < 0 || (text = file_read_at(f, 0, (size_t)size)) == NULL)
+    {
+        report_error("Failed to read the patch file: %s!\n", strerror(errno));
+        fclose(f);
+        return 3;
+    }
+    fclose(f);
+
+    while (pos < (size_t)size && ret == 0)
+    {
+        for (end = pos; end < (size_t)size && text[end] != '\n'; end++);
+        len = end - pos;
+        if (len > 0 && text[end - 1] == '\r')
+            len--;
+        line++;
+
+        /* The header comes first, then a change per line (the empty lines and the comments being ignored) */
+        if (line == 1)
+        {
+            if (len != sizeof(DELTA_HEADER) - 1 || memcmp(&text[pos], DELTA_HEADER, len) != 0)
+            {
+                report_error("Failed to read the patch file: it isn't a patch!\n");
+                ret = 18;
+            }
+        }
+        else if (len > 0 && text[pos] != '#' && (r = parse_change(d, &text[pos], len)) != 1)
+        {
+            if (r < 0)
+            {
+                report_error("Failed to allocate memory for the patch: %s!\n", strerror(errno));
+                ret = 7;
+            }
+            else
+            {
+                report_error("Failed to read the patch file: malformed change on line %lu!\n", (unsigned long)line);
+                ret = 18;
+            }
+        }
+
+        pos = end + 1;
+    }
+
+    if (ret == 0 && line == 0)
+    {
+        report_error("Failed to read the patch file: it isn't a patch!\n");
+        ret = 18;
+    }
+
+    free(text);
+
+    return ret;
+}
+
+int delta_apply(const Delta *d, const char *target, int revert, size_t *written)
+{
+    char *pending = NULL, *current;
+    size_t i;
+    FILE *f;
+    int ret = DELTA_ALREADY;
+
+    *written = 0;
+
+    if ((f = fopen(target, "rb+")) == NULL)
+    {
+        report_error("Failed to open the input file %s: %s!\n", target, strerror(errno));
+        return 3;
+    }
+
+    if (d->count > 0 && (pending = calloc(d->count, 1)) == NULL)
+    {
+        report_error("Failed to allocate memory for the patch: %s!\n", strerror(errno));
+        fclose(f);
+        return 7;
+    }
+
+    /* Check the whole file first: every change must be either still to do, or done already (by an interrupted run) */
+    for (i = 0; i < d->count; i++)
+    {
+        const DeltaChange *c = &d->changes[i];
+        const unsigned char *from = revert ? c->after : c->before;
+        const unsigned char *to = revert ? c->before : c->after;
+
+        if ((current = file_read_at(f, c->offset, c->len)) == NULL)
+        {
+            report_error("Failed to read the input file %s at %08lX: it doesn't match the patch!\n", target, (unsigned long)c->offset);
+            ret = 18; goto RET;
+        }
+
+        if (memcmp(current, to, c->len) != 0)
+        {
+            if (memcmp(current, from, c->len) != 0)
+            {
+                report_error("The input file %s doesn't match the patch at %08lX!\n", target, (unsigned long)c->offset);
+                free(current);
+                ret = 18; goto RET;
+            }
+
+            pending[i] = 1;
+        }
+
+        free(current);
+    }
+
+    /* Then it's only a matter of seeking and writing */
+    for (i = 0; i < d->count; i++)
+    {
+        if (!pending[i])
+            continue;
+
+        if (fseek(f, d->changes[i].offset, SEEK_SET) != 0 || fwrite(revert ? d->changes[i].before : d->changes[i].after, d->changes[i].len, 1, f) != 1)
+        {
+            report_error("Failed to write to the input file: %s!\n", strerror(errno));
+            ret = 15; goto RET;
+        }
+
+        (*written)++;
+        ret = DELTA_APPLIED;
+    }
+
+    if (!file_sync(f))
+    {
+        report_error("Failed to write to the input file: %s!\n", strerror(errno));
+        ret = 15;
+    }
+
+  RET:
+
+    free(pending);
+    fclose(f);
+
+    return ret;
+}
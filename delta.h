@@ -0,0 +1,46 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Patch files recording the bytes changed in an executable, applied to or reverted from its copies.
+ */
+
+#ifndef DELTA_H_INCLUDED
+#define DELTA_H_INCLUDED
+
+#include <stdio.h>
+#include "ranges.h"
+
+#define DELTA_APPLIED 0     /* The changes were written */
+#define DELTA_ALREADY 1     /* The file already held the changes (the status of a string not found) */
+
+/* A range of the file with its bytes before and after the patch */
+typedef struct DeltaChange
+{
+    long offset;
+    size_t len;
+    unsigned char *before;
+    unsigned char *after;
+} DeltaChange;
+
+/* The changes of a patch file, in its order */
+typedef struct Delta
+{
+    FILE *file;
+    DeltaChange *changes;
+    size_t count;
+    size_t capacity;
+} Delta;
+
+void delta_init(Delta *d);
+void delta_free(Delta *d);
+
+int delta_create(Delta *d, const char *path);
+int delta_add(Delta *d, FILE *f, long offset, const char *data, size_t len);
+int delta_add_ranges(Delta *d, FILE *f, long offset, const char *data, size_t len, const RangeList *ranges);
+int delta_close(Delta *d);
+
+int delta_load(Delta *d, const char *path);
+int delta_apply(const Delta *d, const char *target, int revert, size_t *written);
+
+#endif
@@ -5,497 +5,443 @@
  * Provides ELF files reading functions.
  */
 
-#ifndef _WIN32
-#include <byteswap.h>
-#endif
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 #include <errno.h>
 #include "elffile.h"
-
-#define DEFAULT_SECTION ".rodata"
-
-#define IS_32_BITS(c) c == 1
-#define IS_LIT_ENDIAN(e) e == 1
-#define IS_BIG_ENDIAN(e) e == 2
-
-/* Provide functions to handle different endiannesses */
-
-static uint16_t swap_data_16(uint8_t endianness, uint16_t d)
-{
-#ifndef _WIN32
-#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
-    return IS_LIT_ENDIAN(endianness) ? bswap_16(d) : d;
-#else
-    return IS_BIG_ENDIAN(endianness) ? bswap_16(d) : d;
-#endif
-#else
-    /* Assume Windows is always little-endian */
-    return IS_BIG_ENDIAN(endianness) ? ((d << 8) | (d >> 8)) : d;
-#endif
-}
-
-static uint32_t swap_data_32(uint8_t endianness, uint32_t d)
-{
-#ifndef _WIN32
-#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
-    return IS_LIT_ENDIAN(endianness) ? bswap_32(d) : d;
-#else
-    return IS_BIG_ENDIAN(endianness) ? bswap_32(d) : d;
-#endif
-#else
-    /* Assume Windows is always little-endian */
-    return IS_BIG_ENDIAN(endianness) ?
-        (((d) & 0xff000000) >> 24) |
-        (((d) & 0x00ff0000) >>  8) |
-        (((d) & 0x0000ff00) <<  8) |
-        (((d) & 0x000000ff) << 24)
-        : d;
-#endif
-}
-
-static uint64_t swap_data_64(uint8_t endianness, uint64_t d)
-{
-#ifndef _WIN32
-#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
-    return IS_LIT_ENDIAN(endianness) ? bswap_64(d) : d;
-#else
-    return IS_BIG_ENDIAN(endianness) ? bswap_64(d) : d;
-#endif
-#else
-    /* Assume Windows is always little-endian */
-    return IS_BIG_ENDIAN(endianness) ?
-        (((d) & 0xff00000000000000ull) >> 56) |
-        (((d) & 0x00ff000000000000ull) >> 40) |
-        (((d) & 0x0000ff0000000000ull) >> 24) |
-        (((d) & 0x000000ff00000000ull) >>  8) |
-        (((d) & 0x00000000ff000000ull) <<  8) |
-        (((d) & 0x0000000000ff0000ull) << 24) |
-        (((d) & 0x000000000000ff00ull) << 40) |
-        (((d) & 0x00000000000000ffull) << 56)
-        : d;
-
-#endif
-}
-
-/* Useful to represent either 32-bits and 64-bits data */
-typedef union Word
-{
-    uint32_t e32;
-    uint64_t e64;
-} Word;
-
-/* Struct containing the attributes specific to decode ELF */
-typedef struct ElfAttrs
+#include "fileio.h"
+#include "process.h"
+#include "report.h"
+
+#define SHT_SYMTAB 2
+#define SHT_STRTAB 3
+#define SHT_RELA 4
+#define SHT_NOBITS 8
+#define SHT_DYNSYM 11
+#define SHF_ALLOC 0x2
+#define SHF_EXECINSTR 0x4
+#define SHF_STRINGS 0x20
+
+#define ET_DYN 3
+#define EM_X86_64 62
+#define R_X86_64_RELATIVE 8
+#define STT_FUNC 2
+#define STT_TLS 6
+#define STT_GNU_IFUNC 10
+#define SHN_UNDEF 0
+#define SHN_LORESERVE 0xff00
+#define SHN_XINDEX 0xffff
+
+#define ELFCLASS32 1
+#define ELFCLASS64 2
+#define ELFDATA2LSB 1
+#define ELFDATA2MSB 2
+
+/* Location of the fields in the executable header and in the entries of the section table, for each class */
+#define ELF32_HEADER_LEN 52
+#define ELF32_SHOFF      0x20
+#define ELF32_SHENTSIZE  0x2e
+#define ELF32_SHNUM      0x30
+#define ELF32_SHSTRNDX   0x32
+#define ELF32_SH_LEN     40
+#define ELF32_SH_ADDR    12
+#define ELF32_SH_OFFSET  16
+#define ELF32_SH_SIZE    20
+#define ELF32_SH_LINK    24
+
+#define ELF64_HEADER_LEN 64
+#define ELF64_SHOFF      0x28
+#define ELF64_SHENTSIZE  0x3a
+#define ELF64_SHNUM      0x3c
+#define ELF64_SHSTRNDX   0x3e
+#define ELF64_SH_LEN     64
+#define ELF64_SH_ADDR    16
+#define ELF64_SH_OFFSET  24
+#define ELF64_SH_SIZE    32
+#define ELF64_SH_LINK    40
+
+/* Decode the fields read in memory in either byte order, whatever the one of the host */
+#define LOAD_LE16(p) ((uint16_t)((p)[0] | ((p)[1] << 8)))
+#define LOAD_BE16(p) ((uint16_t)(((p)[0] << 8) | (p)[1]))
+#define LOAD_LE32(p) ((uint32_t)(p)[0] | ((uint32_t)(p)[1] << 8) | ((uint32_t)(p)[2] << 16) | ((uint32_t)(p)[3] << 24))
+#define LOAD_BE32(p) (((uint32_t)(p)[0] << 24) | ((uint32_t)(p)[1] << 16) | ((uint32_t)(p)[2] << 8) | (uint32_t)(p)[3])
+#define LOAD_LE64(p) ((uint64_t)LOAD_LE32(p) | ((uint64_t)LOAD_LE32((p) + 4) << 32))
+#define LOAD_BE64(p) (((uint64_t)LOAD_BE32(p) << 32) | (uint64_t)LOAD_BE32((p) + 4))
+
+/* The fields of the executable header locating the section table */
+typedef struct ElfHeader
 {
-    uint8_t class;
-    uint8_t endianness;
-} ElfAttrs;
-
-static Word swap_data_word(uint8_t endianness, uint8_t class, Word w)
+    uint16_t type;
+    uint16_t machine;
+    uint64_t sectionTableAddress;
+    size_t sectionTableSize;
+    size_t sectionTableLen;
+    size_t sectionTableNames;
+} ElfHeader;
+
+/* Decoder of a class and a byte order, chosen once from the identification of the file */
+typedef struct ElfReader
 {
-    if (IS_32_BITS(class))
-        w.e32 = swap_data_32(endianness, w.e32);
-    else
-        w.e64 = swap_data_64(endianness, w.e64);
-
-    return w;
-}
-
-static long word_to_long(uint8_t class, Word w)
-{
-    if (IS_32_BITS(class))
-        return (long)w.e32;
-    else
-        return (long)w.e64;
-}
-
-static int read_word(FILE *f, Word *ptr, uint8_t class)
-{
-    const size_t r;
-    if (IS_32_BITS(r))
-        return fread(&ptr->e32, sizeof(uint32_t), 1, f);
-    else
-        return fread(&ptr->e64, sizeof(uint64_t), 1, f);
-}
-
-static int advance_and_read(FILE *f, void *ptr, size_t size, long int offset)
-{
-    if (fseek(f, offset, SEEK_CUR) != 0)
-        return 0;
-
-    if (fread(ptr, size, 1, f) != 1)
-        return 0;
-
-    return 1;
-}
-
-static int advance_and_read_word(FILE *f, Word *ptr, uint8_t class, long int offset)
-{
-    if (fseek(f, offset, SEEK_CUR) != 0)
-        return 0;
-
-    if (read_word(f, ptr, class) != 1)
-        return 0;
-
-    return 1;
-}
-
-static int write_input_to_output_until(FILE *in, FILE *out, long offset)
-{
-    char buffer[1024];
-    long i = 0, l;
-
-    /* Write by chunks of 1024, until the offset is near */
-    while (i + 1024 < offset)
-    {
-        if (fread(buffer, sizeof(buffer), 1, in) != 1)
-        {
-            fprintf(stderr, "Failed to read from the input file: %s!\n", strerror(errno));
-            return 0;
-        }
-        if (fwrite(buffer, sizeof(buffer), 1, out) != 1)
-        {
-            fprintf(stderr, "Failed to write to the output file: %s!\n", strerror(errno));
-            return 0;
-        }
-        i += 1024;
+    int is32;
+    int bigEndian;
+    size_t headerLen;
+    size_t entryLen;
+    void (*header)(const unsigned char *h, ElfHeader *eh);
+    void (*sections)(const unsigned char *entries, size_t count, size_t entrySize, const char *names, uint64_t namesLen, Section *sections);
+    uint32_t (*link)(const unsigned char *entry);
+    uint64_t (*load64)(const unsigned char *p);
+} ElfReader;
+
+/* Generate the decoder of a class (32 or 64) in a byte order (LE or BE), its fields being loaded without any test */
+#define ELF_READER(C, E) \
+    static void header_##C##E(const unsigned char *h, ElfHeader *eh) \
+    { \
+        eh->type = LOAD_##E##16(&h[0x10]); \
+        eh->machine = LOAD_##E##16(&h[0x12]); \
+        eh->sectionTableAddress = LOAD_##E##C(&h[ELF##C##_SHOFF]); \
+        eh->sectionTableSize = LOAD_##E##16(&h[ELF##C##_SHENTSIZE]); \
+        eh->sectionTableLen = LOAD_##E##16(&h[ELF##C##_SHNUM]); \
+        eh->sectionTableNames = LOAD_##E##16(&h[ELF##C##_SHSTRNDX]); \
+    } \
+    \
+    static void sections_##C##E(const unsigned char *entries, size_t count, size_t entrySize, const char *names, uint64_t namesLen, Section *sections) \
+    { \
+        const unsigned char *entry = entries; \
+        size_t i; \
+        \
+        for (i = 0; i < count; i++, entry += entrySize) \
+        { \
+            Section *s = &sections[i]; \
+            const uint32_t nameIndex = LOAD_##E##32(entry); \
+            \
+            s->name = nameIndex < namesLen ? &names[nameIndex] : ""; \
+            s->type = LOAD_##E##32(&entry[4]); \
+            s->flags = LOAD_##E##C(&entry[8]); \
+            s->address = LOAD_##E##C(&entry[ELF##C##_SH_ADDR]); \
+            s->offset = (long)LOAD_##E##C(&entry[ELF##C##_SH_OFFSET]); \
+            s->memSize = LOAD_##E##C(&entry[ELF##C##_SH_SIZE]); \
+            s->size = s->type == SHT_NOBITS ? 0 : (size_t)s->memSize; \
+        } \
+    } \
+    \
+    static uint32_t link_##C##E(const unsigned char *entry) \
+    { \
+        return LOAD_##E##32(&entry[ELF##C##_SH_LINK]); \
+    } \
+    \
+    static uint64_t load64_##C##E(const unsigned char *p) \
+    { \
+        return LOAD_##E##64(p); \
     }
 
-    /* Compute the remaining length */
-    l = offset - i;
+ELF_READER(32, LE)
+ELF_READER(32, BE)
+ELF_READER(64, LE)
+ELF_READER(64, BE)
 
-    if (fread(buffer, l, 1, in) != 1)
-    {
-        fprintf(stderr, "Failed to read from the input file: %s!\n", strerror(errno));
-        return 0;
-    }
-    if (fwrite(buffer, l, 1, out) != 1)
-    {
-        fprintf(stderr, "Failed to write to the output file: %s!\n", strerror(errno));
-        return 0;
-    }
-
-    return 1;
-}
+#define ELF_READER_ENTRY(C, E, bigEndian) \
+    { C == 32, bigEndian, ELF##C##_HEADER_LEN, ELF##C##_SH_LEN, header_##C##E, sections_##C##E, link_##C##E, load64_##C##E }
 
-static int write_input_to_output_end(FILE *in, FILE *out)
+static const ElfReader readers[4] =
 {
-    char buffer[1024];
-    long i, l, end;
-
-    /* Get the end position of the file */
-    i = ftell(in);
-    fseek(in, 0, SEEK_END);
-    end = ftell(in);
-    fseek(in, i, SEEK_SET);
-
-    /* Write by chunks of 1024, until the end */
-    while (i + 1024 < end)
-    {
-        if (fread(buffer, sizeof(buffer), 1, in) != 1)
-        {
-            fprintf(stderr, "Failed to read from the input file: %s!\n", strerror(errno));
-            return 0;
-        }
-        if (fwrite(buffer, sizeof(buffer), 1, out) != 1)
-        {
-            fprintf(stderr, "Failed to write to the output file: %s!\n", strerror(errno));
-            return 0;
-        }
-        i += 1024;
-    }
-
-    /* Compute the remaining length */
-    l = end - i;
+    ELF_READER_ENTRY(32, LE, 0),
+    ELF_READER_ENTRY(32, BE, 1),
+    ELF_READER_ENTRY(64, LE, 0),
+    ELF_READER_ENTRY(64, BE, 1)
+};
 
-    if (fread(buffer, l, 1, in) != 1)
-    {
-        fprintf(stderr, "Failed to read from the input file: %s!\n", strerror(errno));
-        return 0;
-    }
-    if (fwrite(buffer, l, 1, out) != 1)
-    {
-        fprintf(stderr, "Failed to write to the output file: %s!\n", strerror(errno));
-        return 0;
-    }
+static const ElfReader *elf_reader(const unsigned char *ident)
+{
+    /* The class and the byte order follow the magic number */
+    if ((ident[4] != ELFCLASS32 && ident[4] != ELFCLASS64) || (ident[5] != ELFDATA2LSB && ident[5] != ELFDATA2MSB))
+        return NULL;
 
-    return 1;
+    return &readers[(ident[4] == ELFCLASS64 ? 2 : 0) + (ident[5] == ELFDATA2MSB ? 1 : 0)];
 }
 
-static int elf_find_strings_section(FILE *in, const char *section, Word *sectionStringsAddress, Word *sectionStringsLen, ElfAttrs *attrs)
+static int elf_read_sections(Source *in, SectionTable *table, Arena *arena)
 {
-    uint16_t sectionTableLen, sectionTableSize, sectionTableNames, i;
-    uint32_t sectionNameIndex;
-    Word sectionTableAddress, sectionNamesAddress, sectionNamesLen;
-    char *shstrtab = NULL;
-    size_t shstrtab_len;
-    long sections_addr;
-    int ret = 0;
-
-    /* Assume the magic number has already been read */
-
-    sectionStringsAddress->e64 = 0;
-    sectionStringsLen->e64 = 0;
-
-    /* Read the class to find out whether the executable is 32 or 64 bits */
-    if (fread(&attrs->class, sizeof(uint8_t), 1, in) != 1)
-    {
-        fprintf(stderr, "Failed to read executable header: %s!\n", strerror(errno));
-        return 5;
-    }
-
-    /* Read the endianness */
-    if (fread(&attrs->endianness, sizeof(uint8_t), 1, in) != 1)
+    const ElfReader *reader;
+    ElfHeader eh;
+    unsigned char header[64];
+    unsigned char *entries;
+    Section names;
+    size_t headerLen;
+    long size;
+
+    /* Read the whole executable header at once */
+    if ((headerLen = source_read(in, 0, header, sizeof(header))) < ELF32_HEADER_LEN)
     {
-        fprintf(stderr, "Failed to read executable header: %s!\n", strerror(errno));
+        report_error("Failed to read executable header: %s!\n", strerror(errno));
         return 5;
     }
 
-    /* Read the absolute location of the section table */
-    if (!advance_and_read_word(in, &sectionTableAddress, attrs->class, IS_32_BITS(attrs->class) ? 26 : 34))
+    /* Find out whether the executable is 32 or 64 bits, and its endianness */
+    if ((reader = elf_reader(header)) == NULL)
     {
-        fprintf(stderr, "Failed to read executable header: %s!\n", strerror(errno));
+        report_error("Failed to read executable header: bad class or data encoding (%u, %u)!\n", header[4], header[5]);
         return 5;
     }
-    sectionTableAddress = swap_data_word(attrs->endianness, attrs->class, sectionTableAddress);
-
-    /* Read the size of an entry in the section table */
-    if (!advance_and_read(in, &sectionTableSize, sizeof(uint16_t), 10))
+    if (headerLen < reader->headerLen)
     {
-        fprintf(stderr, "Failed to read executable header: %s!\n", strerror(errno));
+        report_error("Failed to read executable header: %s!\n", strerror(errno));
         return 5;
     }
-    sectionTableSize = swap_data_16(attrs->endianness, sectionTableSize);
 
-    /* Read the length of the section table */
-    if (fread(&sectionTableLen, sizeof(uint16_t), 1, in) != 1)
-    {
-        fprintf(stderr, "Failed to read executable header: %s!\n", strerror(errno));
-        return 5;
-    }
-    sectionTableLen = swap_data_16(attrs->endianness, sectionTableLen);
+    /* Get the location of the section table, the size of its entries, their count and the index of the names */
+    reader->header(header, &eh);
 
-    /* Read the location of the section names */
-    if (fread(&sectionTableNames, sizeof(uint16_t), 1, in) != 1)
+    /* Without a section table, its first entry (holding the extended count) would be the executable header */
+    if (eh.sectionTableAddress == 0)
     {
-        fprintf(stderr, "Failed to read executable header: %s!\n", strerror(errno));
-        return 5;
-    }
-    sectionTableNames = swap_data_16(attrs->endianness, sectionTableNames);
-
-    /* Goto the section table */
-    sections_addr = word_to_long(attrs->class, sectionTableAddress);
-    if (fseek(in, sections_addr, SEEK_SET) != 0)
-    {
-        fprintf(stderr, "Failed to go to the section headers table: %s!\n", strerror(errno));
+        report_error("Failed to go to the section headers table: the executable has none!\n");
         return 6;
     }
 
-    /* Seek the section names header */
-    if (fseek(in, sectionTableNames * sectionTableSize, SEEK_CUR) != 0)
+    if (eh.sectionTableSize < reader->entryLen)
     {
-        fprintf(stderr, "Failed to go to the section name table: %s!\n", strerror(errno));
+        report_error("Failed to read the section headers table: bad entry size!\n");
         return 6;
     }
 
-    /* Read the offset of the section names */
-    if (!advance_and_read_word(in, &sectionNamesAddress, attrs->class, IS_32_BITS(attrs->class) ? 16 : 24))
+    /* With many sections, the real count and index of the names are stored in the first entry */
+    if (eh.sectionTableLen == 0 || eh.sectionTableNames == 0xffff)
     {
-        fprintf(stderr, "Failed to read the section names header: %s!\n", strerror(errno));
-        return 6;
+        Section first;
+
+        if ((entries = (unsigned char*)source_read_at(in, (long)eh.sectionTableAddress, eh.sectionTableSize, arena)) == NULL)
+        {
+            report_error("Failed to go to the section headers table: %s!\n", strerror(errno));
+            return 6;
+        }
+
+        reader->sections(entries, 1, eh.sectionTableSize, "", 0, &first);
+        if (eh.sectionTableLen == 0)
+            eh.sectionTableLen = first.size;
+        if (eh.sectionTableNames == 0xffff)
+            eh.sectionTableNames = reader->link(entries);
     }
-    sectionNamesAddress = swap_data_word(attrs->endianness, attrs->class, sectionNamesAddress);
 
-    /* Read the length of the section names */
-    if (read_word(in, &sectionNamesLen, attrs->class) != 1)
+    /* The count is checked against the input (as far as it's known), so that the sizes of the table don't wrap around */
+    size = source_size(in);
+    if (eh.sectionTableLen > ((size_t)-1 - 1) / eh.sectionTableSize || eh.sectionTableLen > ((size_t)-1) / sizeof(Section) ||
+        (size >= 0 && ((uint64_t)size < eh.sectionTableAddress || eh.sectionTableLen > ((uint64_t)size - eh.sectionTableAddress) / eh.sectionTableSize)))
     {
-        fprintf(stderr, "Failed to read the section names header: %s!\n", strerror(errno));
+        report_error("Failed to read the section headers table: bad entry count!\n");
         return 6;
     }
-    sectionNamesLen = swap_data_word(attrs->endianness, attrs->class, sectionNamesLen);
 
-    /* Goto the section names */
-    if (fseek(in, word_to_long(attrs->class, sectionNamesAddress), SEEK_SET) != 0)
+    if (eh.sectionTableNames >= eh.sectionTableLen)
     {
-        fprintf(stderr, "Failed to go to the section name table: %s!\n", strerror(errno));
+        report_error("Failed to go to the section name table: bad index!\n");
         return 6;
     }
 
-    /* Allocate enough memory to read the string */
-    shstrtab_len = word_to_long(attrs->class, sectionNamesLen);
-    if ((shstrtab = malloc(shstrtab_len)) == NULL)
+    /* Read the whole section table at once (everything is kept in the arena, until the file is done) */
+    if ((entries = (unsigned char*)source_read_at(in, (long)eh.sectionTableAddress, eh.sectionTableLen * eh.sectionTableSize, arena)) == NULL)
     {
-        fprintf(stderr, "Failed to allocate memory for section names: %s!\n", strerror(errno));
-        return 7;
+        report_error("Failed to go to the section headers table: %s!\n", strerror(errno));
+        return 6;
     }
 
     /* Read the full section names table */
-    if (fread(shstrtab, shstrtab_len, 1, in) != 1)
+    reader->sections(&entries[eh.sectionTableNames * eh.sectionTableSize], 1, eh.sectionTableSize, "", 0, &names);
+    if ((size >= 0 && (names.offset < 0 || names.offset > size || names.size > (size_t)(size - names.offset))) ||
+        names.size == (size_t)-1 || (table->names = source_read_at(in, names.offset, names.size, arena)) == NULL)
     {
-        fprintf(stderr, "Failed to read the section names: %s!\n", strerror(errno));
-        ret = 7; goto RET;
+        report_error("Failed to read the section names: %s!\n", strerror(errno));
+        return 7;
     }
 
-    /* Return to the section table */
-    if (fseek(in, sections_addr, SEEK_SET) != 0)
+    if ((table->sections = arena_alloc(arena, eh.sectionTableLen * sizeof(Section))) == NULL)
     {
-        fprintf(stderr, "Failed to go to the section headers table: %s!\n", strerror(errno));
-        ret = 6; goto RET;
+        report_error("Failed to allocate memory for the sections: %s!\n", strerror(errno));
+        return 7;
     }
 
-    /* Iterate through the list of entries */
-    for (i = 0; i < sectionTableLen; i++)
-    {
-        /* Read the section name index */
-        if (fread(&sectionNameIndex, sizeof(uint32_t), 1, in) != 1)
-            goto NEXT;
+    /* Decode the entries in a single pass, specialized for the class and the byte order */
+    reader->sections(entries, eh.sectionTableLen, eh.sectionTableSize, table->names, names.size, table->sections);
+    table->count = eh.sectionTableLen;
 
-        /* Check the name of the section against the desired section name */
-        if (strcmp(section, &shstrtab[sectionNameIndex]) == 0)
-        {
-            /* If match, retrieve its offset and length */
-            if (!advance_and_read_word(in, sectionStringsAddress, attrs->class, IS_32_BITS(attrs->class) ? 12 : 20))
-            {
-                fprintf(stderr, "Failed to iterate over the list of sections: %s!\n", strerror(errno));
-                ret = 8; goto RET;
-            }
-            *sectionStringsAddress = swap_data_word(attrs->endianness, attrs->class, *sectionStringsAddress);
-
-            if (read_word(in, sectionStringsLen, attrs->class) != 1)
-            {
-                fprintf(stderr, "Failed to iterate over the list of sections: %s!\n", strerror(errno));
-                ret = 8; goto RET;
-            }
-            *sectionStringsLen = swap_data_word(attrs->endianness, attrs->class, *sectionStringsLen);
-
-            break;
-        }
+    return 0;
+}
 
-      NEXT:
+int elf_is_strings(const Section *s)
+{
+    /* Sections flagged as strings, the string tables loaded at runtime, and the usual read-only data */
+    return s->type != SHT_NOBITS &&
+        ((s->flags & SHF_STRINGS) ||
+         (s->type == SHT_STRTAB && (s->flags & SHF_ALLOC)) ||
+         strcmp(s->name, ELF_DEFAULT_SECTION) == 0);
+}
 
-        /* Advance to the next entry */
-        if (fseek(in, sectionTableSize - sizeof(uint32_t), SEEK_CUR) != 0)
-        {
-            fprintf(stderr, "Failed to iterate over the list of sections: %s!\n", strerror(errno));
-            ret = 8; goto RET;
-        }
-    }
+static int read_slot(FILE *in, const SectionTable *table, uint64_t address, const ElfReader *reader, long *offset, uint64_t *value)
+{
+    const Section *s = sections_at(table, address, 8);
+    unsigned char slot[8];
 
-    if (sectionStringsAddress->e64 == 0)
-    {
-        fprintf(stderr, "Failed to find section named %s!\n", section);
-        ret = 9;
-    }
+    /* Find the location of an address of the image in the file */
+    if (s == NULL || s->type == SHT_NOBITS)
+        return 0;
 
-  RET:
+    *offset = s->offset + (long)(address - s->address);
+    if (fseek(in, *offset, SEEK_SET) != 0 || fread(slot, sizeof(slot), 1, in) != 1)
+        return 0;
 
-    /* Free the allocated memory */
-    free(shstrtab);
+    *value = reader->load64(slot);
 
-    return ret;
+    return 1;
 }
 
-int elf_process(FILE *in, FILE *out, const char *section, const char *search, const char *replace, int exact)
+static int elf_find_refs(FILE *in, const SectionTable *table, RefList *refs)
 {
-    ElfAttrs attrs;
-    Word sectionStringsAddress, sectionStringsLen;
-    size_t strtab_len;
-    char *strtab = NULL;
-    long strtab_loc;
-    int ret = 0;
-
-    /* Pick a default section in case none is specified */
-    if (section == NULL)
-        section = DEFAULT_SECTION;
-
-    /* Start by finding the strings section location */
-    if ((ret = elf_find_strings_section(in, section, &sectionStringsAddress, &sectionStringsLen, &attrs)) != 0)
-        return ret;
-
-    /* Write everything before the strings section to the output (if specified) */
-    strtab_loc = word_to_long(attrs.class, sectionStringsAddress);
-    if (out != NULL)
+    const ElfReader *reader;
+    ElfHeader eh;
+    unsigned char header[64];
+    unsigned char *data;
+    uint64_t target, value;
+    size_t i, j;
+    long slot;
+    int ok = 1;
+
+    if (fseek(in, 0, SEEK_SET) != 0 || fread(header, sizeof(header), 1, in) != 1)
     {
-        if (fseek(in, 0, SEEK_SET) != 0)
-        {
-            fprintf(stderr, "Failed to write to the output file: %s!\n", strerror(errno));
-            return 14;
-        }
-        if (!write_input_to_output_until(in, out, strtab_loc))
-            return 14;
+        report_error("Failed to read executable header: %s!\n", strerror(errno));
+        return 0;
     }
 
-    /* Goto the location */
-    if (fseek(in, strtab_loc, SEEK_SET) != 0)
+    /* Only the position-independent code has all its references to the data known (relocated or relative) */
+    if ((reader = elf_reader(header)) != NULL)
+        reader->header(header, &eh);
+    if (reader == NULL || reader->is32 || eh.type != ET_DYN || eh.machine != EM_X86_64)
     {
-        fprintf(stderr, "Failed to go to the strings section: %s!\n", strerror(errno));
-        return 10;
+        report_error("Failed to find the references to the strings: only the position-independent x86-64 executables are supported!\n");
+        return 0;
     }
 
-    /* Allocate memory for the whole strings table */
-    strtab_len = word_to_long(attrs.class, sectionStringsLen);
-    if ((strtab = malloc(strtab_len)) == NULL)
+    /* The symbols are known before the code is scanned, the data it holds being told apart */
+    for (i = 0; i < 2 * table->count && ok; i++)
     {
-        fprintf(stderr, "Failed to allocate memory for strings table: %s!\n", strerror(errno));
-        return 13;
-    }
+        const Section *s = &table->sections[i % table->count];
+        const int code = i >= table->count;
 
-    /* Read the whole strings table */
-    if (fread(strtab, strtab_len, 1, in) != 1)
-    {
-        fprintf(stderr, "Failed to read the strings table: %s!\n", strerror(errno));
-        ret = 13; goto RET;
-    }
+        if (s->size == 0 || s->type == SHT_NOBITS ||
+            (code ? !(s->flags & SHF_EXECINSTR) : s->type != SHT_RELA && s->type != SHT_SYMTAB && s->type != SHT_DYNSYM))
+            continue;
 
-    if (replace != NULL)
-    {
-        /* Search for the occurrence of the search in the list of strings */
-        if (exact == 0)
-            ret = search_and_replace(strtab, search, replace, strtab_len);
-        else
-            ret = search_and_replace_exact(strtab, search, replace, strtab_len);
+        if ((data = (unsigned char*)file_read_at(in, s->offset, s->size)) == NULL)
+        {
+            report_error("Failed to read the section %s: %s!\n", s->name, strerror(errno));
+            return 0;
+        }
+
+        if (code)
+            ok = refs_scan_code(refs, data, s->size, s->offset, s->address);
 
-        /* Write the modified strings table into either the output or the input file */
-        if (out != NULL)
+        /* The pointers to the data are relocated by the loader, from their addend */
+        else if (s->type == SHT_RELA)
         {
-            if (fwrite(strtab, strtab_len, 1, out) != 1)
+            for (j = 0; j + 24 <= s->size && ok; j += 24)
             {
-                fprintf(stderr, "Failed to write to the output file: %s!\n", strerror(errno));
-                return 14;
-            }
+                if ((reader->load64(&data[j + 8]) & 0xffffffff) != R_X86_64_RELATIVE)
+                    continue;
+
+                target = reader->load64(&data[j + 16]);
+                ok = refs_push(refs, s->offset + (long)j + 16, REF_ABS64, reader->bigEndian, 0, target);
 
-            /* Write the rest of the file to the output */
-            if (!write_input_to_output_end(in, out))
-                return 14;
+                /* The linker may have written the address in the pointer as well */
+                if (ok && read_slot(in, table, reader->load64(&data[j]), reader, &slot, &value) && value == target)
+                    ok = refs_push(refs, slot, REF_ABS64, reader->bigEndian, 0, target);
+            }
         }
         else
         {
-            /* Return to the strings table location */
-            if (fseek(in, strtab_loc, SEEK_SET) != 0)
+            /* The named data keep their whole extent, e.g. the arrays padded with zeros or the tables within the code */
+            for (j = 0; j + 24 <= s->size && ok; j += 24)
             {
-                fprintf(stderr, "Failed to go to the strings section: %s!\n", strerror(errno));
-                return 10;
-            }
+                const int type = data[j + 4] & 0xf;
+                const unsigned int index = reader->bigEndian ? (unsigned int)data[j + 6] << 8 | data[j + 7] : data[j + 6] | (unsigned int)data[j + 7] << 8;
 
-            if (fwrite(strtab, strtab_len, 1, in) != 1)
-            {
-                fprintf(stderr, "Failed to write to the input file: %s!\n", strerror(errno));
-                return 15;
+                /* Only the defined symbols have an address (those of the thread-local storage an offset) */
+                if (type != STT_FUNC && type != STT_GNU_IFUNC && type != STT_TLS && index != SHN_UNDEF && (index < SHN_LORESERVE || index == SHN_XINDEX))
+                    ok = refs_reserve(refs, reader->load64(&data[j + 8]), reader->load64(&data[j + 16]));
             }
         }
+
+        free(data);
     }
-    else
+
+    if (!ok)
+        report_error("Failed to allocate memory for the references: %s!\n", strerror(errno));
+
+    return ok;
+}
+
+int elf_process(FILE *in, FILE *out, const RuleSet *rules, const Options *opts, Cache *cache, Journal *journal, Delta *delta, Arena *arena, Stats *stats)
+{
+    SectionTable table;
+    const SectionTable *sections;
+    Source source;
+    double start = stats_now();
+    int ret = 0;
+
+    /* Start by parsing the section table (unless it's known from the index) */
+    sections_init(&table);
+    source_init(&source, in, 0);
+    if ((sections = cache_sections(cache)) == NULL && (ret = elf_read_sections(&source, &table, arena)) == 0)
     {
-        /* Just lay down the list of strings in the section (with their offset) */
-        print_strings(strtab, strtab_loc, strtab_len);
+        cache_put_sections(cache, &table);
+        sections = &table;
     }
+    stats_phase(stats, PHASE_HEADERS, start);
 
-  RET:
+    if (sections != NULL)
+        ret = process_sections(in, out, sections, ELF_DEFAULT_SECTION, elf_is_strings, elf_find_refs, rules, opts, cache, journal, delta, arena, stats);
+
+    return ret;
+}
+
+int elf_stream(Source *in, FILE *out, const RuleSet *rules, const Options *opts, Arena *arena, Stats *stats)
+{
+    SectionTable table;
+    double start = stats_now();
+    int ret;
 
-    /* Free the allocated memory */
-    free(strtab);
+    /* The headers are buffered as they're read, up to the section table */
+    sections_init(&table);
+    ret = elf_read_sections(in, &table, arena);
+    stats_phase(stats, PHASE_HEADERS, start);
+    if (ret == 0)
+        ret = process_stream(in, out, &table, ELF_DEFAULT_SECTION, elf_is_strings, rules, opts, arena, stats);
 
     return ret;
 }
+
+int elf_probe(const char *data, size_t len, const RuleSet *rules, const Options *opts, Arena *arena, Stats *stats, unsigned long *count)
+{
+    SectionTable table;
+    Source source;
+    double start = stats_now();
+    int ret;
+
+    /* The headers are parsed from the mapped file, without reading it */
+    sections_init(&table);
+    source_memory(&source, data, len);
+    ret = elf_read_sections(&source, &table, arena);
+    stats_phase(stats, PHASE_HEADERS, start);
+    if (ret == 0)
+        ret = process_probe(data, len, &table, ELF_DEFAULT_SECTION, elf_is_strings, rules, opts, arena, stats, count);
+
+    return ret;
+}
+
+int elf_read_table(FILE *in, SectionTable *table, Arena *arena)
+{
+    Source source;
+
+    sections_init(table);
+    source_init(&source, in, 0);
+
+    return elf_read_sections(&source, table, arena);
+}
@@ -9,7 +9,17 @@
 #define ELFFILE_H_INCLUDED
 
 #include <stdio.h>
+#include "rules.h"
+#include "process.h"
 
-int elf_process(FILE *in, FILE *out, const char *section, const char *search, const char *replace, int exact);
+#define ELF_DEFAULT_SECTION ".rodata"
+
+int elf_process(FILE *in, FILE *out, const RuleSet *rules, const Options *opts, Cache *cache, Journal *journal, Delta *delta, Arena *arena, Stats *stats);
+int elf_stream(Source *in, FILE *out, const RuleSet *rules, const Options *opts, Arena *arena, Stats *stats);
+int elf_probe(const char *data, size_t len, const RuleSet *rules, const Options *opts, Arena *arena, Stats *stats, unsigned long *count);
+
+/* The table of the sections and how the strings are found in them, for the library */
+int elf_read_table(FILE *in, SectionTable *table, Arena *arena);
+int elf_is_strings(const Section *s);
 
 #endif
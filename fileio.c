@@ -0,0 +1,543 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Provides access to the content of the files, memory-mapped whenever possible.
+ */
+
+#define _GNU_SOURCE
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <linux/fs.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "fileio.h"
+#include "report.h"
+
+#define COPY_BUFFER_SIZE (1024 * 1024)
+
+#ifdef _WIN32
+
+static size_t granularity(void)
+{
+    SYSTEM_INFO info;
+
+    /* The views must start on a multiple of the allocation granularity */
+    GetSystemInfo(&info);
+    return info.dwAllocationGranularity;
+}
+
+static int map_range(Mapping *m, FILE *f, long offset, size_t len, int mode)
+{
+    const size_t align = (size_t)offset % granularity();
+    const unsigned long long start = (unsigned long long)offset - align;
+    HANDLE file, view;
+
+    file = (HANDLE)_get_osfhandle(_fileno(f));
+    if (file == INVALID_HANDLE_VALUE)
+        return 0;
+
+    view = CreateFileMapping(file, NULL, mode == MAPPING_SHARED ? PAGE_READWRITE : PAGE_READONLY, 0, 0, NULL);
+    if (view == NULL)
+        return 0;
+
+    m->base = MapViewOfFile(view,
+        mode == MAPPING_SHARED ? FILE_MAP_WRITE : (mode == MAPPING_PRIVATE ? FILE_MAP_COPY : FILE_MAP_READ),
+        (DWORD)(start >> 32), (DWORD)(start & 0xffffffff), len + align);
+
+    /* The view keeps the mapping object alive */
+    CloseHandle(view);
+
+    if (m->base == NULL)
+        return 0;
+
+    m->baseLen = len + align;
+    m->data = (char*)m->base + align;
+
+    return 1;
+}
+
+static int unmap_range(Mapping *m)
+{
+    return UnmapViewOfFile(m->base) != 0;
+}
+
+#else
+
+static int map_range(Mapping *m, FILE *f, long offset, size_t len, int mode)
+{
+    const size_t align = (size_t)offset % (size_t)sysconf(_SC_PAGESIZE);
+    void *base;
+
+    /* The mappings must start on a page boundary */
+    base = mmap(NULL, len + align,
+        mode == MAPPING_READ ? PROT_READ : PROT_READ | PROT_WRITE,
+        mode == MAPPING_SHARED ? MAP_SHARED : MAP_PRIVATE,
+        fileno(f), (off_t)offset - (off_t)align);
+
+    if (base == MAP_FAILED)
+        return 0;
+
+    m->base = base;
+    m->baseLen = len + align;
+    m->data = (char*)base + align;
+
+    return 1;
+}
+
+static int unmap_range(Mapping *m)
+{
+    return munmap(m->base, m->baseLen) == 0;
+}
+
+#endif
+
+int mapping_open(Mapping *m, FILE *f, long offset, size_t len, int mode)
+{
+    m->data = NULL;
+    m->len = len;
+    m->base = NULL;
+    m->baseLen = 0;
+    m->mapped = 0;
+    m->mode = mode;
+    m->file = f;
+    m->offset = offset;
+
+    /* Make sure the mapping won't miss any pending write */
+    fflush(f);
+
+    /* Accessing a mapping past the end of the file would crash */
+    if (fseek(f, 0, SEEK_END) != 0 || ftell(f) < offset || (size_t)(ftell(f) - offset) < len)
+    {
+        report_error("Failed to read the strings table: the section exceeds the file!\n");
+        return 0;
+    }
+
+    if (len > 0 && map_range(m, f, offset, len, mode))
+    {
+        m->mapped = 1;
+        return 1;
+    }
+
+    /* Fall back on reading the range in memory (e.g. if the file can't be mapped) */
+    if ((m->data = malloc(len > 0 ? len : 1)) == NULL)
+    {
+        report_error("Failed to allocate memory for strings table: %s!\n", strerror(errno));
+        return 0;
+    }
+
+    if (fseek(f, offset, SEEK_SET) != 0)
+    {
+        report_error("Failed to go to the strings section: %s!\n", strerror(errno));
+        free(m->data);
+        return 0;
+    }
+
+    if (len > 0 && fread(m->data, len, 1, f) != 1)
+    {
+        report_error("Failed to read the strings table: %s!\n", strerror(errno));
+        free(m->data);
+        return 0;
+    }
+
+    return 1;
+}
+
+int mapping_close(Mapping *m, const RangeList *dirty)
+{
+    int ret = 1;
+
+    if (m->mapped)
+    {
+        /* The shared mappings write back their modified pages by themselves */
+        if (!unmap_range(m))
+        {
+            report_error("Failed to write to the input file: %s!\n", strerror(errno));
+            ret = 0;
+        }
+    }
+    else
+    {
+        /* Without mapping, the modified ranges have to be written back */
+        if (m->mode == MAPPING_SHARED && !file_write_ranges(m->file, m->offset, m->data, m->len, dirty))
+        {
+            report_error("Failed to write to the input file: %s!\n", strerror(errno));
+            ret = 0;
+        }
+
+        free(m->data);
+    }
+
+    m->data = NULL;
+    m->base = NULL;
+
+    return ret;
+}
+
+char *file_read_at(FILE *f, long offset, size_t len)
+{
+    char *buffer;
+
+    /* Read the whole range at once (with room for a termination, for the tables of names) */
+    if ((buffer = malloc(len + 1)) == NULL)
+        return NULL;
+
+    if (fseek(f, offset, SEEK_SET) != 0 || (len > 0 && fread(buffer, len, 1, f) != 1))
+    {
+        free(buffer);
+        return NULL;
+    }
+
+    buffer[len] = 0;
+
+    return buffer;
+}
+
+#ifdef __linux__
+
+static int clone_range(int in, int out, size_t len)
+{
+    loff_t offIn = 0, offOut = 0;
+    off_t offset;
+
+#ifdef FICLONE
+    /* Share the extents of the input (copy-on-write filesystems), turning the copy into a metadata operation */
+    if (ioctl(out, FICLONE, in) == 0)
+        return 1;
+#endif
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 27)
+    /* Let the kernel copy the data (possibly with reflinks or server-side) */
+    while ((size_t)offIn < len && copy_file_range(in, &offIn, out, &offOut, len - (size_t)offIn, 0) > 0);
+    if ((size_t)offIn >= len)
+        return 1;
+#endif
+
+    /* Carry on without going through the user space */
+    offset = (off_t)offIn;
+    if (lseek(out, offset, SEEK_SET) != offset)
+        return 0;
+
+    while ((size_t)offset < len && sendfile(out, in, &offset, len - (size_t)offset) > 0);
+
+    return (size_t)offset >= len;
+}
+
+#endif
+
+int file_clone(FILE *in, FILE *out)
+{
+    char *buffer;
+    long end;
+    size_t r;
+
+    /* Get the length of the input */
+    fflush(out);
+    if (fseek(in, 0, SEEK_END) != 0 || (end = ftell(in)) < 0 || fseek(in, 0, SEEK_SET) != 0 || fseek(out, 0, SEEK_SET) != 0)
+    {
+        report_error("Failed to read from the input file: %s!\n", strerror(errno));
+        return 0;
+    }
+
+#ifdef __linux__
+    if (clone_range(fileno(in), fileno(out), (size_t)end))
+        return 1;
+
+    /* Start over if the kernel couldn't copy the whole file */
+    if (fseek(out, 0, SEEK_SET) != 0)
+    {
+        report_error("Failed to write to the output file: %s!\n", strerror(errno));
+        return 0;
+    }
+#endif
+
+    /* Fall back on copying through a large buffer */
+    if ((buffer = malloc(COPY_BUFFER_SIZE)) == NULL)
+    {
+        report_error("Failed to allocate memory for the copy: %s!\n", strerror(errno));
+        return 0;
+    }
+
+    while ((r = fread(buffer, 1, COPY_BUFFER_SIZE, in)) > 0)
+    {
+        if (fwrite(buffer, r, 1, out) != 1)
+        {
+            report_error("Failed to write to the output file: %s!\n", strerror(errno));
+            free(buffer);
+            return 0;
+        }
+    }
+
+    free(buffer);
+
+    if (ferror(in))
+    {
+        report_error("Failed to read from the input file: %s!\n", strerror(errno));
+        return 0;
+    }
+
+    return 1;
+}
+
+int file_write_ranges(FILE *f, long offset, const char *data, size_t len, const RangeList *ranges)
+{
+    size_t i;
+
+    /* Write everything if the modified ranges are unknown */
+    if (ranges == NULL || ranges->whole)
+        return len == 0 || (fseek(f, offset, SEEK_SET) == 0 && fwrite(data, len, 1, f) == 1);
+
+    for (i = 0; i < ranges->count; i++)
+    {
+        const Range *r = &ranges->ranges[i];
+
+        if (fseek(f, offset + (long)r->offset, SEEK_SET) != 0 || fwrite(&data[r->offset], r->len, 1, f) != 1)
+            return 0;
+    }
+
+    return 1;
+}
+
+void source_init(Source *s, FILE *f, int streamed)
+{
+    s->file = f;
+    s->streamed = streamed;
+    s->buffer = NULL;
+    s->base = 0;
+    s->len = 0;
+    s->capacity = 0;
+}
+
+void source_memory(Source *s, const char *data, size_t len)
+{
+    /* The whole input is the window, nothing being ever read nor copied */
+    s->file = NULL;
+    s->streamed = 1;
+    s->buffer = (char*)data;
+    s->base = 0;
+    s->len = len;
+    s->capacity = 0;
+}
+
+void source_free(Source *s)
+{
+    /* The memory of an input in memory isn't owned */
+    if (s->capacity > 0)
+        free(s->buffer);
+    s->buffer = NULL;
+    s->len = 0;
+    s->capacity = 0;
+}
+
+char *source_fill(Source *s, long offset, size_t len)
+{
+    size_t end, r;
+
+    /* What was already passed through can't be read again */
+    if (offset < s->base)
+    {
+        errno = ESPIPE;
+        return NULL;
+    }
+    end = (size_t)(offset - s->base) + len;
+
+    /* A range wrapping around can't be in the input */
+    if (end < len)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    /* Read the input sequentially until the range is buffered */
+    while (s->len < end)
+    {
+        if (s->file == NULL)
+            return NULL;
+
+        if (s->len == s->capacity)
+        {
+            size_t capacity = s->capacity > 0 ? s->capacity * 2 : COPY_BUFFER_SIZE;
+            char *grown;
+
+            if (capacity < end)
+                capacity = end;
+
+            if ((grown = realloc(s->buffer, capacity)) == NULL)
+                return NULL;
+
+            s->buffer = grown;
+            s->capacity = capacity;
+        }
+
+        if ((r = fread(&s->buffer[s->len], 1, s->capacity - s->len, s->file)) == 0)
+            return NULL;
+        s->len += r;
+    }
+
+    return &s->buffer[offset - s->base];
+}
+
+long source_size(Source *s)
+{
+    /* The size of a stream is only known once it's read through (-1 meanwhile) */
+    if (s->file == NULL)
+        return (long)s->len;
+    if (s->streamed || fseek(s->file, 0, SEEK_END) != 0)
+        return -1;
+
+    return ftell(s->file);
+}
+
+size_t source_read(Source *s, long offset, void *data, size_t len)
+{
+    const char *p = NULL;
+
+    if (!s->streamed)
+    {
+        if (fseek(s->file, offset, SEEK_SET) != 0)
+            return 0;
+        return fread(data, 1, len, s->file);
+    }
+
+    /* Near the end of the input, only what remains is read */
+    while (len > 0 && (p = source_fill(s, offset, len)) == NULL)
+    {
+        if (offset < s->base || (size_t)(offset - s->base) >= s->len)
+            return 0;
+        len = s->len - (size_t)(offset - s->base);
+    }
+
+    if (len > 0)
+        memcpy(data, p, len);
+
+    return len;
+}
+
+char *source_read_at(Source *s, long offset, size_t len, Arena *arena)
+{
+    char *buffer;
+    const char *p = NULL;
+
+    if ((s->streamed && (p = source_fill(s, offset, len)) == NULL) || (buffer = arena_alloc(arena, len + 1)) == NULL)
+        return NULL;
+
+    /* Read the range in the arena of the run, with the same termination as from the file */
+    if (p != NULL)
+        memcpy(buffer, p, len);
+    else if (fseek(s->file, offset, SEEK_SET) != 0 || (len > 0 && fread(buffer, len, 1, s->file) != 1))
+        return NULL;
+
+    buffer[len] = 0;
+
+    return buffer;
+}
+
+int source_write(Source *s, FILE *out, long end)
+{
+    const size_t len = end > s->base ? (size_t)(end - s->base) : 0;
+
+    if (len > s->len)
+        return 0;
+
+    /* Send the start of the window, then forget it */
+    if (out != NULL && len > 0 && fwrite(s->buffer, len, 1, out) != 1)
+        return 0;
+
+    memmove(s->buffer, &s->buffer[len], s->len - len);
+    s->len -= len;
+    s->base += (long)len;
+
+    return 1;
+}
+
+int source_drain(Source *s, FILE *out)
+{
+    size_t r;
+
+    /* Send the rest of the window, then pass the remainder of the input through it */
+    do
+    {
+        if (s->len > 0 && fwrite(s->buffer, s->len, 1, out) != 1)
+            return 0;
+
+        s->base += (long)s->len;
+        s->len = 0;
+
+        if (s->capacity == 0)
+        {
+            if ((s->buffer = malloc(COPY_BUFFER_SIZE)) == NULL)
+                return 0;
+            s->capacity = COPY_BUFFER_SIZE;
+        }
+
+        s->len = r = fread(s->buffer, 1, s->capacity, s->file);
+    }
+    while (r > 0);
+
+    return !ferror(s->file);
+}
+
+int file_sync(FILE *f)
+{
+    /* Flush the buffers, then wait for the data to reach the disk */
+    if (fflush(f) != 0)
+        return 0;
+
+#ifdef _WIN32
+    return _commit(_fileno(f)) == 0;
+#else
+    return fsync(fileno(f)) == 0;
+#endif
+}
+
+int file_sync_directory(const char *path)
+{
+#ifdef _WIN32
+    /* The entries of the directories are written through */
+    (void)path;
+
+    return 1;
+#else
+    const char *slash = strrchr(path, '/');
+    char *dir;
+    int fd, ret;
+
+    /* Sync the directory holding the file, so that its creation or its removal lasts */
+    if (slash == NULL)
+        dir = NULL;
+    else if ((dir = malloc((size_t)(slash - path) + 2)) == NULL)
+        return 0;
+    else
+    {
+        memcpy(dir, path, slash == path ? 1 : (size_t)(slash - path));
+        dir[slash == path ? 1 : (size_t)(slash - path)] = 0;
+    }
+
+    if ((fd = open(dir != NULL ? dir : ".", O_RDONLY)) < 0)
+    {
+        free(dir);
+        return 0;
+    }
+
+    /* Some file systems can't sync a directory, their entries being written otherwise */
+    ret = fsync(fd) == 0 || errno == EINVAL;
+
+    close(fd);
+    free(dir);
+
+    return ret;
+#endif
+}
@@ -0,0 +1,62 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Provides access to the content of the files, memory-mapped whenever possible.
+ */
+
+#ifndef FILEIO_H_INCLUDED
+#define FILEIO_H_INCLUDED
+
+#include <stdio.h>
+#include "ranges.h"
+#include "arena.h"
+
+#define MAPPING_READ    0   /* Read-only access */
+#define MAPPING_PRIVATE 1   /* Writable, the modifications stay in memory */
+#define MAPPING_SHARED  2   /* Writable, the modifications go to the file */
+
+/* A range of a file loaded in memory */
+typedef struct Mapping
+{
+    char *data;
+    size_t len;
+    void *base;
+    size_t baseLen;
+    int mapped;
+    int mode;
+    FILE *file;
+    long offset;
+} Mapping;
+
+/* An input read either with seeks, or sequentially once (e.g. a pipe) through a window kept in memory (or already in memory) */
+typedef struct Source
+{
+    FILE *file;
+    int streamed;
+    char *buffer;
+    long base;
+    size_t len;
+    size_t capacity;
+} Source;
+
+int mapping_open(Mapping *m, FILE *f, long offset, size_t len, int mode);
+int mapping_close(Mapping *m, const RangeList *dirty);
+
+char *file_read_at(FILE *f, long offset, size_t len);
+int file_clone(FILE *in, FILE *out);
+int file_write_ranges(FILE *f, long offset, const char *data, size_t len, const RangeList *ranges);
+int file_sync(FILE *f);
+int file_sync_directory(const char *path);
+
+void source_init(Source *s, FILE *f, int streamed);
+void source_memory(Source *s, const char *data, size_t len);
+void source_free(Source *s);
+long source_size(Source *s);
+size_t source_read(Source *s, long offset, void *data, size_t len);
+char *source_read_at(Source *s, long offset, size_t len, Arena *arena);
+char *source_fill(Source *s, long offset, size_t len);
+int source_write(Source *s, FILE *out, long end);
+int source_drain(Source *s, FILE *out);
+
+#endif
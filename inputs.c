@@ -0,0 +1,215 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Gather the input files, walking through the directories.
+ */
+
+#define _GNU_SOURCE
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "inputs.h"
+#include "report.h"
+
+void inputs_init(InputList *list)
+{
+    list->inputs = NULL;
+    list->count = 0;
+    list->capacity = 0;
+}
+
+void inputs_free(InputList *list)
+{
+    size_t i;
+
+    for (i = 0; i < list->count; i++)
+        free(list->inputs[i].path);
+
+    free(list->inputs);
+    inputs_init(list);
+}
+
+static char *join_path(const char *dir, const char *name)
+{
+    const size_t dirLen = strlen(dir);
+    char *path;
+
+    if ((path = malloc(dirLen + strlen(name) + 2)) == NULL)
+        return NULL;
+
+    memcpy(path, dir, dirLen);
+    path[dirLen] = '/';
+    strcpy(&path[dirLen + 1], name);
+
+    return path;
+}
+
+static int push_input(InputList *list, char *path, int walked)
+{
+    if (path == NULL)
+        return 0;
+
+    if (list->count >= list->capacity)
+    {
+        const size_t capacity = list->capacity > 0 ? list->capacity * 2 : 16;
+        Input *grown;
+
+        if ((grown = realloc(list->inputs, capacity * sizeof(Input))) == NULL)
+        {
+            free(path);
+            return 0;
+        }
+
+        list->inputs = grown;
+        list->capacity = capacity;
+    }
+
+    list->inputs[list->count].path = path;
+    list->inputs[list->count].walked = walked;
+    list->count++;
+
+    return 1;
+}
+
+static int compare_inputs(const void *a, const void *b)
+{
+    return strcmp(((const Input*)a)->path, ((const Input*)b)->path);
+}
+
+#ifdef _WIN32
+
+static int walk_directory(InputList *list, const char *dir, int recursive)
+{
+    WIN32_FIND_DATAA entry;
+    HANDLE find;
+    char *path;
+    int ret = 1;
+
+    if ((path = join_path(dir, "*")) == NULL)
+        return 0;
+
+    find = FindFirstFileA(path, &entry);
+    free(path);
+
+    if (find == INVALID_HANDLE_VALUE)
+        return 0;
+
+    do
+    {
+        /* The links are skipped, the files they target may be patched twice otherwise */
+        if (strcmp(entry.cFileName, ".") == 0 || strcmp(entry.cFileName, "..") == 0 || (entry.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT))
+            continue;
+
+        if (!(entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+            ret = push_input(list, join_path(dir, entry.cFileName), 1);
+        else if (recursive)
+        {
+            if ((path = join_path(dir, entry.cFileName)) == NULL)
+                ret = 0;
+            else
+            {
+                ret = walk_directory(list, path, recursive);
+                free(path);
+            }
+        }
+    }
+    while (ret && FindNextFileA(find, &entry));
+
+    FindClose(find);
+
+    return ret;
+}
+
+#else
+
+static int walk_directory(InputList *list, const char *dir, int recursive)
+{
+    struct dirent *entry;
+    struct stat st;
+    char *path;
+    DIR *d;
+    int ret = 1;
+
+    if ((d = opendir(dir)) == NULL)
+        return 0;
+
+    while (ret && (entry = readdir(d)) != NULL)
+    {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+
+        if ((path = join_path(dir, entry->d_name)) == NULL)
+        {
+            ret = 0;
+            break;
+        }
+
+        /* The links are skipped, the files they target may be patched twice otherwise */
+        if (lstat(path, &st) != 0)
+            st.st_mode = 0;
+
+        if (S_ISREG(st.st_mode))
+            ret = push_input(list, path, 1);
+        else
+        {
+            if (recursive && S_ISDIR(st.st_mode))
+                ret = walk_directory(list, path, recursive);
+            free(path);
+        }
+    }
+
+    closedir(d);
+
+    return ret;
+}
+
+#endif
+
+int inputs_add(InputList *list, const char *path, int recursive)
+{
+    struct stat st;
+    size_t first = list->count;
+
+    /* The standard input isn't a file, it's taken as is */
+    if (strcmp(path, "-") != 0 && stat(path, &st) != 0)
+    {
+        report_error("Failed to open the input file %s: %s!\n", path, strerror(errno));
+        return 0;
+    }
+
+    if (strcmp(path, "-") == 0 || !S_ISDIR(st.st_mode))
+    {
+        char *copy = malloc(strlen(path) + 1);
+
+        if (copy != NULL)
+            strcpy(copy, path);
+
+        if (!push_input(list, copy, 0))
+        {
+            report_error("Failed to allocate memory for the inputs: %s!\n", strerror(errno));
+            return 0;
+        }
+        return 1;
+    }
+
+    if (!walk_directory(list, path, recursive))
+    {
+        report_error("Failed to walk through the directory %s: %s!\n", path, strerror(errno));
+        return 0;
+    }
+
+    /* The entries of the directories come in no particular order */
+    qsort(&list->inputs[first], list->count - first, sizeof(Input), compare_inputs);
+
+    return 1;
+}
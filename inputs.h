@@ -0,0 +1,31 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Gather the input files, walking through the directories.
+ */
+
+#ifndef INPUTS_H_INCLUDED
+#define INPUTS_H_INCLUDED
+
+#include <stddef.h>
+
+typedef struct Input
+{
+    char *path;
+    int walked;
+} Input;
+
+typedef struct InputList
+{
+    Input *inputs;
+    size_t count;
+    size_t capacity;
+} InputList;
+
+void inputs_init(InputList *list);
+void inputs_free(InputList *list);
+
+int inputs_add(InputList *list, const char *path, int recursive);
+
+#endif
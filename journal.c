@@ -0,0 +1,283 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Undo journal of the bytes overwritten in place, so that an interrupted patch can be reverted.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include "journal.h"
+#include "fileio.h"
+#include "report.h"
+
+#define JOURNAL_MAGIC "SPJRNL01"
+#define JOURNAL_SUFFIX ".journal"
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME  0x100000001b3ULL
+
+/* The former bytes of a range, as read back from the journal */
+typedef struct Record
+{
+    long offset;
+    size_t len;
+    char *data;
+} Record;
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t len)
+{
+    const unsigned char *p = data;
+    size_t i;
+
+    /* FNV-1a */
+    for (i = 0; i < len; i++)
+        hash = (hash ^ p[i]) * FNV_PRIME;
+
+    return hash;
+}
+
+int journal_init(Journal *j, const char *target)
+{
+    const size_t len = strlen(target);
+
+    j->file = NULL;
+    j->records = 0;
+
+    if ((j->path = malloc(len + sizeof(JOURNAL_SUFFIX))) == NULL)
+        return 0;
+
+    memcpy(j->path, target, len);
+    memcpy(&j->path[len], JOURNAL_SUFFIX, sizeof(JOURNAL_SUFFIX));
+
+    return 1;
+}
+
+int journal_exists(const Journal *j)
+{
+    FILE *f;
+
+    if ((f = fopen(j->path, "rb")) == NULL)
+        return 0;
+
+    fclose(f);
+
+    return 1;
+}
+
+static int journal_create(Journal *j)
+{
+    /* The journal must be on the disk, entry of its directory included, before the file is modified */
+    if ((j->file = fopen(j->path, "wb")) == NULL)
+        return 0;
+
+    return fwrite(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC) - 1, 1, j->file) == 1 && file_sync(j->file) && file_sync_directory(j->path);
+}
+
+int journal_save(Journal *j, FILE *f, long offset, size_t len)
+{
+    uint64_t header[2], hash;
+    char *data;
+    int ret;
+
+    if (len == 0)
+        return 1;
+
+    if (j->file == NULL && !journal_create(j))
+        return 0;
+
+    /* Keep the bytes about to be overwritten, a record being checked by its hash when read back */
+    if ((data = file_read_at(f, offset, len)) == NULL)
+        return 0;
+
+    header[0] = (uint64_t)offset;
+    header[1] = (uint64_t)len;
+    hash = hash_bytes(hash_bytes(FNV_OFFSET, header, sizeof(header)), data, len);
+
+    ret = fwrite(header, sizeof(header), 1, j->file) == 1 && fwrite(data, len, 1, j->file) == 1 && fwrite(&hash, sizeof(hash), 1, j->file) == 1;
+    free(data);
+
+    if (ret)
+        j->records++;
+
+    return ret;
+}
+
+int journal_save_ranges(Journal *j, FILE *f, long offset, size_t len, const RangeList *ranges)
+{
+    size_t i;
+
+    /* Save everything if the modified ranges are unknown */
+    if (ranges->whole)
+        return journal_save(j, f, offset, len);
+
+    for (i = 0; i < ranges->count; i++)
+    {
+        if (!journal_save(j, f, offset + (long)ranges->ranges[i].offset, ranges->ranges[i].len))
+            return 0;
+    }
+
+    return 1;
+}
+
+int journal_sync(Journal *j)
+{
+    return j->file == NULL || file_sync(j->file);
+}
+
+int journal_close(Journal *j, FILE *target, int complete)
+{
+    int ret = 1;
+
+    if (j->file != NULL)
+    {
+        /* The changes must be on the disk before their journal is removed, otherwise it's kept to revert them */
+        if (complete && !file_sync(target))
+            ret = complete = 0;
+
+        if (fclose(j->file) != 0)
+            ret = complete = 0;
+
+        if (complete && (remove(j->path) != 0 || !file_sync_directory(j->path)))
+            ret = 0;
+    }
+
+    free(j->path);
+    j->path = NULL;
+    j->file = NULL;
+
+    return ret;
+}
+
+static void free_records(Record *records, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++)
+        free(records[i].data);
+
+    free(records);
+}
+
+int journal_undo(const char *target, unsigned long *count)
+{
+    char magic[sizeof(JOURNAL_MAGIC) - 1];
+    uint64_t header[2], hash;
+    Record *records = NULL, *grown;
+    size_t n = 0, capacity = 0, i;
+    Journal j;
+    FILE *f = NULL;
+    char *data;
+    long size, at;
+    int ret = 0;
+
+    *count = 0;
+
+    if (!journal_init(&j, target))
+    {
+        report_error("Failed to allocate memory for the journal: %s!\n", strerror(errno));
+        return 7;
+    }
+
+    if ((j.file = fopen(j.path, "rb")) == NULL)
+    {
+        report_error("Failed to open the journal %s: %s!\n", j.path, strerror(errno));
+        ret = 3; goto RET;
+    }
+
+    /* The size of the journal bounds its records */
+    if (fseek(j.file, 0, SEEK_END) != 0 || (size = ftell(j.file)) < 0 || fseek(j.file, 0, SEEK_SET) != 0)
+    {
+        report_error("Failed to read the journal %s: %s!\n", j.path, strerror(errno));
+        ret = 3; goto RET;
+    }
+
+    if (fread(magic, sizeof(magic), 1, j.file) != 1 || memcmp(magic, JOURNAL_MAGIC, sizeof(magic)) != 0)
+    {
+        report_error("Failed to read the journal %s: it isn't a journal!\n", j.path);
+        ret = 3; goto RET;
+    }
+
+    /* Read the records up to the first incomplete one, which was cut before the file was modified (its length possibly too) */
+    while (fread(header, sizeof(header), 1, j.file) == 1 && (at = ftell(j.file)) >= 0 &&
+           (uint64_t)(size - at) >= sizeof(hash) && header[1] <= (uint64_t)(size - at) - sizeof(hash))
+    {
+        if ((data = malloc((size_t)header[1])) == NULL)
+        {
+            report_error("Failed to allocate memory for the journal: %s!\n", strerror(errno));
+            ret = 7; goto RET;
+        }
+
+        if (fread(data, (size_t)header[1], 1, j.file) != 1 || fread(&hash, sizeof(hash), 1, j.file) != 1 ||
+            hash != hash_bytes(hash_bytes(FNV_OFFSET, header, sizeof(header)), data, (size_t)header[1]))
+        {
+            free(data);
+            break;
+        }
+
+        if (n >= capacity)
+        {
+            capacity = capacity == 0 ? 64 : capacity * 2;
+            if ((grown = realloc(records, capacity * sizeof(Record))) == NULL)
+            {
+                report_error("Failed to allocate memory for the journal: %s!\n", strerror(errno));
+                free(data);
+                ret = 7; goto RET;
+            }
+            records = grown;
+        }
+
+        records[n].offset = (long)header[0];
+        records[n].len = (size_t)header[1];
+        records[n].data = data;
+        n++;
+    }
+
+    if ((f = fopen(target, "rb+")) == NULL)
+    {
+        report_error("Failed to open the input file %s: %s!\n", target, strerror(errno));
+        ret = 3; goto RET;
+    }
+
+    /* Restore the former bytes in the reverse order, the first saved being the oldest */
+    for (i = n; i > 0; i--)
+    {
+        if (fseek(f, records[i - 1].offset, SEEK_SET) != 0 || fwrite(records[i - 1].data, records[i - 1].len, 1, f) != 1)
+        {
+            report_error("Failed to write to the input file: %s!\n", strerror(errno));
+            ret = 15; goto RET;
+        }
+    }
+
+    /* The journal is only removed once the file is restored on the disk */
+    if (!file_sync(f))
+    {
+        report_error("Failed to write to the input file: %s!\n", strerror(errno));
+        ret = 15; goto RET;
+    }
+
+    fclose(j.file);
+    j.file = NULL;
+    if (remove(j.path) != 0 || !file_sync_directory(j.path))
+    {
+        report_error("Failed to remove the journal %s: %s!\n", j.path, strerror(errno));
+        ret = 15; goto RET;
+    }
+
+    *count = (unsigned long)n;
+
+  RET:
+
+    if (f != NULL)
+        fclose(f);
+
+    if (j.file != NULL)
+        fclose(j.file);
+
+    free_records(records, n);
+    free(j.path);
+
+    return ret;
+}
@@ -0,0 +1,32 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Undo journal of the bytes overwritten in place, so that an interrupted patch can be reverted.
+ */
+
+#ifndef JOURNAL_H_INCLUDED
+#define JOURNAL_H_INCLUDED
+
+#include <stdio.h>
+#include "ranges.h"
+
+/* The journal lies next to the patched file, and is only created along with its first record */
+typedef struct Journal
+{
+    char *path;
+    FILE *file;
+    unsigned long records;
+} Journal;
+
+int journal_init(Journal *j, const char *target);
+int journal_exists(const Journal *j);
+
+int journal_save(Journal *j, FILE *f, long offset, size_t len);
+int journal_save_ranges(Journal *j, FILE *f, long offset, size_t len, const RangeList *ranges);
+int journal_sync(Journal *j);
+int journal_close(Journal *j, FILE *target, int complete);
+
+int journal_undo(const char *target, unsigned long *count);
+
+#endif
@@ -0,0 +1,475 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Buffered writer of the listed strings (as text, NUL-delimited or JSON Lines).
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "listing.h"
+
+#define LISTING_BUFFER_SIZE (1024 * 1024)
+
+/* Room needed in the buffer for anything but the string itself */
+#define RECORD_OVERHEAD 64
+
+static const char hexDigits[] = "0123456789ABCDEF";
+
+void listing_init(Listing *l, FILE *file, int format)
+{
+    l->file = file;
+    l->format = format;
+    l->section = "";
+    l->buffer = NULL;
+    l->len = 0;
+    l->capacity = 0;
+    l->failed = 0;
+    l->utf16 = 0;
+    l->narrowed[0] = l->narrowed[1] = NULL;
+    l->narrowedCapacity[0] = l->narrowedCapacity[1] = 0;
+}
+
+int listing_free(Listing *l)
+{
+    const int ret = listing_flush(l);
+
+    free(l->buffer);
+    free(l->narrowed[0]);
+    free(l->narrowed[1]);
+    l->buffer = NULL;
+    l->capacity = 0;
+    l->narrowed[0] = l->narrowed[1] = NULL;
+    l->narrowedCapacity[0] = l->narrowedCapacity[1] = 0;
+
+    return ret;
+}
+
+int listing_flush(Listing *l)
+{
+    if (l->len > 0 && fwrite(l->buffer, l->len, 1, l->file) != 1)
+        l->failed = 1;
+
+    l->len = 0;
+
+    return !l->failed && fflush(l->file) == 0;
+}
+
+static int reserve(Listing *l, size_t len)
+{
+    if (l->len + len <= l->capacity)
+        return 1;
+
+    /* Flush in large chunks, growing the buffer only for a record longer than it */
+    listing_flush(l);
+    if (len > l->capacity)
+    {
+        const size_t capacity = len > LISTING_BUFFER_SIZE ? len : LISTING_BUFFER_SIZE;
+        char *grown;
+
+        if ((grown = realloc(l->buffer, capacity)) == NULL)
+            return 0;
+
+        l->buffer = grown;
+        l->capacity = capacity;
+    }
+
+    return 1;
+}
+
+static size_t format_hex(char *out, size_t value)
+{
+    char digits[sizeof(size_t) * 2];
+    size_t n = 0, i;
+
+    /* At least 8 digits, as "%08X" would */
+    do
+    {
+        digits[n++] = hexDigits[value & 0xf];
+        value >>= 4;
+    }
+    while (value != 0 || n < 8);
+
+    for (i = 0; i < n; i++)
+        out[i] = digits[n - 1 - i];
+
+    return n;
+}
+
+static size_t format_decimal(char *out, size_t value)
+{
+    char digits[sizeof(size_t) * 3];
+    size_t n = 0, i;
+
+    do
+    {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    }
+    while (value != 0);
+
+    for (i = 0; i < n; i++)
+        out[i] = digits[n - 1 - i];
+
+    return n;
+}
+
+static size_t utf8_sequence(const unsigned char *str, size_t len)
+{
+    size_t n, i;
+
+    /* Length of the valid UTF-8 sequence starting the string, 0 if it's not one */
+    if (str[0] >= 0xc2 && str[0] <= 0xdf)
+        n = 2;
+    else if (str[0] >= 0xe0 && str[0] <= 0xef)
+        n = 3;
+    else if (str[0] >= 0xf0 && str[0] <= 0xf4)
+        n = 4;
+    else
+        return 0;
+
+    if (n > len)
+        return 0;
+
+    for (i = 1; i < n; i++)
+    {
+        if ((str[i] & 0xc0) != 0x80)
+            return 0;
+    }
+
+    /* Reject the overlong forms, the surrogates and what's beyond U+10FFFF */
+    if ((str[0] == 0xe0 && str[1] < 0xa0) || (str[0] == 0xed && str[1] >= 0xa0) ||
+        (str[0] == 0xf0 && str[1] < 0x90) || (str[0] == 0xf4 && str[1] >= 0x90))
+        return 0;
+
+    return n;
+}
+
+/* Convert a UTF-16LE string to UTF-8 into a buffer of the listing, the lone surrogates becoming U+FFFD */
+static const char *narrow(Listing *l, int slot, const char *str, size_t *len)
+{
+    const unsigned char *s = (const unsigned char*)str;
+    unsigned long c, low;
+    size_t i, j = 0;
+    char *out;
+
+    /* A character takes at most 3 bytes, a pair of surrogates 4 */
+    if (*len / 2 * 3 + 1 > l->narrowedCapacity[slot])
+    {
+        if ((out = realloc(l->narrowed[slot], *len / 2 * 3 + 1)) == NULL)
+            return NULL;
+
+        l->narrowed[slot] = out;
+        l->narrowedCapacity[slot] = *len / 2 * 3 + 1;
+    }
+    out = l->narrowed[slot];
+
+    for (i = 0; i + 1 < *len; i += 2)
+    {
+        c = s[i] | ((unsigned long)s[i + 1] << 8);
+
+        if (c >= 0xd800 && c <= 0xdbff && i + 3 < *len &&
+            (low = s[i + 2] | ((unsigned long)s[i + 3] << 8)) >= 0xdc00 && low <= 0xdfff)
+        {
+            c = 0x10000 + ((c - 0xd800) << 10) + (low - 0xdc00);
+            i += 2;
+        }
+        else if (c >= 0xd800 && c <= 0xdfff)
+            c = 0xfffd;
+
+        if (c < 0x80)
+            out[j++] = (char)c;
+        else if (c < 0x800)
+        {
+            out[j++] = (char)(0xc0 | (c >> 6));
+            out[j++] = (char)(0x80 | (c & 0x3f));
+        }
+        else if (c < 0x10000)
+        {
+            out[j++] = (char)(0xe0 | (c >> 12));
+            out[j++] = (char)(0x80 | ((c >> 6) & 0x3f));
+            out[j++] = (char)(0x80 | (c & 0x3f));
+        }
+        else
+        {
+            out[j++] = (char)(0xf0 | (c >> 18));
+            out[j++] = (char)(0x80 | ((c >> 12) & 0x3f));
+            out[j++] = (char)(0x80 | ((c >> 6) & 0x3f));
+            out[j++] = (char)(0x80 | (c & 0x3f));
+        }
+    }
+
+    *len = j;
+
+    return out;
+}
+
+static size_t format_json(char *out, const char *str, size_t len)
+{
+    const unsigned char *s = (const unsigned char*)str;
+    size_t i = 0, j = 0, n;
+
+    out[j++] = '"';
+    while (i < len)
+    {
+        const unsigned char c = s[i];
+
+        if (c == '"' || c == '\\')
+        {
+            out[j++] = '\\';
+            out[j++] = (char)c;
+        }
+        else if (c == '\n' || c == '\r' || c == '\t')
+        {
+            out[j++] = '\\';
+            out[j++] = c == '\n' ? 'n' : (c == '\r' ? 'r' : 't');
+        }
+        else if (c >= 0x20 && c < 0x7f)
+            out[j++] = (char)c;
+        else if (c >= 0x80 && (n = utf8_sequence(&s[i], len - i)) > 0)
+        {
+            memcpy(&out[j], &s[i], n);
+            j += n;
+            i += n;
+            continue;
+        }
+        else
+        {
+            /* The control characters and the bytes which aren't UTF-8 are escaped as code points */
+            memcpy(&out[j], "\\u00", 4);
+            out[j + 4] = hexDigits[c >> 4];
+            out[j + 5] = hexDigits[c & 0xf];
+            j += 6;
+        }
+
+        i++;
+    }
+    out[j++] = '"';
+
+    return j;
+}
+
+void listing_string(Listing *l, const char *str, size_t offset, size_t len)
+{
+    char *out;
+
+    if (l->utf16 && (str = narrow(l, 0, str, &len)) == NULL)
+    {
+        l->failed = 1;
+        return;
+    }
+
+    if (l->format != LISTING_JSON)
+    {
+        if (!reserve(l, len + RECORD_OVERHEAD))
+        {
+            l->failed = 1;
+            return;
+        }
+
+        /* Print the string as is (may contains unprintable characters) */
+        out = &l->buffer[l->len];
+        l->len += format_hex(out, offset);
+        l->buffer[l->len++] = ':';
+        memcpy(&l->buffer[l->len], str, len);
+        l->len += len;
+        l->buffer[l->len++] = l->format == LISTING_TEXT ? '\n' : 0;
+        return;
+    }
+
+    /* Every byte may be escaped into 6 characters */
+    if (!reserve(l, (len + strlen(l->section)) * 6 + RECORD_OVERHEAD))
+    {
+        l->failed = 1;
+        return;
+    }
+
+    out = l->buffer;
+    memcpy(&out[l->len], "{\"section\":", 11);
+    l->len += 11;
+    l->len += format_json(&out[l->len], l->section, strlen(l->section));
+    memcpy(&out[l->len], ",\"offset\":", 10);
+    l->len += 10;
+    l->len += format_decimal(&out[l->len], offset);
+    memcpy(&out[l->len], ",\"string\":", 10);
+    l->len += 10;
+    l->len += format_json(&out[l->len], str, len);
+    out[l->len++] = '}';
+    out[l->len++] = '\n';
+}
+
+void listing_change(Listing *l, size_t offset, const char *old, size_t oldLen, const char *replacement, size_t newLen, size_t available)
+{
+    const size_t unit = l->utf16 ? 2 : 1;
+    const size_t length = newLen / unit, room = available / unit;
+    size_t replacementLen = newLen;
+    char *out;
+
+    /* The UTF-16 strings are listed in UTF-8, their room being counted in characters */
+    if (l->utf16 && ((old = narrow(l, 0, old, &oldLen)) == NULL ||
+        (replacement != NULL && (replacement = narrow(l, 1, replacement, &replacementLen)) == NULL)))
+    {
+        l->failed = 1;
+        return;
+    }
+
+    /* Every byte may be escaped into 6 characters */
+    if (!reserve(l, (oldLen + replacementLen + strlen(l->section)) * 6 + RECORD_OVERHEAD * 2))
+    {
+        l->failed = 1;
+        return;
+    }
+
+    out = l->buffer;
+    if (l->format != LISTING_JSON)
+    {
+        /* <offset>:"<old>" -> "<new>" (<n> left), or the room missing */
+        l->len += format_hex(&out[l->len], offset);
+        out[l->len++] = ':';
+        l->len += format_json(&out[l->len], old, oldLen);
+
+        if (replacement != NULL)
+        {
+            memcpy(&out[l->len], " -> ", 4);
+            l->len += 4;
+            l->len += format_json(&out[l->len], replacement, replacementLen);
+            memcpy(&out[l->len], " (", 2);
+            l->len += 2;
+            l->len += format_decimal(&out[l->len], room - length);
+            memcpy(&out[l->len], " left)", 6);
+            l->len += 6;
+        }
+        else
+        {
+            memcpy(&out[l->len], " doesn't fit (", 14);
+            l->len += 14;
+            l->len += format_decimal(&out[l->len], length - room);
+            memcpy(&out[l->len], " missing)", 9);
+            l->len += 9;
+        }
+
+        out[l->len++] = l->format == LISTING_TEXT ? '\n' : 0;
+        return;
+    }
+
+    memcpy(&out[l->len], "{\"section\":", 11);
+    l->len += 11;
+    l->len += format_json(&out[l->len], l->section, strlen(l->section));
+    memcpy(&out[l->len], ",\"offset\":", 10);
+    l->len += 10;
+    l->len += format_decimal(&out[l->len], offset);
+    memcpy(&out[l->len], ",\"old\":", 7);
+    l->len += 7;
+    l->len += format_json(&out[l->len], old, oldLen);
+
+    /* The replacement is only known if it fits */
+    memcpy(&out[l->len], ",\"new\":", 7);
+    l->len += 7;
+    if (replacement != NULL)
+        l->len += format_json(&out[l->len], replacement, replacementLen);
+    else
+    {
+        memcpy(&out[l->len], "null", 4);
+        l->len += 4;
+    }
+
+    memcpy(&out[l->len], ",\"length\":", 10);
+    l->len += 10;
+    l->len += format_decimal(&out[l->len], length);
+    memcpy(&out[l->len], ",\"available\":", 13);
+    l->len += 13;
+    l->len += format_decimal(&out[l->len], room);
+    out[l->len++] = '}';
+    out[l->len++] = '\n';
+}
+
+static void write_moved(Listing *l, size_t offset, const char *old, size_t oldLen, const char *replacement, size_t newLen, size_t to, size_t references, int conflict)
+{
+    char *out;
+
+    /* Every byte may be escaped into 6 characters */
+    if (!reserve(l, (oldLen + newLen + strlen(l->section)) * 6 + RECORD_OVERHEAD * 2))
+    {
+        l->failed = 1;
+        return;
+    }
+
+    out = l->buffer;
+    if (l->format != LISTING_JSON)
+    {
+        /* <offset>:"<old>" -> "<new>" (moved to <offset>, <n> references), or the string conflicting */
+        l->len += format_hex(&out[l->len], offset);
+        out[l->len++] = ':';
+        l->len += format_json(&out[l->len], old, oldLen);
+        memcpy(&out[l->len], " -> ", 4);
+        l->len += 4;
+        l->len += format_json(&out[l->len], replacement, newLen);
+
+        if (conflict)
+        {
+            memcpy(&out[l->len], " (conflicts with the string at ", 31);
+            l->len += 31;
+            l->len += format_hex(&out[l->len], to);
+            out[l->len++] = ')';
+        }
+        else
+        {
+            memcpy(&out[l->len], " (moved to ", 11);
+            l->len += 11;
+            l->len += format_hex(&out[l->len], to);
+            memcpy(&out[l->len], ", ", 2);
+            l->len += 2;
+            l->len += format_decimal(&out[l->len], references);
+            memcpy(&out[l->len], " references)", 12);
+            l->len += 12;
+        }
+
+        out[l->len++] = l->format == LISTING_TEXT ? '\n' : 0;
+        return;
+    }
+
+    memcpy(&out[l->len], "{\"section\":", 11);
+    l->len += 11;
+    l->len += format_json(&out[l->len], l->section, strlen(l->section));
+    memcpy(&out[l->len], ",\"offset\":", 10);
+    l->len += 10;
+    l->len += format_decimal(&out[l->len], offset);
+    memcpy(&out[l->len], ",\"old\":", 7);
+    l->len += 7;
+    l->len += format_json(&out[l->len], old, oldLen);
+    memcpy(&out[l->len], ",\"new\":", 7);
+    l->len += 7;
+    l->len += format_json(&out[l->len], replacement, newLen);
+    memcpy(&out[l->len], ",\"length\":", 10);
+    l->len += 10;
+    l->len += format_decimal(&out[l->len], newLen);
+
+    if (conflict)
+    {
+        memcpy(&out[l->len], ",\"conflict\":", 12);
+        l->len += 12;
+        l->len += format_decimal(&out[l->len], to);
+    }
+    else
+    {
+        memcpy(&out[l->len], ",\"moved\":", 9);
+        l->len += 9;
+        l->len += format_decimal(&out[l->len], to);
+        memcpy(&out[l->len], ",\"references\":", 14);
+        l->len += 14;
+        l->len += format_decimal(&out[l->len], references);
+    }
+
+    out[l->len++] = '}';
+    out[l->len++] = '\n';
+}
+
+void listing_move(Listing *l, size_t offset, const char *old, size_t oldLen, const char *replacement, size_t newLen, size_t moved, size_t references)
+{
+    write_moved(l, offset, old, oldLen, replacement, newLen, moved, references, 0);
+}
+
+void listing_conflict(Listing *l, size_t offset, const char *old, size_t oldLen, const char *replacement, size_t newLen, size_t with)
+{
+    write_moved(l, offset, old, oldLen, replacement, newLen, with, 0, 1);
+}
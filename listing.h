@@ -0,0 +1,40 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Buffered writer of the listed strings (as text, NUL-delimited or JSON Lines).
+ */
+
+#ifndef LISTING_H_INCLUDED
+#define LISTING_H_INCLUDED
+
+#include <stdio.h>
+
+#define LISTING_TEXT 0  /* <offset>:<string>\n */
+#define LISTING_NULL 1  /* <offset>:<string>\0 */
+#define LISTING_JSON 2  /* {"section":...,"offset":...,"string":...}\n */
+
+typedef struct Listing
+{
+    FILE *file;
+    int format;
+    const char *section;
+    char *buffer;
+    size_t len;
+    size_t capacity;
+    int failed;
+    int utf16;                  /* The strings are UTF-16LE, listed in UTF-8 */
+    char *narrowed[2];
+    size_t narrowedCapacity[2];
+} Listing;
+
+void listing_init(Listing *l, FILE *file, int format);
+int listing_free(Listing *l);
+
+void listing_string(Listing *l, const char *str, size_t offset, size_t len);
+void listing_change(Listing *l, size_t offset, const char *old, size_t oldLen, const char *replacement, size_t newLen, size_t available);
+void listing_move(Listing *l, size_t offset, const char *old, size_t oldLen, const char *replacement, size_t newLen, size_t moved, size_t references);
+void listing_conflict(Listing *l, size_t offset, const char *old, size_t oldLen, const char *replacement, size_t newLen, size_t with);
+int listing_flush(Listing *l);
+
+#endif
@@ -5,38 +5,680 @@
  * Alter strings in a compiled executable binary (Linux ELF and Windows PE).
  */
 
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include "pefile.h"
 #include "elffile.h"
+#include "rules.h"
+#include "threads.h"
+#include "inputs.h"
+#include "common.h"
+#include "arena.h"
+#include "stats.h"
+#include "delta.h"
+#include "server.h"
+#include "scan.h"
 
 #define MAGIC_ELF "\x7f\x45\x4c\x46"
 #define MAGIC_PE "MZ"
 
+/* Stands for the standard input or output */
+#define STDIO_PATH "-"
+
+/* Returned for the files found in the directories which aren't executables */
+#define SKIPPED (-1)
+
+/* A file processed by the pool, with its outcome */
+typedef struct Job
+{
+    const Input *input;
+    const RuleSet *rules;
+    const Options *opts;
+    Arena *arenas;
+    Stats *stats;
+    unsigned long count;
+    int ret;
+} Job;
+
+static int add_sections(const char ***sections, size_t *count, char *list)
+{
+    char *name;
+
+    /* Split the list of names in place */
+    for (name = strtok(list, ","); name != NULL; name = strtok(NULL, ","))
+    {
+        const char **grown;
+
+        if ((grown = realloc((void*)*sections, (*count + 1) * sizeof(const char*))) == NULL)
+        {
+            fprintf(stderr, "Failed to allocate memory for the sections: %s!\n", strerror(errno));
+            return 0;
+        }
+
+        *sections = grown;
+        (*sections)[(*count)++] = name;
+    }
+
+    return 1;
+}
+
+static int parse_address(const char *str, uint64_t *address)
+{
+    size_t i = str[0] == '0' && (str[1] == 'x' || str[1] == 'X') ? 2 : 0;
+    int digit;
+
+    /* In hexadecimal, as the listings */
+    *address = 0;
+    if (str[i] == 0)
+        return 0;
+
+    for (; str[i] != 0; i++)
+    {
+        if (str[i] >= '0' && str[i] <= '9')
+            digit = str[i] - '0';
+        else if (str[i] >= 'a' && str[i] <= 'f')
+            digit = str[i] - 'a' + 10;
+        else if (str[i] >= 'A' && str[i] <= 'F')
+            digit = str[i] - 'A' + 10;
+        else
+            return 0;
+
+        if (*address >> 60 != 0)
+            return 0;
+        *address = *address << 4 | (uint64_t)digit;
+    }
+
+    return 1;
+}
+
 static void usage(char *progname)
 {
-    printf("Usage: %s [<options>] <file> <string> <replace>\n\n\
+    printf("Usage: %s [<options>] <file> <string> <replace>\n\
+       %s [<options>] --rules <rules> <file>...\n\
+       %s [<options>] --serve <socket> <rules>...\n\n\
 Options:\n\
   -e,--exact   : Proceed the replacement with an exact match (default is more lenient)\n\
-  -s,--section : Override the section name in which to search for strings (default: .rodata)\n\
-  -o,--output  : Output file\n\
+  --regex      : Take the strings to search for as regular expressions, their groups being inserted by \\1 to \\9 in the replacement\n\
+  --wildcard   : Take the strings to search for as wildcards (* and ?), each of them being a group of the replacement\n\
+  --utf16      : Search for the strings encoded in UTF-16LE (terminated by two null bytes) and list them in UTF-8, the rules being converted\n\
+  -s,--section : Override the section names in which to search for strings, separated by commas (default: .rodata)\n\
+  -a,--all-string-sections : Search in all the sections flagged as containing strings\n\
+  --at-vaddr   : Only process the string at a virtual address (in hexadecimal), found without searching its section\n\
+  -r,--rules   : Read the search and replace pairs from a file (- for stdin), one \"<string>\\t<replace>\" per line\n\
+  -n,--dry-run : Print the changes (offset, string, replacement and room left) without writing anything\n\
+  --relocate   : Move the replacements which don't fit into the padding of other strings, redirecting their references (x86-64 only, the data within the code may be taken for a reference, see the README)\n\
+  --merged     : Leave the strings sharing their tail with another one consistent, replacing the tails on their own (x86-64 only)\n\
+  -0,--null    : List the strings terminated by a null character instead of a new line\n\
+  --json       : List the strings as JSON Lines (with their section and offset)\n\
+  -R,--recursive : Walk through the subdirectories of the directories supplied as input\n\
+  -j,--jobs    : Number of files processed at the same time (default: one per processor)\n\
+  -t,--threads : Number of threads scanning the large sections (default: one per processor)\n\
+  --cache      : Directory keeping an index of the sections and strings of the files, reused while they're unchanged\n\
+  -f,--first   : Only tell whether the strings are found in the files, stopping at the first match (nothing is written)\n\
+  -c,--count   : Only count the matches of the strings in the files (nothing is written)\n\
+  --stats      : Report the time spent in each phase, the bytes and strings gone through and the peak memory on stderr (as JSON with --json)\n\
+  --journal    : Save the strings overwritten in place into <file>.journal first, removed once the changes are on the disk\n\
+  --undo       : Revert the interrupted patches of the files from their journal\n\
+  --emit-patch : Write the changes made to the file into a patch file, with the bytes they replace\n\
+  --apply-patch  : Apply a patch file to the files supplied instead of searching for the strings (--apply-patch <patch> <file>...)\n\
+  --revert-patch : Revert a patch file from the files supplied (--revert-patch <patch> <file>...)\n\
+  --serve      : Patch the files requested over a Unix socket (\"<rules>\\t<file>[\\t<output>]\" per line, answered by \"<code>\\t<file>\"), until stopped\n\
+  -o,--output  : Output file (- for stdout)\n\
   -h,--help    : Show help usage\n\n\
-If no input or replacement is supplied, it will just print all the strings in the executable.\nIf the string is NOT found, returns 1. If the replacement couldn't fit, returns 2. Returns 0 otherwise.\n", progname);
+If no input or replacement is supplied, it will just print all the strings in the executable.\n\
+With - as the file, the executable is streamed from stdin to stdout (or to the output), patched on the fly.\n\
+With --rules, every file supplied is patched, the directories being walked through (their files which aren't executables are skipped).\n\
+With --first or --count, the replacements of the rules are ignored (and the replacement may be left out along with a single file).\n\
+If the string is NOT found, returns 1. If the replacement couldn't fit, returns 2. Returns 0 otherwise.\n", progname, progname, progname);
+}
+
+static int stream_file(const char *filename, const char *output, const RuleSet *rules, const Options *opts, Arena *arena, Stats *stats)
+{
+    int ret;
+    char magic[4];
+    Source source;
+    FILE *fileIn = stdin;
+    FILE *fileOut = NULL;
+
+#ifdef _WIN32
+    /* The standard streams mustn't translate the line endings */
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    if (strcmp(filename, STDIO_PATH) != 0 && (fileIn = fopen(filename, "rb")) == NULL)
+    {
+        fprintf(stderr, "Failed to open the input file %s: %s!\n", filename, strerror(errno));
+        return 3;
+    }
+
+    /* The input can't be patched in place, it goes to the standard output unless told otherwise */
+    if (rules != NULL && !opts->dryRun)
+    {
+        if (output == NULL || strcmp(output, STDIO_PATH) == 0)
+            fileOut = stdout;
+        else if ((fileOut = fopen(output, "wb")) == NULL)
+        {
+            fprintf(stderr, "Failed to open the output file: %s!\n", strerror(errno));
+            ret = 3; goto RET;
+        }
+    }
+
+    /* Determine the type of executable using the magic number, the stream being read only once */
+    source_init(&source, fileIn, 1);
+    memset(magic, 0, sizeof(magic));
+    source_read(&source, 0, magic, 4);
+
+    if (strncmp(magic, MAGIC_ELF, sizeof(MAGIC_ELF)-1) == 0)
+        ret = elf_stream(&source, fileOut, rules, opts, arena, stats);
+    else if (strncmp(magic, MAGIC_PE, sizeof(MAGIC_PE)-1) == 0)
+        ret = pe_stream(&source, fileOut, rules, opts, arena, stats);
+    else
+    {
+        fprintf(stderr, "Executable format unrecognized: %2X%2X%2X%2X!\n", magic[0], magic[1], magic[2], magic[3]);
+        ret = 4;
+    }
+
+    source_free(&source);
+
+  RET:
+
+    if (fileIn != stdin)
+        fclose(fileIn);
+
+    if (fileOut == stdout)
+    {
+        if (fflush(stdout) != 0 && ret == 0)
+        {
+            fprintf(stderr, "Failed to write to the output file: %s!\n", strerror(errno));
+            ret = 14;
+        }
+    }
+    else if (fileOut != NULL && fclose(fileOut) != 0 && ret == 0)
+    {
+        fprintf(stderr, "Failed to write to the output file: %s!\n", strerror(errno));
+        ret = 14;
+    }
+
+    return ret;
+}
+
+static int process_file(const char *filename, const char *output, const RuleSet *rules, const Options *opts, int walked, Delta *delta, Arena *arena, Stats *stats)
+{
+    int ret;
+    char magic[4];
+    Cache cache;
+    Cache *index = NULL;
+    Journal journal;
+    Journal *journaled = NULL;
+    FILE *fileIn = NULL;
+    FILE *fileOut = NULL;
+
+    /* The standard input (or output) can't be seeked, it's read through once */
+    if (strcmp(filename, STDIO_PATH) == 0 || (output != NULL && strcmp(output, STDIO_PATH) == 0))
+        return stream_file(filename, output, rules, opts, arena, stats);
+
+    /* Check the input and the output are not the same */
+    if (output != NULL)
+    {
+        if (strcmp(filename, output) == 0)
+        {
+            fputs("The input and the output can't be the same!\n", stderr);
+            return 12;
+        }
+
+        if ((fileOut = fopen(output, "wb")) == NULL)
+        {
+            fprintf(stderr, "Failed to open the output file: %s!\n", strerror(errno));
+            return 3;
+        }
+
+        fileIn = fopen(filename, "rb");
+    }
+    else
+    {
+        if (rules != NULL && !opts->dryRun)
+            fileIn = fopen(filename, "rb+");
+        else
+            fileIn = fopen(filename, "rb");
+    }
+
+    /* Open the input executable file (if output isn't specified, replace in the input directly) */
+    if (fileIn == NULL)
+    {
+        fprintf(stderr, "Failed to open the input file %s: %s!\n", filename, strerror(errno));
+        ret = 3; goto RET;
+    }
+
+    /* A journaled patch saves the former bytes next to the file, until the changes are on the disk */
+    if (opts->journal && rules != NULL && output == NULL && !opts->dryRun)
+    {
+        if (!journal_init(&journal, filename))
+        {
+            fprintf(stderr, "Failed to allocate memory for the journal: %s!\n", strerror(errno));
+            ret = 7; goto RET;
+        }
+        journaled = &journal;
+
+        if (journal_exists(&journal))
+        {
+            fprintf(stderr, "The interrupted patch of %s must be undone first (with --undo)!\n", filename);
+            ret = 15; goto RET;
+        }
+    }
+
+    /* Determine the type of executable using the magic number */
+    memset(magic, 0, sizeof(magic));
+    fread(magic, sizeof(char), 4, fileIn);
+
+    /* Reuse the index of the sections and strings if the file didn't change since */
+    if ((strncmp(magic, MAGIC_ELF, sizeof(MAGIC_ELF)-1) == 0 || strncmp(magic, MAGIC_PE, sizeof(MAGIC_PE)-1) == 0) &&
+        opts->cacheDir != NULL && cache_open(&cache, opts->cacheDir, filename, fileIn))
+        index = &cache;
+
+    if (strncmp(magic, MAGIC_ELF, sizeof(MAGIC_ELF)-1) == 0)
+        ret = elf_process(fileIn, fileOut, rules, opts, index, journaled, delta, arena, stats);
+    else if (strncmp(magic, MAGIC_PE, sizeof(MAGIC_PE)-1) == 0)
+        ret = pe_process(fileIn, fileOut, rules, opts, index, journaled, delta, arena, stats);
+    else if (walked)
+        ret = SKIPPED;
+    else
+    {
+        fprintf(stderr, "Executable format unrecognized: %2X%2X%2X%2X!\n", magic[0], magic[1], magic[2], magic[3]);
+        ret = 4;
+    }
+
+  RET:
+
+    /* The journal is removed once the changes are on the disk, and kept to revert them if they were interrupted */
+    if (journaled != NULL)
+    {
+        const int complete = ret == SKIPPED || (ret >= 0 && ret <= 2);
+
+        if (journaled->file != NULL && !complete)
+            fprintf(stderr, "The former strings of %s are kept in %s, --undo reverts them!\n", filename, journaled->path);
+
+        if (!journal_close(journaled, fileIn, complete) && complete)
+        {
+            fprintf(stderr, "Failed to remove the journal: %s!\n", strerror(errno));
+            ret = 15;
+        }
+    }
+
+    /* The index is kept only if the input remained the same */
+    if (index != NULL)
+        cache_close(index, rules == NULL || output != NULL || opts->dryRun || ret == 1);
+
+    if (fileIn != NULL)
+        fclose(fileIn);
+
+    if (fileOut != NULL)
+        fclose(fileOut);
+
+    return ret;
 }
 
-int main(int argc, char *const argv[])
+static int probe_file(const char *filename, const RuleSet *rules, const Options *opts, int walked, Arena *arena, Stats *stats, unsigned long *count)
 {
-    int i = 1, exact = 0;
+    int ret;
     char magic[4];
-    const char *filename = NULL;
+    long len;
+    double start;
+    Mapping file;
+    FILE *fileIn;
+
+    *count = 0;
+
+    if ((fileIn = fopen(filename, "rb")) == NULL)
+    {
+        fprintf(stderr, "Failed to open the input file %s: %s!\n", filename, strerror(errno));
+        return 3;
+    }
+
+    /* Map the whole file at once, the headers and the sections being read right from the mapping */
+    start = stats_now();
+    if (fseek(fileIn, 0, SEEK_END) != 0 || (len = ftell(fileIn)) < 0)
+    {
+        fprintf(stderr, "Failed to read executable header: %s!\n", strerror(errno));
+        fclose(fileIn);
+        return 5;
+    }
+    if (!mapping_open(&file, fileIn, 0, (size_t)len, MAPPING_READ))
+    {
+        fclose(fileIn);
+        return 13;
+    }
+    stats_phase(stats, PHASE_READ, start);
+
+    /* Determine the type of executable using the magic number */
+    memset(magic, 0, sizeof(magic));
+    memcpy(magic, file.data, len < 4 ? (size_t)len : 4);
+
+    if (strncmp(magic, MAGIC_ELF, sizeof(MAGIC_ELF)-1) == 0)
+        ret = elf_probe(file.data, (size_t)len, rules, opts, arena, stats, count);
+    else if (strncmp(magic, MAGIC_PE, sizeof(MAGIC_PE)-1) == 0)
+        ret = pe_probe(file.data, (size_t)len, rules, opts, arena, stats, count);
+    else if (walked)
+        ret = SKIPPED;
+    else
+    {
+        fprintf(stderr, "Executable format unrecognized: %2X%2X%2X%2X!\n", magic[0], magic[1], magic[2], magic[3]);
+        ret = 4;
+    }
+
+    mapping_close(&file, NULL);
+    fclose(fileIn);
+
+    return ret;
+}
+
+static void run_job(void *arg, unsigned int worker)
+{
+    Job *job = arg;
+    Arena *arena = &job->arenas[worker];
+
+    /* Everything allocated for the file is released at once, the memory going to the next one */
+    if (job->opts->probe != PROBE_NONE)
+        job->ret = probe_file(job->input->path, job->rules, job->opts, job->input->walked, arena, job->stats, &job->count);
+    else
+        job->ret = process_file(job->input->path, NULL, job->rules, job->opts, job->input->walked, NULL, arena, job->stats);
+    if (job->stats != NULL && job->ret != SKIPPED)
+        job->stats->files++;
+    arena_reset(arena);
+}
+
+static int process_files(const InputList *inputs, const RuleSet *rules, const Options *opts, unsigned int jobCount, Stats *stats)
+{
+    unsigned long counts[4] = { 0, 0, 0, 0 }, skipped = 0;
+    size_t workers = jobCount < inputs->count ? jobCount : inputs->count;
+    Job *jobs;
+    Arena *arenas;
+    Stats *jobStats = NULL;
+    size_t i;
+    int ret = 1, error = 0;
+
+    /* Each worker of the pool has its own arena, reused from one file to the next */
+    if (workers == 0)
+        workers = 1;
+
+    /* As are the statistics of every file, summed once they're all processed */
+    jobs = malloc(inputs->count * sizeof(Job));
+    arenas = malloc(workers * sizeof(Arena));
+    if (stats != NULL)
+        jobStats = malloc(inputs->count * sizeof(Stats));
+    if (jobs == NULL || arenas == NULL || (stats != NULL && jobStats == NULL))
+    {
+        fprintf(stderr, "Failed to allocate memory for the jobs: %s!\n", strerror(errno));
+        free(jobs);
+        free(arenas);
+        free(jobStats);
+        return 7;
+    }
+
+    for (i = 0; i < workers; i++)
+        arena_init(&arenas[i]);
+
+    for (i = 0; i < inputs->count; i++)
+    {
+        jobs[i].input = &inputs->inputs[i];
+        jobs[i].rules = rules;
+        jobs[i].opts = opts;
+        jobs[i].arenas = arenas;
+        jobs[i].stats = NULL;
+        jobs[i].count = 0;
+        jobs[i].ret = 0;
+
+        if (jobStats != NULL)
+        {
+            stats_init(&jobStats[i]);
+            jobs[i].stats = &jobStats[i];
+        }
+    }
+
+    /* The files are shared between the workers, the rules being compiled only once */
+    threads_pool(run_job, jobs, sizeof(Job), inputs->count, jobCount);
+
+    for (i = 0; i < workers; i++)
+        arena_free(&arenas[i]);
+    free(arenas);
+
+    for (i = 0; jobStats != NULL && i < inputs->count; i++)
+        stats_add(stats, &jobStats[i]);
+    free(jobStats);
+
+    /* Report the outcome of every file in their order */
+    for (i = 0; i < inputs->count; i++)
+    {
+        const int r = jobs[i].ret;
+
+        switch (r)
+        {
+            case SKIPPED: skipped++; continue;
+            case 0:
+                if (opts->probe == PROBE_FIRST)
+                    printf("%s: found\n", jobs[i].input->path);
+                else if (opts->probe == PROBE_COUNT)
+                    printf("%s: %lu matches\n", jobs[i].input->path, jobs[i].count);
+                else
+                    printf("%s: patched\n", jobs[i].input->path);
+                break;
+            case 1: printf("%s: string not found\n", jobs[i].input->path); break;
+            case 2: printf("%s: strings didn't fit\n", jobs[i].input->path); break;
+            default: printf("%s: failed (error %d)\n", jobs[i].input->path, r); break;
+        }
+
+        counts[r > 2 ? 3 : r]++;
+
+        /* The first error prevails, then the worst outcome among the files */
+        if (r > 2 && error == 0)
+            error = r;
+        else if (r == 2 || (r == 0 && ret == 1))
+            ret = r;
+    }
+
+    if (opts->probe != PROBE_NONE)
+        printf("%lu found, %lu without the strings, %lu failed, %lu skipped\n", counts[0], counts[1], counts[3], skipped);
+    else
+        printf("%lu patched, %lu without the strings, %lu not fitting, %lu failed, %lu skipped\n",
+            counts[0], counts[1], counts[2], counts[3], skipped);
+
+    free(jobs);
+
+    return error != 0 ? error : ret;
+}
+
+static int undo_files(const char **paths, size_t count)
+{
+    unsigned long reverted;
+    size_t i;
+    int ret = 0, r;
+
+    if (count == 0)
+    {
+        fputs("Missing the files to revert!\n", stderr);
+        return 12;
+    }
+
+    /* The first error prevails, the other files being reverted still */
+    for (i = 0; i < count; i++)
+    {
+        if ((r = journal_undo(paths[i], &reverted)) == 0)
+            printf("%s: reverted %lu changes\n", paths[i], reverted);
+        else if (ret == 0)
+            ret = r;
+    }
+
+    return ret;
+}
+
+static int load_rules(RuleSet *rules, const char *rulesFile)
+{
+    FILE *fileRules = strcmp(rulesFile, STDIO_PATH) == 0 ? stdin : fopen(rulesFile, "r");
+    int loaded;
+
+    if (fileRules == NULL)
+    {
+        fprintf(stderr, "Failed to open the rules file: %s!\n", strerror(errno));
+        return 3;
+    }
+
+    loaded = rules_load(rules, fileRules);
+
+    if (fileRules != stdin)
+        fclose(fileRules);
+
+    if (!loaded)
+        return 16;
+    if (rules->count == 0)
+    {
+        fputs("The rules file doesn't contain any rule!\n", stderr);
+        return 16;
+    }
+
+    return 0;
+}
+
+static int serve_job(const char *path, const char *output, const RuleSet *rules, const Options *opts, Arena *arena)
+{
+    return process_file(path, output, rules, opts, 0, NULL, arena, NULL);
+}
+
+static int serve_files(const char *socketPath, const char **paths, size_t count, const RuleSet *flags, const Options *opts, unsigned int jobCount)
+{
+    ServerRules *sets;
+    size_t i, loaded = 0;
+    int ret = 0;
+
+    if (count == 0)
+    {
+        fputs("Missing the rules files to serve!\n", stderr);
+        return 12;
+    }
+
+    if ((sets = malloc(count * sizeof(ServerRules))) == NULL)
+    {
+        fprintf(stderr, "Failed to allocate memory for the rules: %s!\n", strerror(errno));
+        return 7;
+    }
+
+    /* Every rules file is compiled once, then named by its path in the requests */
+    for (i = 0; i < count && ret == 0; i++, loaded++)
+    {
+        sets[i].id = paths[i];
+        rules_init(&sets[i].rules);
+        sets[i].rules.patterns = flags->patterns;
+        sets[i].rules.utf16 = flags->utf16;
+
+        if (strcmp(paths[i], STDIO_PATH) == 0)
+        {
+            fputs("The rules to serve can't be read from the standard input!\n", stderr);
+            ret = 11;
+        }
+        else if ((ret = load_rules(&sets[i].rules, paths[i])) == 0 && !rules_compile(&sets[i].rules))
+            ret = 16;
+    }
+
+    if (ret == 0)
+        ret = server_run(socketPath, sets, count, opts, jobCount, serve_job);
+
+    for (i = 0; i < loaded; i++)
+        rules_free(&sets[i].rules);
+    free(sets);
+
+    return ret;
+}
+
+static int patch_files(const char *patchFile, int revert, const char **paths, size_t count)
+{
+    size_t i, written;
+    int ret = 0, r;
+    Delta delta;
+
+    if (count == 0)
+    {
+        fputs("Missing the files to patch!\n", stderr);
+        return 12;
+    }
+
+    delta_init(&delta);
+    if ((r = delta_load(&delta, patchFile)) != 0)
+    {
+        delta_free(&delta);
+        return r;
+    }
+
+    /* The first error prevails, the other files being patched still */
+    for (i = 0; i < count; i++)
+    {
+        if ((r = delta_apply(&delta, paths[i], revert, &written)) == DELTA_APPLIED)
+            printf("%s: %s (%lu changes)\n", paths[i], revert ? "reverted" : "patched", (unsigned long)written);
+        else if (r == DELTA_ALREADY)
+            printf("%s: already %s\n", paths[i], revert ? "reverted" : "patched");
+        else if (ret == 0)
+            ret = r;
+    }
+
+    delta_free(&delta);
+
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    int i = 1, ret = 0, recursive = 0, threadsSet = 0, statsSet = 0, undo = 0, revert = 0;
+    unsigned int jobCount = threads_count();
     const char *output = NULL;
-    const char *section = NULL;
+    const char **sections = NULL;
+    const char **paths = NULL;
+    size_t pathCount = 0, p;
     const char *search = NULL;
     const char *replace = NULL;
-    FILE *fileIn = NULL;
-    FILE *fileOut = NULL;
+    const char *rulesFile = NULL;
+    const char *patchFile = NULL;
+    const char *appliedFile = NULL;
+    const char *socketPath = NULL;
+    RuleSet rules;
+    Delta delta;
+    InputList inputs;
+    Options opts;
+    Arena arena;
+    Stats stats;
+    Usage started, ended;
+
+    opts.sectionCount = 0;
+    opts.allSections = 0;
+    opts.exact = 0;
+    opts.threads = threads_count();
+    opts.listFormat = LISTING_TEXT;
+    opts.cacheDir = NULL;
+    opts.dryRun = 0;
+    opts.relocate = 0;
+    opts.merged = 0;
+    opts.probe = PROBE_NONE;
+    opts.utf16 = 0;
+    opts.journal = 0;
+    opts.atVaddr = 0;
+    opts.vaddr = 0;
+    rules_init(&rules);
+    inputs_init(&inputs);
+    delta_init(&delta);
+
+    /* The scanning kernels are picked for the processor before any thread is started */
+    scan_init();
+    stats_init(&stats);
+    usage_sample(&started);
+
+    if ((paths = malloc(argc * sizeof(const char*))) == NULL)
+    {
+        fprintf(stderr, "Failed to allocate memory for the arguments: %s!\n", strerror(errno));
+        ret = 7; goto RET;
+    }
 
     /* Checks the arguments */
     while (i < argc)
@@ -48,12 +690,79 @@ int main(int argc, char *const argv[])
             strcmp(arg, "--help") == 0)
         {
             usage(argv[0]);
-            return 0;
+            goto RET;
         }
         else if (strcmp(arg, "-e") == 0 ||
                  strcmp(arg, "--exact") == 0)
         {
-            exact = 1;
+            opts.exact = 1;
+        }
+        else if (strcmp(arg, "--regex") == 0)
+        {
+            rules.patterns = PATTERNS_REGEX;
+        }
+        else if (strcmp(arg, "--wildcard") == 0)
+        {
+            rules.patterns = PATTERNS_WILDCARD;
+        }
+        else if (strcmp(arg, "--utf16") == 0)
+        {
+            opts.utf16 = 1;
+            rules.utf16 = 1;
+        }
+        else if (strcmp(arg, "-a") == 0 ||
+                 strcmp(arg, "--all-string-sections") == 0)
+        {
+            opts.allSections = 1;
+        }
+        else if (strcmp(arg, "-n") == 0 ||
+                 strcmp(arg, "--dry-run") == 0)
+        {
+            opts.dryRun = 1;
+        }
+        else if (strcmp(arg, "--relocate") == 0)
+        {
+            opts.relocate = 1;
+        }
+        else if (strcmp(arg, "--merged") == 0)
+        {
+            opts.merged = 1;
+        }
+        else if (strcmp(arg, "-0") == 0 ||
+                 strcmp(arg, "--null") == 0)
+        {
+            opts.listFormat = LISTING_NULL;
+        }
+        else if (strcmp(arg, "--json") == 0)
+        {
+            opts.listFormat = LISTING_JSON;
+        }
+        else if (strcmp(arg, "-f") == 0 ||
+                 strcmp(arg, "--first") == 0)
+        {
+            opts.probe = PROBE_FIRST;
+        }
+        else if (strcmp(arg, "-c") == 0 ||
+                 strcmp(arg, "--count") == 0)
+        {
+            opts.probe = PROBE_COUNT;
+        }
+        else if (strcmp(arg, "--stats") == 0)
+        {
+            statsSet = 1;
+        }
+        else if (strcmp(arg, "--journal") == 0)
+        {
+            opts.journal = 1;
+        }
+        else if (strcmp(arg, "--undo") == 0)
+        {
+            undo = 1;
+        }
+        else if (strcmp(arg, "-R") == 0 ||
+                 strcmp(arg, "--recursive") == 0)
+        {
+            recursive = 1;
         }
         else if (strcmp(arg, "-s") == 0 ||
                  strcmp(arg, "--section") == 0)
@@ -61,101 +770,324 @@ int main(int argc, char *const argv[])
             if (i >= argc || argv[i][0] == '-')
             {
                 fputs("Missing section name after parameter!\n", stderr);
-                return 11;
+                ret = 11; goto RET;
+            }
+            else if (!add_sections(&sections, &opts.sectionCount, argv[i++]))
+            {
+                ret = 7; goto RET;
+            }
+        }
+        else if (strcmp(arg, "-r") == 0 ||
+                 strcmp(arg, "--rules") == 0)
+        {
+            if (i >= argc || (argv[i][0] == '-' && argv[i][1] != 0))
+            {
+                fputs("Missing rules file after parameter!\n", stderr);
+                ret = 11; goto RET;
+            }
+            else
+                rulesFile = argv[i++];
+        }
+        else if (strcmp(arg, "-j") == 0 ||
+                 strcmp(arg, "--jobs") == 0)
+        {
+            if (i >= argc || atoi(argv[i]) <= 0)
+            {
+                fputs("Missing number of jobs after parameter!\n", stderr);
+                ret = 11; goto RET;
+            }
+            else
+                jobCount = (unsigned int)atoi(argv[i++]);
+        }
+        else if (strcmp(arg, "-t") == 0 ||
+                 strcmp(arg, "--threads") == 0)
+        {
+            if (i >= argc || atoi(argv[i]) <= 0)
+            {
+                fputs("Missing number of threads after parameter!\n", stderr);
+                ret = 11; goto RET;
+            }
+            else
+            {
+                opts.threads = (unsigned int)atoi(argv[i++]);
+                threadsSet = 1;
+            }
+        }
+        else if (strcmp(arg, "--cache") == 0)
+        {
+            if (i >= argc || argv[i][0] == '-')
+            {
+                fputs("Missing cache directory after parameter!\n", stderr);
+                ret = 11; goto RET;
+            }
+            else
+                opts.cacheDir = argv[i++];
+        }
+        else if (strcmp(arg, "--at-vaddr") == 0)
+        {
+            if (i >= argc || !parse_address(argv[i], &opts.vaddr))
+            {
+                fputs("Missing virtual address after parameter!\n", stderr);
+                ret = 11; goto RET;
+            }
+            else
+            {
+                opts.atVaddr = 1;
+                i++;
+            }
+        }
+        else if (strcmp(arg, "--serve") == 0)
+        {
+            if (i >= argc || argv[i][0] == '-')
+            {
+                fputs("Missing socket after parameter!\n", stderr);
+                ret = 11; goto RET;
+            }
+            else
+                socketPath = argv[i++];
+        }
+        else if (strcmp(arg, "--emit-patch") == 0)
+        {
+            if (i >= argc || argv[i][0] == '-')
+            {
+                fputs("Missing patch file after parameter!\n", stderr);
+                ret = 11; goto RET;
             }
             else
-                section = argv[i++];
+                patchFile = argv[i++];
+        }
+        else if (strcmp(arg, "--apply-patch") == 0 ||
+                 strcmp(arg, "--revert-patch") == 0)
+        {
+            if (i >= argc || argv[i][0] == '-')
+            {
+                fputs("Missing patch file after parameter!\n", stderr);
+                ret = 11; goto RET;
+            }
+            else
+            {
+                appliedFile = argv[i++];
+                revert = strcmp(arg, "--revert-patch") == 0;
+            }
         }
         else if (strcmp(arg, "-o") == 0 ||
                  strcmp(arg, "--output") == 0)
         {
-            if (i >= argc || argv[i][0] == '-')
+            if (i >= argc || (argv[i][0] == '-' && argv[i][1] != 0))
             {
                 fputs("Missing output after parameter!\n", stderr);
-                return 11;
+                ret = 11; goto RET;
             }
             else
                 output = argv[i++];
         }
-        else if (arg[0] == '-')
+        else if (arg[0] == '-' && arg[1] != 0)
         {
             fprintf(stderr, "Unrecognized parameter: %s\n", arg);
-            return 11;
+            ret = 11; goto RET;
         }
         else
+            paths[pathCount++] = arg;
+    }
+
+    /* Revert the interrupted patches, nothing else being done */
+    if (undo)
+    {
+        ret = undo_files(paths, pathCount);
+        goto RET;
+    }
+
+    /* Apply (or revert) a patch file, the strings being left aside */
+    if (appliedFile != NULL)
+    {
+        ret = patch_files(appliedFile, revert, paths, pathCount);
+        goto RET;
+    }
+
+    /* The UTF-16 strings are matched as literals, and never moved */
+    if (opts.utf16 && (rules.patterns != PATTERNS_NONE || opts.relocate || opts.merged))
+    {
+        fputs("The UTF-16 strings can't be matched by patterns nor relocated!\n", stderr);
+        ret = 11; goto RET;
+    }
+
+    /* Serve the files sent over the socket, the rules files supplied being named by the requests */
+    if (socketPath != NULL)
+    {
+        if (rulesFile != NULL || output != NULL || opts.dryRun || opts.probe != PROBE_NONE || patchFile != NULL || opts.atVaddr)
         {
-            if (filename == NULL)
-                filename = arg;
-            else if (search == NULL)
-                search = arg;
-            else if (replace == NULL)
-                replace = arg;
-            else
-            {
-                fputs("Only one file can be supplied!\n", stderr);
-                return 11;
-            }
+            fputs("The server only patches the files of its requests, with the rules files supplied!\n", stderr);
+            ret = 11; goto RET;
+        }
+
+        /* Share the processors between the connections, unless told otherwise */
+        if (!threadsSet)
+            opts.threads = opts.threads > jobCount ? opts.threads / jobCount : 1;
+        opts.sections = sections;
+
+        ret = serve_files(socketPath, paths, pathCount, &rules, &opts, jobCount);
+        goto RET;
+    }
+
+    /* Without a rules file, the string and its replacement follow the file */
+    if (rulesFile == NULL)
+    {
+        if (pathCount > 3)
+        {
+            fputs("Only one file can be supplied (use --rules to patch several)!\n", stderr);
+            ret = 11; goto RET;
         }
+
+        search = pathCount > 1 ? paths[1] : NULL;
+        replace = pathCount > 2 ? paths[2] : NULL;
+        if (pathCount > 1)
+            pathCount = 1;
     }
 
     /* If no files are specified */
-    if (filename == NULL)
+    if (pathCount == 0)
     {
         usage(argv[0]);
-        return 12;
+        ret = 12; goto RET;
     }
-    if (replace == NULL)
-        output = NULL;
+    opts.sections = sections;
 
-    /* Check the input and the output are not the same */
-    if (output != NULL)
+    /* The journal saves what's overwritten in the input */
+    if (opts.journal && (output != NULL || strcmp(paths[0], STDIO_PATH) == 0))
     {
-        if (strcmp(filename, output) == 0)
+        fputs("The journal only applies to the files patched in place!\n", stderr);
+        ret = 11; goto RET;
+    }
+
+    /* The patch file records the changes written into a file (streams excepted) */
+    if (patchFile != NULL && (opts.dryRun || opts.probe != PROBE_NONE || (output != NULL && strcmp(output, STDIO_PATH) == 0) || strcmp(paths[0], STDIO_PATH) == 0))
+    {
+        fputs("A patch file can only be emitted while patching a file!\n", stderr);
+        ret = 11; goto RET;
+    }
+
+    /* The string at an address is patched where it lies in a file, on its own */
+    if (opts.atVaddr && (opts.relocate || opts.merged || opts.utf16 || opts.probe != PROBE_NONE || opts.allSections || opts.sectionCount > 0 ||
+        (output != NULL && strcmp(output, STDIO_PATH) == 0) || strcmp(paths[0], STDIO_PATH) == 0))
+    {
+        fputs("The string at an address can't be searched for in sections, moved nor streamed!\n", stderr);
+        ret = 11; goto RET;
+    }
+
+    /* The standard input can only be streamed once, the references to the strings being spread before and after them */
+    if ((opts.relocate || opts.merged) && ((output != NULL && strcmp(output, STDIO_PATH) == 0) || (pathCount > 0 && strcmp(paths[0], STDIO_PATH) == 0)))
+    {
+        fputs("The strings can't be relocated in a stream!\n", stderr);
+        ret = 11; goto RET;
+    }
+    for (p = 0; p < pathCount; p++)
+    {
+        if (strcmp(paths[p], STDIO_PATH) == 0 && (pathCount > 1 || (rulesFile != NULL && strcmp(rulesFile, STDIO_PATH) == 0)))
         {
-            fputs("The input and the output can't be the same!\n", stderr);
-            return 12;
+            fputs("The standard input can't be supplied along with other inputs!\n", stderr);
+            ret = 11; goto RET;
         }
+    }
 
-        if ((fileOut = fopen(output, "wb")) == NULL)
+    /* The files are searched where they're mapped */
+    if (opts.probe != PROBE_NONE && (search == NULL && rulesFile == NULL))
+    {
+        fputs("Missing the string to search for!\n", stderr);
+        ret = 11; goto RET;
+    }
+    if (opts.probe != PROBE_NONE && strcmp(paths[0], STDIO_PATH) == 0)
+    {
+        fputs("The standard input can't be searched without being patched!\n", stderr);
+        ret = 11; goto RET;
+    }
+
+    /* Gather all the search and replace pairs */
+    if (rulesFile != NULL && (ret = load_rules(&rules, rulesFile)) != 0)
+        goto RET;
+    if ((replace != NULL || (opts.probe != PROBE_NONE && search != NULL)) && !rules_add(&rules, search, replace != NULL ? replace : ""))
+    {
+        ret = 16; goto RET;
+    }
+    if (rules.count == 0 || opts.dryRun || opts.probe != PROBE_NONE)
+        output = NULL;
+    if (rules.count > 0 && !rules_compile(&rules))
+    {
+        ret = 16; goto RET;
+    }
+
+    /* Gather the files, walking through the directories */
+    for (p = 0; p < pathCount; p++)
+    {
+        if (!inputs_add(&inputs, paths[p], recursive))
         {
-            fprintf(stderr, "Failed to open the output file: %s!\n", strerror(errno));
-            return 3;
+            ret = 3; goto RET;
         }
+    }
 
-        fileIn = fopen(filename, "rb");
+    if (patchFile != NULL && (rules.count == 0 || inputs.count != 1 || inputs.inputs[0].walked))
+    {
+        fputs("A patch file can only be emitted while patching a single file!\n", stderr);
+        ret = 11; goto RET;
     }
-    else
+
+    /* A single file is processed directly (the searches are reported as those of several files) */
+    if (inputs.count == 1 && !inputs.inputs[0].walked && opts.probe == PROBE_NONE)
     {
-        if (replace != NULL)
-            fileIn = fopen(filename, "rb+");
-        else
-            fileIn = fopen(filename, "rb");
+        if (patchFile != NULL && !delta_create(&delta, patchFile))
+        {
+            fprintf(stderr, "Failed to write the patch file: %s!\n", strerror(errno));
+            delta_close(&delta);
+            ret = 14; goto RET;
+        }
+
+        arena_init(&arena);
+        ret = process_file(inputs.inputs[0].path, output, rules.count > 0 ? &rules : NULL, &opts, 0, patchFile != NULL ? &delta : NULL, &arena, statsSet ? &stats : NULL);
+        stats.files = 1;
+        arena_free(&arena);
+
+        /* The patch file holds every change written so far, even if the patch failed */
+        if (!delta_close(&delta) && ret <= 2)
+        {
+            fprintf(stderr, "Failed to write the patch file: %s!\n", strerror(errno));
+            ret = 14;
+        }
+
+        /* The planned changes are enough of a report for a dry run, as is the patched executable sent to the standard output */
+        if (rules.count > 0 && !(ret == 0 && (opts.dryRun || (output != NULL ? strcmp(output, STDIO_PATH) == 0 : strcmp(paths[0], STDIO_PATH) == 0))))
+            print_status(ret);
+        goto RET;
     }
 
-    /* Open the input executable file (if output isn't specified, replace in the input directly) */
-    if (fileIn == NULL)
+    if (rules.count == 0)
     {
-        fprintf(stderr, "Failed to open the input file: %s!\n", strerror(errno));
-        return 3;
+        fputs("The strings can only be listed from a single file!\n", stderr);
+        ret = 11; goto RET;
+    }
+    if (output != NULL)
+    {
+        fputs("An output can't be supplied along with several files!\n", stderr);
+        ret = 12; goto RET;
     }
 
-    /* Determine the type of executable using the magic number */
-    fread(magic, sizeof(char), 4, fileIn);
+    /* Share the processors between the files, unless told otherwise */
+    if (!threadsSet)
+        opts.threads = opts.threads > jobCount ? opts.threads / jobCount : 1;
 
-    if (strncmp(magic, MAGIC_ELF, sizeof(MAGIC_ELF)-1) == 0)
-        i = elf_process(fileIn, fileOut, section, search, replace, exact);
-    else if (strncmp(magic, MAGIC_PE, sizeof(MAGIC_PE)-1) == 0)
-        i = pe_process(fileIn, fileOut, section, search, replace, exact);
-    else
+    ret = process_files(&inputs, &rules, &opts, jobCount, statsSet ? &stats : NULL);
+
+  RET:
+
+    /* The statistics go along with the outcome, away from the strings and the streamed executable */
+    if (statsSet && stats.files > 0)
     {
-        fprintf(stderr, "Executable format unrecognized: %2X%2X%2X%2X!\n", magic[0], magic[1], magic[2], magic[3]);
-        i = 4;
+        usage_sample(&ended);
+        stats_print(stderr, &stats, &started, &ended, opts.listFormat == LISTING_JSON);
     }
 
-    fclose(fileIn);
-
-    if (fileOut != NULL)
-        fclose(fileOut);
+    rules_free(&rules);
+    inputs_free(&inputs);
+    free((void*)sections);
+    free((void*)paths);
 
-    return i;
+    return ret;
 }
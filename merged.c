@@ -0,0 +1,146 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Strings sharing the tail of another one (merged by the linker), checked before the changes are applied.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "merged.h"
+#include "common.h"
+#include "scan.h"
+
+/* The tail of a string as its own string, once the rules applied to it */
+typedef struct Tail
+{
+    size_t offset;
+    size_t len;
+    char *expected;
+    size_t expectedLen;
+    Plan plan;
+} Tail;
+
+static int substitute_tail(Tail *t, const char *data, const RuleSet *rules, int exact, Arena *arena)
+{
+    char *copy;
+
+    plan_init(&t->plan);
+    t->expected = (char*)&data[t->offset];
+    t->expectedLen = t->len;
+
+    /* Replace in a terminated copy of the tail, as if it wasn't merged */
+    if ((copy = arena_alloc(arena, t->len + 1)) == NULL)
+        return 0;
+    memcpy(copy, &data[t->offset], t->len);
+    copy[t->len] = 0;
+
+    if ((exact ? search_and_replace_exact(copy, rules, t->len + 1, NULL, &t->plan, arena, NULL) :
+                 search_and_replace(copy, rules, t->len + 1, NULL, &t->plan, arena, NULL)) > 2)
+        return 0;
+
+    if (t->plan.count > 0)
+    {
+        t->expected = t->plan.changes[0].replacement;
+        t->expectedLen = t->plan.changes[0].newLen;
+    }
+
+    return 1;
+}
+
+static int check_string(const char *data, size_t start, size_t end, Tail *tails, size_t count, const RuleSet *rules, int exact, Plan *plan, size_t planned, Arena *arena)
+{
+    const Change *found = plan_find(plan, planned, start);
+    Change *change = (Change*)found;
+    int inPlace, ok = 1;
+    size_t i, k;
+
+    for (i = 0; i < count; i++)
+    {
+        if (!substitute_tail(&tails[i], data, rules, exact, arena))
+            ok = 0;
+    }
+
+    /* The string can only be rewritten in place if its new tails are those expected on their own */
+    inPlace = change != NULL && change->newLen <= change->available && change->conflict < 0;
+    for (i = 0; i < count && ok && inPlace; i++)
+    {
+        k = tails[i].offset - start;
+
+        if (change->newLen < k || change->newLen - k != tails[i].expectedLen ||
+            memcmp(&change->replacement[k], tails[i].expected, tails[i].expectedLen) != 0)
+        {
+            change->conflict = (long)tails[i].offset;
+            inPlace = 0;
+        }
+    }
+
+    /* Otherwise the tails which change are replaced on their own (they may only be moved) */
+    for (i = 0; i < count && ok; i++)
+    {
+        const Tail *t = &tails[i];
+
+        if (!inPlace && (t->expectedLen != t->len || memcmp(t->expected, &data[t->offset], t->len) != 0))
+        {
+            if (!plan_add(plan, t->offset, t->len, t->expected, t->expectedLen, end - t->offset))
+                ok = 0;
+            else
+                plan->changes[plan->count - 1].conflict = (long)start;
+        }
+    }
+
+    for (i = 0; i < count; i++)
+        plan_free(&tails[i].plan);
+
+    return ok;
+}
+
+int merged_check(const char *data, const Section *s, const RuleSet *rules, int exact, const RefList *refs, Plan *plan, Arena *arena)
+{
+    const size_t planned = plan->count;
+    size_t first, count, i, start = 0, end = 0, k, tailCount = 0;
+    Tail *tails;
+    int ok = 1;
+
+    /* The references into a string (past its start) are the strings merged with its tail */
+    count = refs_range(refs, s->address + 1, s->size > 0 ? s->size - 1 : 0, &first);
+    if (count == 0)
+        return 1;
+
+    if ((tails = arena_alloc(arena, count * sizeof(Tail))) == NULL)
+        return 0;
+
+    for (i = first; i < first + count && ok; i++)
+    {
+        k = (size_t)(refs->refs[i].target - s->address);
+
+        if (data[k - 1] == 0 || data[k] == 0 || (tailCount > 0 && tails[tailCount - 1].offset == k))
+            continue;
+
+        /* Start over with every string holding tails */
+        if (tailCount == 0 || k >= end)
+        {
+            if (tailCount > 0)
+                ok = check_string(data, start, end, tails, tailCount, rules, exact, plan, planned, arena);
+            tailCount = 0;
+
+            for (start = k; start > 0 && data[start - 1] != 0; start--);
+            end = k + scan_find(&data[k], s->size - k, 0);
+            if (end >= s->size)
+                continue;
+        }
+
+        tails[tailCount].offset = k;
+        tails[tailCount].len = end - k;
+        tailCount++;
+    }
+
+    if (ok && tailCount > 0)
+        ok = check_string(data, start, end, tails, tailCount, rules, exact, plan, planned, arena);
+
+    /* The tails replaced on their own are ordered along the others */
+    if (plan->count > planned)
+        plan_sort(plan);
+
+    return ok;
+}
@@ -0,0 +1,19 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Strings sharing the tail of another one (merged by the linker), checked before the changes are applied.
+ */
+
+#ifndef MERGED_H_INCLUDED
+#define MERGED_H_INCLUDED
+
+#include "rules.h"
+#include "sections.h"
+#include "plan.h"
+#include "refs.h"
+#include "arena.h"
+
+int merged_check(const char *data, const Section *s, const RuleSet *rules, int exact, const RefList *refs, Plan *plan, Arena *arena);
+
+#endif
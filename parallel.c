@@ -0,0 +1,251 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Split the strings tables in chunks scanned by several threads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "parallel.h"
+#include "common.h"
+#include "threads.h"
+#include "scan.h"
+#include "report.h"
+
+/* Below this size per thread, starting the threads costs more than it saves */
+#define MIN_CHUNK_SIZE (1024 * 1024)
+
+/* A part of the strings table, with what its thread found */
+typedef struct Chunk
+{
+    char *data;
+    size_t offset;
+    size_t len;
+    const RuleSet *rules;
+    int exact;
+    int ret;
+    RangeList dirty;
+    Plan plan;
+    int planning;
+    StringIndex index;
+    Arena *arena;
+    Arena scratch;
+    Tally tally;
+    char error[REPORT_LEN];
+} Chunk;
+
+static size_t next_string(const char *data, size_t i, size_t len, int utf16)
+{
+    /* Skip the end of the current string, then its termination */
+    if (utf16)
+    {
+        i -= i % 2;
+        i += scan_find_wide(&data[i], len - i);
+
+        return i + scan_skip_wide(&data[i], len - i);
+    }
+
+    i += scan_find(&data[i], len - i, 0);
+
+    return i + scan_skip(&data[i], len - i, 0);
+}
+
+static Chunk *split_chunks(char *data, size_t len, unsigned int threads, int utf16, size_t *count)
+{
+    Chunk *chunks;
+    size_t n, i, start = 0;
+
+    n = len / MIN_CHUNK_SIZE;
+    if (n > threads)
+        n = threads;
+    if (n <= 1)
+        return NULL;
+
+    if ((chunks = calloc(n, sizeof(Chunk))) == NULL)
+        return NULL;
+
+    /* Each chunk begins with a string, so that no string nor its padding is shared by two chunks */
+    for (i = 0, *count = 0; i < n && start < len; i++)
+    {
+        size_t end = i + 1 < n ? next_string(data, (len / n) * (i + 1), len, utf16) : len;
+
+        if (end <= start)
+            continue;
+
+        chunks[*count].data = &data[start];
+        chunks[*count].offset = start;
+        chunks[*count].len = end - start;
+        ranges_init(&chunks[*count].dirty);
+        strindex_init(&chunks[*count].index);
+        plan_init(&chunks[*count].plan);
+        arena_init(&chunks[*count].scratch);
+        chunks[*count].arena = &chunks[*count].scratch;
+        chunks[*count].error[0] = 0;
+        (*count)++;
+
+        start = end;
+    }
+
+    return chunks;
+}
+
+static void free_chunks(Chunk *chunks, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        ranges_free(&chunks[i].dirty);
+        strindex_free(&chunks[i].index);
+        plan_free(&chunks[i].plan);
+        arena_free(&chunks[i].scratch);
+    }
+
+    free(chunks);
+}
+
+static void replace_chunk(void *arg)
+{
+    Chunk *c = arg;
+    Plan *plan = c->planning ? &c->plan : NULL;
+    ReportSink sink;
+    void *context;
+
+    /* The failures of a chunk are reported by the thread which started it, once they're done */
+    report_get_thread(&sink, &context);
+    report_set_thread(report_keep, c->error);
+
+    if (c->exact == 0)
+        c->ret = search_and_replace(c->data, c->rules, c->len, &c->dirty, plan, c->arena, &c->tally);
+    else
+        c->ret = search_and_replace_exact(c->data, c->rules, c->len, &c->dirty, plan, c->arena, &c->tally);
+
+    report_set_thread(sink, context);
+}
+
+static void index_chunk(void *arg)
+{
+    Chunk *c = arg;
+
+    if (!strindex_build(&c->index, c->data, c->len))
+        c->ret = 7;
+}
+
+int parallel_replace(char *data, const RuleSet *rules, size_t len, int exact, unsigned int threads, RangeList *dirty, Plan *plan, Arena *arena, Tally *tally)
+{
+    Chunk *chunks;
+    size_t count, i, j;
+    int ret = 1;
+
+    /* Small tables are not worth the threads */
+    if ((chunks = split_chunks(data, len, threads, rules->utf16, &count)) == NULL)
+        return exact == 0 ? search_and_replace(data, rules, len, dirty, plan, arena, tally) : search_and_replace_exact(data, rules, len, dirty, plan, arena, tally);
+
+    for (i = 0; i < count; i++)
+    {
+        chunks[i].rules = rules;
+        chunks[i].exact = exact;
+        chunks[i].planning = plan != NULL;
+    }
+
+    /* The first chunk is scanned by the current thread, the others have their own scratch */
+    chunks[0].arena = arena;
+
+    threads_run(replace_chunk, chunks, sizeof(Chunk), count);
+
+    /* Merge the results in the order of the table, as a single thread would have produced them */
+    for (i = 0; i < count; i++)
+    {
+        const Chunk *c = &chunks[i];
+
+        if (c->error[0] != 0)
+            report_error("%s\n", c->error);
+
+        /* Keep the worst outcome among the chunks, a failure (above 2) prevailing */
+        if (ret <= 2 && (c->ret >= 2 || (c->ret == 0 && ret == 1)))
+            ret = c->ret;
+
+        if (c->dirty.whole)
+            dirty->whole = 1;
+
+        for (j = 0; j < c->dirty.count; j++)
+            ranges_add(dirty, c->offset + c->dirty.ranges[j].offset, c->dirty.ranges[j].len);
+
+        /* The changes of a chunk which can't be kept fail the whole table */
+        if (plan != NULL && ret <= 2 && !plan_append(plan, &chunks[i].plan, c->offset))
+        {
+            report_error("Failed to allocate memory for the changes: %s!\n", strerror(errno));
+            ret = 7;
+        }
+
+        if (tally != NULL)
+            tally_add(tally, &c->tally);
+    }
+
+    free_chunks(chunks, count);
+
+    return ret;
+}
+
+int parallel_index(const char *data, size_t len, unsigned int threads, StringIndex *index)
+{
+    Chunk *chunks;
+    size_t count, i, j;
+    int ret = 1;
+
+    /* The chunks are only read, the table is never modified */
+    if ((chunks = split_chunks((char*)data, len, threads, 0, &count)) == NULL)
+        return strindex_build(index, data, len);
+
+    threads_run(index_chunk, chunks, sizeof(Chunk), count);
+
+    /* Gather the strings in the order of the table */
+    for (i = 0; i < count && ret; i++)
+    {
+        const Chunk *c = &chunks[i];
+
+        ret = c->ret == 0;
+        for (j = 0; j < c->index.count && ret; j++)
+            ret = strindex_push(index, c->offset + c->index.spans[j].offset, c->index.spans[j].len, c->index.spans[j].available);
+    }
+
+    free_chunks(chunks, count);
+
+    return ret;
+}
+
+void parallel_print(Listing *out, const char *data, size_t offset_start, size_t len, unsigned int threads)
+{
+    Chunk *chunks;
+    size_t count, i, j;
+
+    /* The chunks are only read, the table is never modified (the index only knows of the bytes strings) */
+    if (out->utf16 || (chunks = split_chunks((char*)data, len, threads, 0, &count)) == NULL)
+    {
+        print_strings(out, data, offset_start, len);
+        return;
+    }
+
+    threads_run(index_chunk, chunks, sizeof(Chunk), count);
+
+    /* Print the strings in the order of the table */
+    for (i = 0; i < count; i++)
+    {
+        const Chunk *c = &chunks[i];
+
+        if (c->ret != 0)
+        {
+            /* Lacking memory to record them, list the strings of the chunk directly */
+            print_strings(out, c->data, offset_start + c->offset, c->len);
+            continue;
+        }
+
+        for (j = 0; j < c->index.count; j++)
+            listing_string(out, &c->data[c->index.spans[j].offset], offset_start + c->offset + c->index.spans[j].offset, c->index.spans[j].len);
+    }
+
+    free_chunks(chunks, count);
+}
@@ -0,0 +1,24 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Split the strings tables in chunks scanned by several threads.
+ */
+
+#ifndef PARALLEL_H_INCLUDED
+#define PARALLEL_H_INCLUDED
+
+#include "rules.h"
+#include "ranges.h"
+#include "listing.h"
+#include "strindex.h"
+#include "plan.h"
+#include "arena.h"
+#include "stats.h"
+
+int parallel_replace(char *data, const RuleSet *rules, size_t len, int exact, unsigned int threads, RangeList *dirty, Plan *plan, Arena *arena, Tally *tally);
+
+int parallel_index(const char *data, size_t len, unsigned int threads, StringIndex *index);
+void parallel_print(Listing *out, const char *data, size_t offset_start, size_t len, unsigned int threads);
+
+#endif
@@ -0,0 +1,1044 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Patterns (regular expressions or wildcards) matched within the strings, without backtracking.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "pattern.h"
+#include "report.h"
+
+/* Instructions of the program */
+#define OP_SET   0  /* Consume a character of the set a */
+#define OP_SPLIT 1  /* Go on at a, then at b (with a lower priority) */
+#define OP_JMP   2  /* Go on at a */
+#define OP_SAVE  3  /* Record the position in the group slot a */
+#define OP_BOL   4  /* Only at the start of the string */
+#define OP_EOL   5  /* Only at the end of the string */
+#define OP_MATCH 6  /* The rule a matched */
+
+/* Nodes of the parsed patterns */
+#define NODE_SET    0
+#define NODE_EMPTY  1
+#define NODE_CAT    2
+#define NODE_ALT    3
+#define NODE_REPEAT 4
+#define NODE_GROUP  5
+#define NODE_BOL    6
+#define NODE_EOL    7
+
+#define REPEAT_MAX  255
+#define REPEAT_INF  ((size_t)-1)
+
+/* Beyond these sizes, the strings are only matched by the simulation (without the automaton telling which to try) */
+#define MAX_CODE_DFA 8192
+#define MAX_STATES   4096
+
+#define MAX_CODE     65536
+
+#define HAS(set, c) ((set)[(unsigned char)(c) >> 3] & (1 << ((unsigned char)(c) & 7)))
+
+typedef struct Node
+{
+    int type;
+    size_t left;
+    size_t right;
+    size_t min;
+    size_t max;
+} Node;
+
+/* State of the parsing of a pattern */
+typedef struct Parser
+{
+    const char *p;
+    const char *end;
+    Node *nodes;
+    size_t count;
+    size_t capacity;
+    Pattern *re;
+    size_t groups;
+    const char *error;
+} Parser;
+
+static size_t new_set(Pattern *re)
+{
+    unsigned char (*grown)[32];
+
+    /* Grow the sets by powers of two */
+    if (re->setCount == 0 || (re->setCount >= 8 && (re->setCount & (re->setCount - 1)) == 0))
+    {
+        if ((grown = realloc(re->sets, (re->setCount > 0 ? re->setCount * 2 : 8) * 32)) == NULL)
+            return REPEAT_INF;
+        re->sets = grown;
+    }
+
+    memset(re->sets[re->setCount], 0, 32);
+
+    return re->setCount++;
+}
+
+static size_t new_node(Parser *ps, int type, size_t left, size_t right)
+{
+    if (ps->count >= ps->capacity)
+    {
+        const size_t capacity = ps->capacity > 0 ? ps->capacity * 2 : 64;
+        Node *grown;
+
+        if ((grown = realloc(ps->nodes, capacity * sizeof(Node))) == NULL)
+        {
+            ps->error = strerror(errno);
+            return REPEAT_INF;
+        }
+
+        ps->nodes = grown;
+        ps->capacity = capacity;
+    }
+
+    ps->nodes[ps->count].type = type;
+    ps->nodes[ps->count].left = left;
+    ps->nodes[ps->count].right = right;
+    ps->nodes[ps->count].min = 0;
+    ps->nodes[ps->count].max = 0;
+
+    return ps->count++;
+}
+
+static size_t set_node(Parser *ps, size_t *set)
+{
+    if ((*set = new_set(ps->re)) == REPEAT_INF)
+    {
+        ps->error = strerror(errno);
+        return REPEAT_INF;
+    }
+
+    return new_node(ps, NODE_SET, *set, 0);
+}
+
+static void set_add(unsigned char *set, int first, int last)
+{
+    int c;
+
+    for (c = first; c <= last; c++)
+        set[c >> 3] |= (unsigned char)(1 << (c & 7));
+}
+
+static void set_invert(unsigned char *set)
+{
+    int i;
+
+    /* The termination is never part of a string */
+    for (i = 0; i < 32; i++)
+        set[i] = (unsigned char)~set[i];
+    set[0] &= (unsigned char)~1;
+}
+
+/* Add the characters of an escape sequence (\d, \w, \s and their opposites) to a set, or return the character escaped */
+static int escape_class(unsigned char *set, int c)
+{
+    unsigned char other[32];
+
+    memset(other, 0, sizeof(other));
+
+    switch (c)
+    {
+        case 'd': case 'D': set_add(other, '0', '9'); break;
+        case 'w': case 'W': set_add(other, '0', '9'); set_add(other, 'a', 'z'); set_add(other, 'A', 'Z'); set_add(other, '_', '_'); break;
+        case 's': case 'S': set_add(other, ' ', ' '); set_add(other, '\t', '\r'); break;
+        case 't': return '\t';
+        case 'n': return '\n';
+        case 'r': return '\r';
+        default: return c;
+    }
+
+    if (c == 'D' || c == 'W' || c == 'S')
+        set_invert(other);
+
+    for (c = 0; c < 32; c++)
+        set[c] |= other[c];
+
+    return -1;
+}
+
+static size_t parse_alternation(Parser *ps);
+
+static size_t parse_class(Parser *ps, int wildcard)
+{
+    size_t set, node;
+    unsigned char *bits;
+    int negated = 0, first = 1, c, last;
+
+    if ((node = set_node(ps, &set)) == REPEAT_INF)
+        return REPEAT_INF;
+    bits = ps->re->sets[set];
+
+    /* A wildcard class is negated by an exclamation mark */
+    if (ps->p < ps->end && (*ps->p == '^' || (wildcard && *ps->p == '!')))
+    {
+        negated = 1;
+        ps->p++;
+    }
+
+    /* A bracket right at the start is part of the class */
+    while (ps->p < ps->end && (*ps->p != ']' || first))
+    {
+        c = (unsigned char)*ps->p++;
+        first = 0;
+
+        if (c == '\\' && ps->p < ps->end && (c = escape_class(bits, (unsigned char)*ps->p++)) < 0)
+            continue;
+
+        /* A range, unless the dash ends the class */
+        if (ps->p + 1 < ps->end && *ps->p == '-' && ps->p[1] != ']')
+        {
+            last = (unsigned char)ps->p[1];
+            ps->p += 2;
+            if (last == '\\' && ps->p < ps->end)
+                last = escape_class(bits, (unsigned char)*ps->p++);
+            if (last < c)
+            {
+                ps->error = "bad range in the class";
+                return REPEAT_INF;
+            }
+            set_add(bits, c, last);
+        }
+        else
+            set_add(bits, c, c);
+    }
+
+    if (ps->p >= ps->end)
+    {
+        ps->error = "missing ] at the end of the class";
+        return REPEAT_INF;
+    }
+    ps->p++;
+
+    if (negated)
+        set_invert(bits);
+    bits[0] &= (unsigned char)~1;
+
+    return node;
+}
+
+static size_t parse_atom(Parser *ps)
+{
+    size_t set, node, inner;
+    int c = (unsigned char)*ps->p++, group = 1;
+
+    switch (c)
+    {
+        case '(':
+            /* The groups are numbered by their opening, the non-capturing ones being left out */
+            if (ps->end - ps->p >= 2 && ps->p[0] == '?' && ps->p[1] == ':')
+            {
+                ps->p += 2;
+                group = 0;
+            }
+            else if (ps->groups < PATTERN_GROUPS)
+                group = (int)ps->groups++;
+            else
+                group = 0;
+
+            if ((inner = parse_alternation(ps)) == REPEAT_INF)
+                return REPEAT_INF;
+            if (ps->p >= ps->end || *ps->p != ')')
+            {
+                ps->error = "missing ) at the end of the group";
+                return REPEAT_INF;
+            }
+            ps->p++;
+
+            if (group == 0)
+                return inner;
+            if ((node = new_node(ps, NODE_GROUP, inner, 0)) != REPEAT_INF)
+                ps->nodes[node].min = (size_t)group;
+            return node;
+
+        case '[':
+            return parse_class(ps, 0);
+
+        case '^':
+            return new_node(ps, NODE_BOL, 0, 0);
+
+        case '$':
+            return new_node(ps, NODE_EOL, 0, 0);
+
+        case '*': case '+': case '?': case '{':
+            ps->error = "nothing to repeat";
+            return REPEAT_INF;
+
+        default:
+            if ((node = set_node(ps, &set)) == REPEAT_INF)
+                return REPEAT_INF;
+
+            if (c == '.')
+            {
+                set_add(ps->re->sets[set], 1, 255);
+                return node;
+            }
+
+            if (c == '\\')
+            {
+                if (ps->p >= ps->end)
+                {
+                    ps->error = "trailing backslash";
+                    return REPEAT_INF;
+                }
+                if ((c = escape_class(ps->re->sets[set], (unsigned char)*ps->p++)) < 0)
+                    return node;
+            }
+
+            set_add(ps->re->sets[set], c, c);
+            return node;
+    }
+}
+
+static int parse_count(Parser *ps, size_t *n)
+{
+    size_t value = 0;
+    int digits = 0;
+
+    while (ps->p < ps->end && *ps->p >= '0' && *ps->p <= '9')
+    {
+        value = value * 10 + (size_t)(*ps->p++ - '0');
+        if (value > REPEAT_MAX)
+        {
+            ps->error = "repetition count too large";
+            return 0;
+        }
+        digits++;
+    }
+
+    *n = value;
+
+    return digits > 0;
+}
+
+static size_t parse_repeat(Parser *ps)
+{
+    size_t node, min, max;
+
+    if ((node = parse_atom(ps)) == REPEAT_INF)
+        return REPEAT_INF;
+
+    /* Apply the quantifiers following the atom */
+    while (ps->p < ps->end && (*ps->p == '*' || *ps->p == '+' || *ps->p == '?' || *ps->p == '{'))
+    {
+        const char op = *ps->p++;
+
+        switch (op)
+        {
+            case '*': min = 0; max = REPEAT_INF; break;
+            case '+': min = 1; max = REPEAT_INF; break;
+            case '?': min = 0; max = 1; break;
+            default:
+                if (!parse_count(ps, &min))
+                {
+                    if (ps->error == NULL)
+                        ps->error = "bad repetition count";
+                    return REPEAT_INF;
+                }
+                max = min;
+                if (ps->p < ps->end && *ps->p == ',')
+                {
+                    ps->p++;
+                    max = REPEAT_INF;
+                    if (ps->p < ps->end && *ps->p != '}' && (!parse_count(ps, &max) || max < min))
+                    {
+                        if (ps->error == NULL)
+                            ps->error = "bad repetition count";
+                        return REPEAT_INF;
+                    }
+                }
+                if (ps->p >= ps->end || *ps->p++ != '}')
+                {
+                    ps->error = "missing } at the end of the repetition";
+                    return REPEAT_INF;
+                }
+                break;
+        }
+
+        if ((node = new_node(ps, NODE_REPEAT, node, 0)) == REPEAT_INF)
+            return REPEAT_INF;
+        ps->nodes[node].min = min;
+        ps->nodes[node].max = max;
+    }
+
+    return node;
+}
+
+static size_t parse_concatenation(Parser *ps)
+{
+    size_t node = REPEAT_INF, next;
+
+    while (ps->p < ps->end && *ps->p != '|' && *ps->p != ')')
+    {
+        if ((next = parse_repeat(ps)) == REPEAT_INF)
+            return REPEAT_INF;
+
+        node = node == REPEAT_INF ? next : new_node(ps, NODE_CAT, node, next);
+        if (node == REPEAT_INF)
+            return REPEAT_INF;
+    }
+
+    return node == REPEAT_INF ? new_node(ps, NODE_EMPTY, 0, 0) : node;
+}
+
+static size_t parse_alternation(Parser *ps)
+{
+    size_t node, next;
+
+    if ((node = parse_concatenation(ps)) == REPEAT_INF)
+        return REPEAT_INF;
+
+    while (ps->p < ps->end && *ps->p == '|')
+    {
+        ps->p++;
+        if ((next = parse_concatenation(ps)) == REPEAT_INF || (node = new_node(ps, NODE_ALT, node, next)) == REPEAT_INF)
+            return REPEAT_INF;
+    }
+
+    return node;
+}
+
+static size_t parse_wildcard(Parser *ps)
+{
+    size_t node = REPEAT_INF, next, set;
+    int c;
+
+    /* A star stands for any sequence and a question mark for any character, each of them captured as a group */
+    while (ps->p < ps->end)
+    {
+        c = (unsigned char)*ps->p++;
+
+        if (c == '[')
+            next = parse_class(ps, 1);
+        else if ((next = set_node(ps, &set)) != REPEAT_INF)
+        {
+            if (c == '*' || c == '?')
+                set_add(ps->re->sets[set], 1, 255);
+            else
+            {
+                if (c == '\\' && ps->p < ps->end)
+                    c = (unsigned char)*ps->p++;
+                set_add(ps->re->sets[set], c, c);
+            }
+
+            if (c == '*' && next != REPEAT_INF && (next = new_node(ps, NODE_REPEAT, next, 0)) != REPEAT_INF)
+                ps->nodes[next].max = REPEAT_INF;
+
+            if ((c == '*' || c == '?') && next != REPEAT_INF && ps->groups < PATTERN_GROUPS &&
+                (next = new_node(ps, NODE_GROUP, next, 0)) != REPEAT_INF)
+                ps->nodes[next].min = ps->groups++;
+        }
+
+        if (next == REPEAT_INF)
+            return REPEAT_INF;
+
+        node = node == REPEAT_INF ? next : new_node(ps, NODE_CAT, node, next);
+        if (node == REPEAT_INF)
+            return REPEAT_INF;
+    }
+
+    return node == REPEAT_INF ? new_node(ps, NODE_EMPTY, 0, 0) : node;
+}
+
+static int nullable(const Parser *ps, size_t n)
+{
+    const Node *node = &ps->nodes[n];
+
+    switch (node->type)
+    {
+        case NODE_SET:    return 0;
+        case NODE_CAT:    return nullable(ps, node->left) && nullable(ps, node->right);
+        case NODE_ALT:    return nullable(ps, node->left) || nullable(ps, node->right);
+        case NODE_REPEAT: return node->min == 0 || nullable(ps, node->left);
+        case NODE_GROUP:  return nullable(ps, node->left);
+        default:          return 1;
+    }
+}
+
+static size_t emit(Pattern *re, int op, size_t a, size_t b)
+{
+    PatternInst *grown;
+
+    if (re->codeLen >= MAX_CODE)
+        return REPEAT_INF;
+
+    if (re->codeLen == 0 || (re->codeLen >= 64 && (re->codeLen & (re->codeLen - 1)) == 0))
+    {
+        if ((grown = realloc(re->code, (re->codeLen > 0 ? re->codeLen * 2 : 64) * sizeof(PatternInst))) == NULL)
+            return REPEAT_INF;
+        re->code = grown;
+    }
+
+    re->code[re->codeLen].op = op;
+    re->code[re->codeLen].a = a;
+    re->code[re->codeLen].b = b;
+
+    return re->codeLen++;
+}
+
+static int generate(Pattern *re, const Parser *ps, size_t n)
+{
+    const Node *node = &ps->nodes[n];
+    size_t i, split, jump, first;
+
+    switch (node->type)
+    {
+        case NODE_SET:
+            return emit(re, OP_SET, node->left, 0) != REPEAT_INF;
+
+        case NODE_EMPTY:
+            return 1;
+
+        case NODE_BOL:
+            return emit(re, OP_BOL, 0, 0) != REPEAT_INF;
+
+        case NODE_EOL:
+            return emit(re, OP_EOL, 0, 0) != REPEAT_INF;
+
+        case NODE_CAT:
+            return generate(re, ps, node->left) && generate(re, ps, node->right);
+
+        case NODE_GROUP:
+            return emit(re, OP_SAVE, 2 * node->min, 0) != REPEAT_INF && generate(re, ps, node->left) &&
+                emit(re, OP_SAVE, 2 * node->min + 1, 0) != REPEAT_INF;
+
+        case NODE_ALT:
+            /* The left alternative is preferred */
+            if ((split = emit(re, OP_SPLIT, 0, 0)) == REPEAT_INF)
+                return 0;
+            re->code[split].a = re->codeLen;
+            if (!generate(re, ps, node->left) || (jump = emit(re, OP_JMP, 0, 0)) == REPEAT_INF)
+                return 0;
+            re->code[split].b = re->codeLen;
+            if (!generate(re, ps, node->right))
+                return 0;
+            re->code[jump].a = re->codeLen;
+            return 1;
+
+        default:
+            /* The mandatory occurrences are repeated, then the optional ones are tried greedily */
+            for (i = 0; i < node->min; i++)
+            {
+                if (!generate(re, ps, node->left))
+                    return 0;
+            }
+
+            if (node->max == REPEAT_INF)
+            {
+                if ((split = emit(re, OP_SPLIT, 0, 0)) == REPEAT_INF)
+                    return 0;
+                re->code[split].a = re->codeLen;
+                if (!generate(re, ps, node->left) || emit(re, OP_JMP, split, 0) == REPEAT_INF)
+                    return 0;
+                re->code[split].b = re->codeLen;
+                return 1;
+            }
+
+            /* Each optional occurrence skips all the following ones when it's not there */
+            first = re->codeLen;
+            for (i = node->min; i < node->max; i++)
+            {
+                if (emit(re, OP_SPLIT, 0, 0) == REPEAT_INF)
+                    return 0;
+                re->code[re->codeLen - 1].a = re->codeLen;
+                if (!generate(re, ps, node->left))
+                    return 0;
+            }
+            for (i = first; i < re->codeLen; i++)
+            {
+                if (re->code[i].op == OP_SPLIT && re->code[i].b == 0)
+                    re->code[i].b = re->codeLen;
+            }
+            return 1;
+    }
+}
+
+/* Follow the instructions which don't consume anything, collecting those which do (along with the matches and the ends) */
+static void closure(const Pattern *re, uint32_t *states, size_t *stack, size_t pc, int bol, int eol, int *matched)
+{
+    size_t top = 0;
+
+    stack[top++] = pc;
+    while (top > 0)
+    {
+        pc = stack[--top];
+
+        while (!(states[pc >> 5] & ((uint32_t)1 << (pc & 31))))
+        {
+            const PatternInst *inst = &re->code[pc];
+
+            states[pc >> 5] |= (uint32_t)1 << (pc & 31);
+
+            if (inst->op == OP_JMP)
+                pc = inst->a;
+            else if (inst->op == OP_SPLIT)
+            {
+                stack[top++] = inst->b;
+                pc = inst->a;
+            }
+            else if (inst->op == OP_SAVE || (inst->op == OP_BOL && bol) || (inst->op == OP_EOL && eol))
+                pc++;
+            else
+            {
+                if (inst->op == OP_MATCH && matched != NULL)
+                    *matched = 1;
+                break;
+            }
+        }
+    }
+}
+
+static void build_classes(Pattern *re)
+{
+    uint16_t map[512];
+    size_t s, c, count;
+
+    /* Refine the classes of characters by every set, the characters sharing all their sets sharing a class */
+    memset(re->classes, 0, sizeof(re->classes));
+    re->classCount = 1;
+    for (s = 0; s < re->setCount; s++)
+    {
+        for (c = 0; c < 2 * re->classCount; c++)
+            map[c] = 0xffff;
+
+        count = 0;
+        for (c = 0; c < 256; c++)
+        {
+            const size_t key = re->classes[c] * 2 + (HAS(re->sets[s], c) ? 1 : 0);
+
+            if (map[key] == 0xffff)
+                map[key] = (uint16_t)count++;
+            re->classes[c] = map[key];
+        }
+        re->classCount = count;
+    }
+}
+
+static void free_automaton(Pattern *re)
+{
+    free(re->next);
+    free(re->accept);
+    re->next = NULL;
+    re->accept = NULL;
+    re->stateCount = 0;
+}
+
+static uint32_t hash_state(const uint32_t *state, size_t words)
+{
+    uint32_t h = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < words; i++)
+        h = (h ^ state[i]) * 16777619u;
+
+    return h;
+}
+
+/* Find a state of the automaton by its instructions, adding it if it's new */
+static long find_state(Pattern *re, uint32_t *states, size_t words, long *table, size_t tableSize, const uint32_t *state, size_t *stack, int matched)
+{
+    size_t h = hash_state(state, words) & (tableSize - 1);
+    unsigned char *accept;
+    size_t pc;
+
+    while (table[h] >= 0)
+    {
+        if (memcmp(&states[(size_t)table[h] * words], state, words * sizeof(uint32_t)) == 0)
+            return table[h];
+        h = (h + 1) & (tableSize - 1);
+    }
+
+    if (re->stateCount >= MAX_STATES)
+        return -1;
+
+    memcpy(&states[re->stateCount * words], state, words * sizeof(uint32_t));
+    accept = &re->accept[re->stateCount];
+    *accept = matched ? 1 : 0;
+
+    /* A state may also match once the string ends */
+    for (pc = 0; pc < re->codeLen && !*accept; pc++)
+    {
+        if ((state[pc >> 5] & ((uint32_t)1 << (pc & 31))) && re->code[pc].op == OP_EOL)
+        {
+            uint32_t *ends = &states[MAX_STATES * words];
+            int ended = 0;
+
+            memset(ends, 0, words * sizeof(uint32_t));
+            closure(re, ends, stack, pc, 0, 1, &ended);
+            if (ended)
+                *accept = 2;
+        }
+    }
+
+    table[h] = (long)re->stateCount;
+
+    return (long)re->stateCount++;
+}
+
+static void build_automaton(Pattern *re)
+{
+    const size_t words = (re->codeLen + 31) / 32, tableSize = MAX_STATES * 2;
+    unsigned char rep[256];
+    uint32_t *states, *state;
+    size_t *stack;
+    long *table, found;
+    size_t s, k, pc, c;
+    int matched;
+
+    if (re->codeLen > MAX_CODE_DFA)
+        return;
+
+    build_classes(re);
+    for (c = 256; c-- > 0;)
+        rep[re->classes[c]] = (unsigned char)c;
+
+    /* The sets of instructions of the states, followed by room for the ends of a state and the one being built */
+    states = malloc((MAX_STATES + 2) * words * sizeof(uint32_t));
+    stack = malloc((re->codeLen + 1) * sizeof(size_t));
+    table = malloc(tableSize * sizeof(long));
+    re->next = malloc(MAX_STATES * re->classCount * sizeof(uint32_t));
+    re->accept = malloc(MAX_STATES);
+    if (states == NULL || stack == NULL || table == NULL || re->next == NULL || re->accept == NULL)
+    {
+        free(states);
+        free(stack);
+        free(table);
+        free_automaton(re);
+        return;
+    }
+    state = &states[(MAX_STATES + 1) * words];
+    for (s = 0; s < tableSize; s++)
+        table[s] = -1;
+
+    /* The matches may start anywhere, the start of the string being the only one where ^ holds */
+    memset(state, 0, words * sizeof(uint32_t));
+    matched = 0;
+    closure(re, state, stack, 0, 1, 0, &matched);
+    find_state(re, states, words, table, tableSize, state, stack, matched);
+
+    for (s = 0; s < re->stateCount; s++)
+    {
+        for (k = 0; k < re->classCount; k++)
+        {
+            /* A state which matched stays there, the string is tried as soon as it's reached */
+            if (re->accept[s] & 1)
+            {
+                re->next[s * re->classCount + k] = (uint32_t)s;
+                continue;
+            }
+
+            memset(state, 0, words * sizeof(uint32_t));
+            matched = 0;
+            for (pc = 0; pc < re->codeLen; pc++)
+            {
+                if ((states[s * words + (pc >> 5)] & ((uint32_t)1 << (pc & 31))) && re->code[pc].op == OP_SET &&
+                    HAS(re->sets[re->code[pc].a], rep[k]))
+                    closure(re, state, stack, pc + 1, 0, 0, &matched);
+            }
+            closure(re, state, stack, 0, 0, 0, &matched);
+
+            if ((found = find_state(re, states, words, table, tableSize, state, stack, matched)) < 0)
+            {
+                free(states);
+                free(stack);
+                free(table);
+                free_automaton(re);
+                return;
+            }
+            re->next[s * re->classCount + k] = (uint32_t)found;
+        }
+    }
+
+    free(states);
+    free(stack);
+    free(table);
+}
+
+static void pattern_zero(Pattern *re)
+{
+    re->code = NULL;
+    re->codeLen = 0;
+    re->sets = NULL;
+    re->setCount = 0;
+    re->classCount = 0;
+    re->stateCount = 0;
+    re->next = NULL;
+    re->accept = NULL;
+}
+
+int pattern_compile(Pattern *re, const Rule *rules, size_t count, int wildcard)
+{
+    Parser ps;
+    size_t i, root, entry;
+    int ok = 1;
+
+    pattern_zero(re);
+    ps.nodes = NULL;
+    ps.capacity = 0;
+    ps.re = re;
+
+    /* The rules are tried in their order, from a chain of splits */
+    for (i = 0; i + 1 < count && ok; i++)
+        ok = emit(re, OP_SPLIT, 0, re->codeLen + 1) != REPEAT_INF;
+    ok = ok && (count <= 1 || emit(re, OP_JMP, 0, 0) != REPEAT_INF);
+
+    for (i = 0; i < count && ok; i++)
+    {
+        ps.p = rules[i].search;
+        ps.end = rules[i].search + rules[i].searchLen;
+        ps.count = 0;
+        ps.groups = 1;
+        ps.error = NULL;
+
+        root = wildcard ? parse_wildcard(&ps) : parse_alternation(&ps);
+        if (root != REPEAT_INF && ps.p < ps.end)
+            ps.error = "unbalanced )";
+        else if (root != REPEAT_INF && nullable(&ps, root))
+            ps.error = "it matches an empty string";
+
+        if (root == REPEAT_INF || ps.error != NULL)
+        {
+            report_error("Failed to compile the pattern %s: %s!\n", rules[i].search, ps.error != NULL ? ps.error : "out of memory");
+            ok = 0;
+            break;
+        }
+
+        /* Point the chain to the rule */
+        entry = re->codeLen;
+        if (count > 1)
+            re->code[i].a = entry;
+
+        ok = emit(re, OP_SAVE, 0, 0) != REPEAT_INF && generate(re, &ps, root) &&
+            emit(re, OP_SAVE, 1, 0) != REPEAT_INF && emit(re, OP_MATCH, i, 0) != REPEAT_INF;
+        if (!ok)
+            report_error("Failed to compile the pattern %s: too large!\n", rules[i].search);
+    }
+
+    free(ps.nodes);
+
+    if (!ok)
+    {
+        pattern_free(re);
+        return 0;
+    }
+
+    build_automaton(re);
+
+    return 1;
+}
+
+void pattern_free(Pattern *re)
+{
+    free(re->code);
+    free(re->sets);
+    free_automaton(re);
+    pattern_zero(re);
+}
+
+int pattern_candidate(const Pattern *re, const char *str, size_t len)
+{
+    size_t i, s = 0;
+
+    /* Without the automaton, every string is tried */
+    if (re->next == NULL)
+        return 1;
+
+    for (i = 0; i < len && !(re->accept[s] & 1); i++)
+        s = re->next[s * re->classCount + re->classes[(unsigned char)str[i]]];
+
+    /* Either a match was reached, or one ends with the string */
+    return re->accept[s] != 0;
+}
+
+int pattern_vm_init(PatternVm *vm, const Pattern *re)
+{
+    const size_t slots = 2 * PATTERN_GROUPS;
+
+    vm->re = re;
+    vm->pcs[0] = malloc(re->codeLen * sizeof(size_t));
+    vm->pcs[1] = malloc(re->codeLen * sizeof(size_t));
+    vm->caps[0] = malloc(re->codeLen * slots * sizeof(size_t));
+    vm->caps[1] = malloc(re->codeLen * slots * sizeof(size_t));
+    vm->marks = calloc(re->codeLen, sizeof(unsigned long));
+    vm->stack = malloc((re->codeLen + 1) * 3 * sizeof(size_t));
+    vm->temp = malloc(slots * sizeof(size_t));
+    vm->generation = 0;
+
+    if (vm->pcs[0] == NULL || vm->pcs[1] == NULL || vm->caps[0] == NULL || vm->caps[1] == NULL ||
+        vm->marks == NULL || vm->stack == NULL || vm->temp == NULL)
+    {
+        pattern_vm_free(vm);
+        return 0;
+    }
+
+    return 1;
+}
+
+void pattern_vm_free(PatternVm *vm)
+{
+    free(vm->pcs[0]);
+    free(vm->pcs[1]);
+    free(vm->caps[0]);
+    free(vm->caps[1]);
+    free(vm->marks);
+    free(vm->stack);
+    free(vm->temp);
+    vm->pcs[0] = vm->pcs[1] = NULL;
+    vm->caps[0] = vm->caps[1] = NULL;
+    vm->marks = NULL;
+    vm->stack = NULL;
+    vm->temp = NULL;
+}
+
+/* Add a thread to a list, following the instructions which don't consume anything in their order of priority */
+static void add_thread(PatternVm *vm, int l, size_t pc, size_t *caps, size_t pos, size_t len)
+{
+    const Pattern *re = vm->re;
+    const size_t slots = 2 * PATTERN_GROUPS;
+    size_t *stack = vm->stack;
+    size_t top = 0;
+
+    /* An entry either goes on at an instruction, or restores a slot once the instructions after its save are done */
+    stack[top++] = 0;
+    stack[top++] = pc;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const size_t value = stack[--top];
+        const size_t arg = stack[--top];
+
+        if (stack[--top] == 1)
+        {
+            caps[arg] = value;
+            continue;
+        }
+
+        pc = arg;
+        while (vm->marks[pc] != vm->generation)
+        {
+            const PatternInst *inst = &re->code[pc];
+
+            vm->marks[pc] = vm->generation;
+
+            if (inst->op == OP_JMP)
+                pc = inst->a;
+            else if (inst->op == OP_SPLIT)
+            {
+                stack[top++] = 0;
+                stack[top++] = inst->b;
+                stack[top++] = 0;
+                pc = inst->a;
+            }
+            else if (inst->op == OP_SAVE)
+            {
+                stack[top++] = 1;
+                stack[top++] = inst->a;
+                stack[top++] = caps[inst->a];
+                caps[inst->a] = pos;
+                pc++;
+            }
+            else if ((inst->op == OP_BOL && pos == 0) || (inst->op == OP_EOL && pos == len))
+                pc++;
+            else
+            {
+                if (inst->op == OP_SET || inst->op == OP_MATCH)
+                {
+                    vm->pcs[l][vm->counts[l]] = pc;
+                    memcpy(&vm->caps[l][vm->counts[l] * slots], caps, slots * sizeof(size_t));
+                    vm->counts[l]++;
+                }
+                break;
+            }
+        }
+    }
+}
+
+int pattern_find(PatternVm *vm, const char *str, size_t len, size_t from, int whole, PatternMatch *m)
+{
+    const Pattern *re = vm->re;
+    const size_t slots = 2 * PATTERN_GROUPS;
+    size_t pos, t, i;
+    int l = 0, matched = 0;
+
+    vm->counts[0] = 0;
+    vm->generation++;
+
+    /* Simulate all the threads at once, the leftmost match winning and then the one of the highest priority */
+    for (pos = from; pos <= len; pos++)
+    {
+        if (!matched && (!whole || pos == from))
+        {
+            for (i = 0; i < slots; i++)
+                vm->temp[i] = PATTERN_UNSET;
+            add_thread(vm, l, 0, vm->temp, pos, len);
+        }
+
+        if (vm->counts[l] == 0)
+            break;
+
+        vm->counts[1 - l] = 0;
+        vm->generation++;
+
+        for (t = 0; t < vm->counts[l]; t++)
+        {
+            const PatternInst *inst = &re->code[vm->pcs[l][t]];
+            size_t *caps = &vm->caps[l][t * slots];
+
+            if (inst->op == OP_SET)
+            {
+                if (pos < len && HAS(re->sets[inst->a], str[pos]))
+                    add_thread(vm, 1 - l, vm->pcs[l][t] + 1, caps, pos + 1, len);
+            }
+            else if (!whole || pos == len)
+            {
+                /* The threads of a lower priority are dropped */
+                m->rule = inst->a;
+                memcpy(m->groups, caps, slots * sizeof(size_t));
+                matched = 1;
+                break;
+            }
+        }
+
+        l = 1 - l;
+    }
+
+    return matched;
+}
+
+size_t pattern_expand(const Rule *rule, const PatternMatch *m, const char *str, char *out)
+{
+    size_t i, j = 0, g;
+
+    /* \0 to \9 stand for the groups (an unmatched group being empty), \\ for a backslash */
+    for (i = 0; i < rule->replaceLen; i++)
+    {
+        const char c = rule->replace[i];
+
+        if (c == '\\' && i + 1 < rule->replaceLen && rule->replace[i + 1] >= '0' && rule->replace[i + 1] <= '9')
+        {
+            g = (size_t)(rule->replace[++i] - '0');
+            if (m->groups[2 * g] != PATTERN_UNSET && m->groups[2 * g + 1] != PATTERN_UNSET)
+            {
+                if (out != NULL)
+                    memcpy(&out[j], &str[m->groups[2 * g]], m->groups[2 * g + 1] - m->groups[2 * g]);
+                j += m->groups[2 * g + 1] - m->groups[2 * g];
+            }
+            continue;
+        }
+
+        if (c == '\\' && i + 1 < rule->replaceLen && rule->replace[i + 1] == '\\')
+            i++;
+
+        if (out != NULL)
+            out[j] = c;
+        j++;
+    }
+
+    return j;
+}
@@ -0,0 +1,74 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Patterns (regular expressions or wildcards) matched within the strings, without backtracking.
+ */
+
+#ifndef PATTERN_H_INCLUDED
+#define PATTERN_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+#include "rules.h"
+
+/* The whole match, then up to 9 groups */
+#define PATTERN_GROUPS 10
+#define PATTERN_UNSET ((size_t)-1)
+
+/* An instruction of the program simulated over the strings */
+typedef struct PatternInst
+{
+    int op;
+    size_t a;
+    size_t b;
+} PatternInst;
+
+/* The patterns of all the rules, as a single program tried in their order */
+typedef struct Pattern
+{
+    PatternInst *code;
+    size_t codeLen;
+    unsigned char (*sets)[32];
+    size_t setCount;
+
+    /* Deterministic automaton telling which strings contain a match (none if it would be too large) */
+    uint16_t classes[256];
+    size_t classCount;
+    size_t stateCount;
+    uint32_t *next;
+    unsigned char *accept;
+} Pattern;
+
+/* The leftmost match in a string, with its groups */
+typedef struct PatternMatch
+{
+    size_t rule;
+    size_t groups[2 * PATTERN_GROUPS];
+} PatternMatch;
+
+/* The threads of the simulation, one per scanning thread */
+typedef struct PatternVm
+{
+    const Pattern *re;
+    size_t *pcs[2];
+    size_t *caps[2];
+    size_t counts[2];
+    unsigned long *marks;
+    unsigned long generation;
+    size_t *stack;
+    size_t *temp;
+} PatternVm;
+
+int pattern_compile(Pattern *re, const Rule *rules, size_t count, int wildcard);
+void pattern_free(Pattern *re);
+
+int pattern_candidate(const Pattern *re, const char *str, size_t len);
+
+int pattern_vm_init(PatternVm *vm, const Pattern *re);
+void pattern_vm_free(PatternVm *vm);
+int pattern_find(PatternVm *vm, const char *str, size_t len, size_t from, int whole, PatternMatch *m);
+
+size_t pattern_expand(const Rule *rule, const PatternMatch *m, const char *str, char *out);
+
+#endif
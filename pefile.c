@@ -10,307 +10,320 @@
 #include <string.h>
 #include <errno.h>
 #include "pefile.h"
+#include "fileio.h"
+#include "process.h"
+#include "report.h"
 
-#define DEFAULT_SECTION ".rdata"
 #define PE_SIGNATURE "\x50\x45\x00\x00"
+#define PE32PLUS_MAGIC 0x20b
 
-static int advance_and_read(FILE *f, void *ptr, size_t size, long int offset)
+#define IMAGE_FILE_RELOCS_STRIPPED 0x0001
+#define IMAGE_FILE_MACHINE_AMD64 0x8664
+#define IMAGE_DIRECTORY_ENTRY_BASERELOC 5
+#define IMAGE_REL_BASED_HIGHLOW 3
+#define IMAGE_REL_BASED_DIR64 10
+
+#define IMAGE_SCN_CNT_CODE 0x00000020
+#define IMAGE_SCN_CNT_INITIALIZED_DATA 0x00000040
+#define IMAGE_SCN_CNT_UNINITIALIZED_DATA 0x00000080
+#define IMAGE_SCN_MEM_DISCARDABLE 0x02000000
+#define IMAGE_SCN_MEM_EXECUTE 0x20000000
+
+/* Decode the little-endian fields of the headers read in memory */
+
+static uint16_t get_16(const unsigned char *p)
 {
-    if (fseek(f, offset, SEEK_CUR) != 0)
-        return 0;
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
 
-    if (fread(ptr, size, 1, f) != 1)
-        return 0;
+static uint32_t get_32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
 
-    return 1;
+static uint64_t get_64(const unsigned char *p)
+{
+    return (uint64_t)get_32(p) | ((uint64_t)get_32(&p[4]) << 32);
+}
+
+static uint64_t get_image_base(const unsigned char *optional, uint16_t optionalHeaderSize)
+{
+    /* The preferred address of the image follows the sizes and entry point, wider with PE32+ */
+    if (optionalHeaderSize >= 32 && get_16(optional) == PE32PLUS_MAGIC)
+        return get_64(&optional[24]);
+    if (optionalHeaderSize >= 32)
+        return get_32(&optional[28]);
+    return 0;
 }
 
-static int write_input_to_output_until(FILE *in, FILE *out, long offset)
+static int pe_read_sections(Source *in, SectionTable *table, Arena *arena)
 {
-    char buffer[1024];
-    long i = 0, l;
+    unsigned char header[24], optional[32];
+    unsigned char *entries, *entry;
+    uint64_t imageBase;
+    uint32_t headerLocation;
+    uint16_t sectionNums, optionalHeaderSize, i;
 
-    /* Write by chunks of 1024, until the offset is near */
-    while (i + 1024 < offset)
+    /* Read the offset of the PE header (offset 0x3C) */
+    if (source_read(in, 0x3c, header, 4) != 4)
     {
-        if (fread(buffer, sizeof(buffer), 1, in) != 1)
-        {
-            fprintf(stderr, "Failed to read from the input file: %s!\n", strerror(errno));
-            return 0;
-        }
-        if (fwrite(buffer, sizeof(buffer), 1, out) != 1)
-        {
-            fprintf(stderr, "Failed to write to the output file: %s!\n", strerror(errno));
-            return 0;
-        }
-        i += 1024;
+        report_error("Failed to read executable header: %s!\n", strerror(errno));
+        return 5;
     }
+    headerLocation = get_32(header);
 
-    /* Compute the remaining length */
-    l = offset - i;
-
-    if (fread(buffer, l, 1, in) != 1)
+    /* Read the signature and the file header of the PE header at once */
+    if (source_read(in, (long)headerLocation, header, sizeof(header)) != sizeof(header))
     {
-        fprintf(stderr, "Failed to read from the input file: %s!\n", strerror(errno));
-        return 0;
+        report_error("Failed to read executable header: %s!\n", strerror(errno));
+        return 5;
     }
-    if (fwrite(buffer, l, 1, out) != 1)
+
+    /* Check the signature of the PE header */
+    if (memcmp(header, PE_SIGNATURE, sizeof(PE_SIGNATURE)-1) != 0)
     {
-        fprintf(stderr, "Failed to write to the output file: %s!\n", strerror(errno));
-        return 0;
+        report_error("Bad PE header signature: %2X%2X%2X%2X!\n", header[0], header[1], header[2], header[3]);
+        return 4;
     }
 
-    return 1;
-}
-
-static int write_input_to_output_end(FILE *in, FILE *out)
-{
-    char buffer[1024];
-    long i, l, end;
+    /* Get the number of sections and the size of the optional header */
+    sectionNums = get_16(&header[6]);
+    optionalHeaderSize = get_16(&header[20]);
 
-    /* Get the end position of the file */
-    i = ftell(in);
-    fseek(in, 0, SEEK_END);
-    end = ftell(in);
-    fseek(in, i, SEEK_SET);
+    /* The sections are loaded relatively to the image base */
+    memset(optional, 0, sizeof(optional));
+    source_read(in, (long)headerLocation + sizeof(header), optional, sizeof(optional));
+    imageBase = get_image_base(optional, optionalHeaderSize);
 
-    /* Write by chunks of 1024, until the end */
-    while (i + 1024 < end)
+    /* Read the whole sections header, past the optional header, at once (kept in the arena, until the file is done) */
+    if ((entries = (unsigned char*)source_read_at(in, (long)headerLocation + sizeof(header) + optionalHeaderSize, (size_t)sectionNums * 40, arena)) == NULL)
     {
-        if (fread(buffer, sizeof(buffer), 1, in) != 1)
-        {
-            fprintf(stderr, "Failed to read from the input file: %s!\n", strerror(errno));
-            return 0;
-        }
-        if (fwrite(buffer, sizeof(buffer), 1, out) != 1)
-        {
-            fprintf(stderr, "Failed to write to the output file: %s!\n", strerror(errno));
-            return 0;
-        }
-        i += 1024;
+        report_error("Failed to go to the section headers table: %s!\n", strerror(errno));
+        return 6;
     }
 
-    /* Compute the remaining length */
-    l = end - i;
-
-    if (fread(buffer, l, 1, in) != 1)
+    /* The names are stored in the entries, possibly without termination */
+    table->names = arena_alloc(arena, (size_t)sectionNums * 9 + 1);
+    table->sections = arena_alloc(arena, (size_t)sectionNums * sizeof(Section) + 1);
+    if (table->names == NULL || table->sections == NULL)
     {
-        fprintf(stderr, "Failed to read from the input file: %s!\n", strerror(errno));
-        return 0;
+        report_error("Failed to allocate memory for the sections: %s!\n", strerror(errno));
+        return 7;
     }
-    if (fwrite(buffer, l, 1, out) != 1)
+
+    /* Decode the entries */
+    for (i = 0; i < sectionNums; i++)
     {
-        fprintf(stderr, "Failed to write to the output file: %s!\n", strerror(errno));
-        return 0;
+        Section *s = &table->sections[i];
+        char *name = &table->names[i * 9];
+
+        entry = &entries[i * 40];
+        memcpy(name, entry, 8);
+        name[8] = 0;
+
+        s->name = name;
+        s->offset = (long)get_32(&entry[20]);
+        s->address = imageBase + get_32(&entry[12]);
+        s->type = 0;
+        s->flags = get_32(&entry[36]);
+
+        /* The raw data is padded up to the file alignment, past what's loaded (unless the size loaded is left out) */
+        s->size = get_32(&entry[16]);
+        s->memSize = get_32(&entry[8]) != 0 ? get_32(&entry[8]) : s->size;
+        if (s->memSize < s->size)
+            s->size = (size_t)s->memSize;
+
+        /* The uninitialized data has no bytes in the file */
+        if (s->offset == 0 || (s->flags & (IMAGE_SCN_CNT_UNINITIALIZED_DATA | IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_CNT_CODE)) == IMAGE_SCN_CNT_UNINITIALIZED_DATA)
+            s->size = 0;
     }
+    table->count = sectionNums;
 
-    return 1;
+    /* The names are limited to 8 characters */
+    table->nameMax = 8;
+
+    return 0;
 }
 
-static int pe_find_strings_section(FILE *in, const char *section, uint32_t *sectionStringsAddress, uint32_t *sectionStringsLen)
+int pe_is_strings(const Section *s)
 {
-    uint32_t headerLocation;
-    uint16_t sectionNums, optionalHeaderSize, i;
-    char signature[4], sectionName[8];
+    /* Initialized data, neither executable nor discarded once loaded */
+    return (s->flags & IMAGE_SCN_CNT_INITIALIZED_DATA) &&
+        !(s->flags & (IMAGE_SCN_MEM_EXECUTE | IMAGE_SCN_MEM_DISCARDABLE));
+}
 
-    *sectionStringsAddress = 0;
-    *sectionStringsLen = 0;
+static int read_slot(FILE *in, const SectionTable *table, uint64_t address, size_t len, long *offset, uint64_t *value)
+{
+    const Section *s = sections_at(table, address, len);
+    unsigned char slot[8];
 
-    /* Skip to the PE header (offset 0x3C) */
-    if (fseek(in, 0x3c, SEEK_SET) != 0)
-    {
-        fprintf(stderr, "Failed to read executable header: %s!\n", strerror(errno));
-        return 5;
-    }
+    /* Find the location of an address of the image in the file */
+    if (s == NULL)
+        return 0;
 
-    /* Read the offset of the PE header */
-    if (fread(&headerLocation, sizeof(uint32_t), 1, in) != 1)
-    {
-        fprintf(stderr, "Failed to read executable header: %s!\n", strerror(errno));
-        return 5;
-    }
+    *offset = s->offset + (long)(address - s->address);
+    if (fseek(in, *offset, SEEK_SET) != 0 || fread(slot, len, 1, in) != 1)
+        return 0;
 
-    /* Goto the PE header */
-    if (fseek(in, headerLocation, SEEK_SET) != 0)
-    {
-        fprintf(stderr, "Failed to read executable header: %s!\n", strerror(errno));
-        return 5;
-    }
+    *value = len == 8 ? get_64(slot) : get_32(slot);
 
-    /* Read the signature of the PE header */
-    if (fread(signature, sizeof(char), 4, in) != 4)
-    {
-        fprintf(stderr, "Failed to read executable header: %s!\n", strerror(errno));
-        return 5;
-    }
+    return 1;
+}
 
-    /* Check the signature of the PE header */
-    if (strncmp(signature, PE_SIGNATURE, sizeof(PE_SIGNATURE)-1) != 0)
+static int pe_find_refs(FILE *in, const SectionTable *table, RefList *refs)
+{
+    unsigned char header[24], optional[160];
+    unsigned char *data;
+    uint64_t imageBase, value;
+    uint32_t headerLocation, relocAddress, relocLen, page, blockLen, j;
+    size_t i, len;
+    const Section *s;
+    long slot;
+    int ok = 1, type;
+
+    if (fseek(in, 0x3c, SEEK_SET) != 0 || fread(header, 4, 1, in) != 1 ||
+        fseek(in, (long)(headerLocation = get_32(header)), SEEK_SET) != 0 || fread(header, sizeof(header), 1, in) != 1)
     {
-        fprintf(stderr, "Bad PE header signature: %2X%2X%2X%2X!\n", signature[0], signature[1], signature[2], signature[3]);
-        return 4;
+        report_error("Failed to read executable header: %s!\n", strerror(errno));
+        return 0;
     }
 
-    /* Read the number of sections */
-    if (!advance_and_read(in, &sectionNums, sizeof(uint16_t), 2))
+    /* The x86-64 code refers to the data relatively to itself, the pointers are listed by the base relocations */
+    memset(optional, 0, sizeof(optional));
+    if (get_16(&header[4]) != IMAGE_FILE_MACHINE_AMD64 || (get_16(&header[22]) & IMAGE_FILE_RELOCS_STRIPPED) ||
+        get_16(&header[20]) < sizeof(optional) || fread(optional, sizeof(optional), 1, in) != 1 ||
+        get_16(optional) != PE32PLUS_MAGIC || get_32(&optional[108]) <= IMAGE_DIRECTORY_ENTRY_BASERELOC)
     {
-        fprintf(stderr, "Failed to read executable header: %s!\n", strerror(errno));
-        return 5;
+        report_error("Failed to find the references to the strings: only the relocatable x86-64 executables are supported!\n");
+        return 0;
     }
 
-    /* Read the size of the optional header */
-    if (!advance_and_read(in, &optionalHeaderSize, sizeof(uint16_t), 12))
+    imageBase = get_64(&optional[24]);
+    relocAddress = get_32(&optional[112 + IMAGE_DIRECTORY_ENTRY_BASERELOC * 8]);
+    relocLen = get_32(&optional[116 + IMAGE_DIRECTORY_ENTRY_BASERELOC * 8]);
+
+    /* Without the base relocations, the pointers can't be told apart from the rest of the data */
+    if (relocLen == 0)
     {
-        fprintf(stderr, "Failed to read executable header: %s!\n", strerror(errno));
-        return 5;
+        report_error("Failed to find the references to the strings: the executable has no base relocations!\n");
+        return 0;
     }
 
-    /* Move past the optional header to reach the sections header */
-    if (fseek(in, optionalHeaderSize + 2, SEEK_CUR) != 0)
+    if ((s = sections_at(table, imageBase + relocAddress, relocLen)) == NULL ||
+        (data = (unsigned char*)file_read_at(in, s->offset + (long)(imageBase + relocAddress - s->address), relocLen)) == NULL)
     {
-        fprintf(stderr, "Failed to go to the section headers table: %s!\n", strerror(errno));
-        return 6;
+        report_error("Failed to read the base relocations: %s!\n", strerror(errno));
+        return 0;
     }
 
-    /* Iterate through the list of sections */
-    for (i = 0; i < sectionNums; i++)
+    /* Each block lists the pointers of a page of the image */
+    for (i = 0; i + 8 <= relocLen && ok; i += blockLen)
     {
-        /* Read the section name */
-        if (fread(sectionName, sizeof(char), 8, in) != 8)
-            goto NEXT;
+        page = get_32(&data[i]);
+        if ((blockLen = get_32(&data[i + 4])) < 8 || i + blockLen > relocLen)
+            break;
 
-        /* Check the name of the section against the desired section name */
-        if (strncmp(section, sectionName, 8) == 0)
+        for (j = 8; j + 2 <= blockLen && ok; j += 2)
         {
-            /* If match, retrieve its pointer and size */
-            if (!advance_and_read(in, sectionStringsLen, sizeof(uint32_t), 8))
-            {
-                fprintf(stderr, "Failed to iterate over the list of sections: %s!\n", strerror(errno));
-                return 8;
-            }
-
-            if (fread(sectionStringsAddress, sizeof(uint32_t), 1, in) != 1)
-            {
-                fprintf(stderr, "Failed to iterate over the list of sections: %s!\n", strerror(errno));
-                return 8;
-            }
+            type = get_16(&data[i + j]) >> 12;
+            len = type == IMAGE_REL_BASED_DIR64 ? 8 : 4;
 
-            break;
+            if ((type == IMAGE_REL_BASED_DIR64 || type == IMAGE_REL_BASED_HIGHLOW) &&
+                read_slot(in, table, imageBase + page + (get_16(&data[i + j]) & 0xfff), len, &slot, &value))
+                ok = refs_push(refs, slot, len == 8 ? REF_ABS64 : REF_ABS32, 0, 0, value);
         }
+    }
 
-      NEXT:
+    free(data);
 
-        /* Advance to the next entry */
-        if (fseek(in, 32, SEEK_CUR) != 0)
+    /* The code is scanned for its loads of addresses */
+    for (i = 0; i < table->count && ok; i++)
+    {
+        s = &table->sections[i];
+
+        if (s->size == 0 || !(s->flags & (IMAGE_SCN_CNT_CODE | IMAGE_SCN_MEM_EXECUTE)))
+            continue;
+
+        if ((data = (unsigned char*)file_read_at(in, s->offset, s->size)) == NULL)
         {
-            fprintf(stderr, "Failed to iterate over the list of sections: %s!\n", strerror(errno));
-            return 8;
+            report_error("Failed to read the section %s: %s!\n", s->name, strerror(errno));
+            return 0;
         }
-    }
 
-    if (*sectionStringsAddress == 0)
-    {
-        fprintf(stderr, "Failed to find section named %s!\n", section);
-        return 9;
+        ok = refs_scan_code(refs, data, s->size, s->offset, s->address);
+        free(data);
     }
 
-    return 0;
+    if (!ok)
+        report_error("Failed to allocate memory for the references: %s!\n", strerror(errno));
+
+    return ok;
 }
 
-int pe_process(FILE *in, FILE *out, const char *section, const char *search, const char *replace, int exact)
+int pe_process(FILE *in, FILE *out, const RuleSet *rules, const Options *opts, Cache *cache, Journal *journal, Delta *delta, Arena *arena, Stats *stats)
 {
-    uint32_t sectionStringsAddress, sectionStringsLen;
-    char *strtab = NULL;
+    SectionTable table;
+    const SectionTable *sections;
+    Source source;
+    double start = stats_now();
     int ret = 0;
 
-    /* Pick a default section in case none is specified */
-    if (section == NULL)
-        section = DEFAULT_SECTION;
-
-    /* Start by finding the strings section location */
-    if ((ret = pe_find_strings_section(in, section, &sectionStringsAddress, &sectionStringsLen)) != 0)
-        return ret;
-
-    /* Write everything before the strings section to the output (if specified) */
-    if (out != NULL)
+    /* Start by parsing the section table (unless it's known from the index) */
+    sections_init(&table);
+    source_init(&source, in, 0);
+    if ((sections = cache_sections(cache)) == NULL && (ret = pe_read_sections(&source, &table, arena)) == 0)
     {
-        if (fseek(in, 0, SEEK_SET) != 0)
-        {
-            fprintf(stderr, "Failed to write to the output file: %s!\n", strerror(errno));
-            return 14;
-        }
-        if (!write_input_to_output_until(in, out, sectionStringsAddress))
-            return 14;
+        cache_put_sections(cache, &table);
+        sections = &table;
     }
+    stats_phase(stats, PHASE_HEADERS, start);
 
-    /* Goto the location */
-    if (fseek(in, sectionStringsAddress, SEEK_SET) != 0)
-    {
-        fprintf(stderr, "Failed to go to the strings section: %s!\n", strerror(errno));
-        return 10;
-    }
+    if (sections != NULL)
+        ret = process_sections(in, out, sections, PE_DEFAULT_SECTION, pe_is_strings, pe_find_refs, rules, opts, cache, journal, delta, arena, stats);
 
-    /* Allocate memory for the whole strings table */
-    if ((strtab = malloc(sectionStringsLen)) == NULL)
-    {
-        fprintf(stderr, "Failed to allocate memory for strings table: %s!\n", strerror(errno));
-        return 13;
-    }
+    return ret;
+}
 
-    /* Read the whole strings table */
-    if (fread(strtab, sectionStringsLen, 1, in) != 1)
-    {
-        fprintf(stderr, "Failed to read the strings table: %s!\n", strerror(errno));
-        ret = 13; goto RET;
-    }
+int pe_stream(Source *in, FILE *out, const RuleSet *rules, const Options *opts, Arena *arena, Stats *stats)
+{
+    SectionTable table;
+    double start = stats_now();
+    int ret;
 
-    if (replace != NULL)
-    {
-        /* Search for the occurrence of the search in the list of strings */
-        if (exact == 0)
-            ret = search_and_replace(strtab, search, replace, sectionStringsLen);
-        else
-            ret = search_and_replace_exact(strtab, search, replace, sectionStringsLen);
-
-        /* Write the modified strings table into either the output or the input file */
-        if (out != NULL)
-        {
-            if (fwrite(strtab, sectionStringsLen, 1, out) != 1)
-            {
-                fprintf(stderr, "Failed to write to the output file: %s!\n", strerror(errno));
-                return 14;
-            }
-
-            /* Write the rest of the file to the output */
-            if (!write_input_to_output_end(in, out))
-                return 14;
-        }
-        else
-        {
-            /* Return to the strings table location */
-            if (fseek(in, sectionStringsAddress, SEEK_SET) != 0)
-            {
-                fprintf(stderr, "Failed to go to the strings section: %s!\n", strerror(errno));
-                return 10;
-            }
-
-            if (fwrite(strtab, sectionStringsLen, 1, in) != 1)
-            {
-                fprintf(stderr, "Failed to write to the input file: %s!\n", strerror(errno));
-                return 15;
-            }
-        }
-    }
-    else
-    {
-        /* Just lay down the list of strings in the section (with their offset) */
-        print_strings(strtab, sectionStringsAddress, sectionStringsLen);
-    }
+    /* The headers are buffered as they're read, up to the section table */
+    sections_init(&table);
+    ret = pe_read_sections(in, &table, arena);
+    stats_phase(stats, PHASE_HEADERS, start);
+    if (ret == 0)
+        ret = process_stream(in, out, &table, PE_DEFAULT_SECTION, pe_is_strings, rules, opts, arena, stats);
 
-  RET:
+    return ret;
+}
 
-    /* Free the allocated memory */
-    free(strtab);
+int pe_probe(const char *data, size_t len, const RuleSet *rules, const Options *opts, Arena *arena, Stats *stats, unsigned long *count)
+{
+    SectionTable table;
+    Source source;
+    double start = stats_now();
+    int ret;
+
+    /* The headers are parsed from the mapped file, without reading it */
+    sections_init(&table);
+    source_memory(&source, data, len);
+    ret = pe_read_sections(&source, &table, arena);
+    stats_phase(stats, PHASE_HEADERS, start);
+    if (ret == 0)
+        ret = process_probe(data, len, &table, PE_DEFAULT_SECTION, pe_is_strings, rules, opts, arena, stats, count);
 
     return ret;
 }
+
+int pe_read_table(FILE *in, SectionTable *table, Arena *arena)
+{
+    Source source;
+
+    sections_init(table);
+    source_init(&source, in, 0);
+
+    return pe_read_sections(&source, table, arena);
+}
@@ -9,7 +9,17 @@
 #define PEFILE_H_INCLUDED
 
 #include <stdio.h>
+#include "rules.h"
+#include "process.h"
 
-int pe_process(FILE *in, FILE *out, const char *section, const char *search, const char *replace, int exact);
+#define PE_DEFAULT_SECTION ".rdata"
+
+int pe_process(FILE *in, FILE *out, const RuleSet *rules, const Options *opts, Cache *cache, Journal *journal, Delta *delta, Arena *arena, Stats *stats);
+int pe_stream(Source *in, FILE *out, const RuleSet *rules, const Options *opts, Arena *arena, Stats *stats);
+int pe_probe(const char *data, size_t len, const RuleSet *rules, const Options *opts, Arena *arena, Stats *stats, unsigned long *count);
+
+/* The table of the sections and how the strings are found in them, for the library */
+int pe_read_table(FILE *in, SectionTable *table, Arena *arena);
+int pe_is_strings(const Section *s);
 
 #endif
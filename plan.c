@@ -0,0 +1,129 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Changes planned by a dry run, reported instead of being written.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "plan.h"
+
+void plan_init(Plan *plan)
+{
+    plan->changes = NULL;
+    plan->count = 0;
+    plan->capacity = 0;
+}
+
+void plan_free(Plan *plan)
+{
+    size_t i;
+
+    for (i = 0; i < plan->count; i++)
+        free(plan->changes[i].replacement);
+
+    free(plan->changes);
+    plan_init(plan);
+}
+
+static int reserve(Plan *plan, size_t count)
+{
+    size_t capacity = plan->capacity > 0 ? plan->capacity : 16;
+    Change *grown;
+
+    if (plan->count + count <= plan->capacity)
+        return 1;
+
+    while (capacity < plan->count + count)
+        capacity *= 2;
+
+    if ((grown = realloc(plan->changes, capacity * sizeof(Change))) == NULL)
+        return 0;
+
+    plan->changes = grown;
+    plan->capacity = capacity;
+
+    return 1;
+}
+
+int plan_add(Plan *plan, size_t offset, size_t oldLen, const char *replacement, size_t newLen, size_t available)
+{
+    Change *c;
+
+    if (!reserve(plan, 1))
+        return 0;
+
+    c = &plan->changes[plan->count];
+    c->offset = offset;
+    c->oldLen = oldLen;
+    c->newLen = newLen;
+    c->available = available;
+    c->replacement = NULL;
+    c->conflict = -1;
+
+    /* Keep a copy of the replacement, the table isn't modified */
+    if (replacement != NULL)
+    {
+        if ((c->replacement = malloc(newLen + 1)) == NULL)
+            return 0;
+
+        memcpy(c->replacement, replacement, newLen);
+        c->replacement[newLen] = 0;
+    }
+
+    plan->count++;
+
+    return 1;
+}
+
+int plan_append(Plan *plan, Plan *other, size_t offset)
+{
+    size_t i;
+
+    if (!reserve(plan, other->count))
+        return 0;
+
+    /* The other plan gives its changes away, shifted by its location */
+    for (i = 0; i < other->count; i++)
+    {
+        plan->changes[plan->count] = other->changes[i];
+        plan->changes[plan->count].offset += offset;
+        plan->count++;
+    }
+
+    free(other->changes);
+    plan_init(other);
+
+    return 1;
+}
+
+static int compare_changes(const void *a, const void *b)
+{
+    const Change *ca = a, *cb = b;
+
+    return ca->offset < cb->offset ? -1 : (ca->offset > cb->offset ? 1 : 0);
+}
+
+void plan_sort(Plan *plan)
+{
+    qsort(plan->changes, plan->count, sizeof(Change), compare_changes);
+}
+
+const Change *plan_find(const Plan *plan, size_t count, size_t offset)
+{
+    size_t lo = 0, hi = count;
+
+    /* Look up the change of a string among the first ones, ordered by their location */
+    while (lo < hi)
+    {
+        const size_t mid = lo + (hi - lo) / 2;
+
+        if (plan->changes[mid].offset < offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo < count && plan->changes[lo].offset == offset ? &plan->changes[lo] : NULL;
+}
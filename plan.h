@@ -0,0 +1,39 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Changes planned by a dry run, reported instead of being written.
+ */
+
+#ifndef PLAN_H_INCLUDED
+#define PLAN_H_INCLUDED
+
+#include <stddef.h>
+
+/* A string to replace, which doesn't fit if its replacement is longer than the room available */
+typedef struct Change
+{
+    size_t offset;
+    size_t oldLen;
+    size_t newLen;
+    size_t available;
+    char *replacement;
+    long conflict;
+} Change;
+
+typedef struct Plan
+{
+    Change *changes;
+    size_t count;
+    size_t capacity;
+} Plan;
+
+void plan_init(Plan *plan);
+void plan_free(Plan *plan);
+
+int plan_add(Plan *plan, size_t offset, size_t oldLen, const char *replacement, size_t newLen, size_t available);
+int plan_append(Plan *plan, Plan *other, size_t offset);
+void plan_sort(Plan *plan);
+const Change *plan_find(const Plan *plan, size_t count, size_t offset);
+
+#endif
@@ -0,0 +1,572 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Apply the search and replace to the sections selected in an executable.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "process.h"
+#include "common.h"
+#include "parallel.h"
+#include "fileio.h"
+#include "relocate.h"
+#include "merged.h"
+#include "report.h"
+
+static int compare_sections(const void *a, const void *b)
+{
+    const Section *sa = *(const Section *const *)a, *sb = *(const Section *const *)b;
+
+    if (sa->offset != sb->offset)
+        return sa->offset < sb->offset ? -1 : 1;
+    return 0;
+}
+
+int process_select(const SectionTable *table, const char *defaultSection, int (*isStrings)(const Section *), const Options *opts, const Section **selected, size_t *count)
+{
+    size_t i;
+
+    *count = 0;
+
+    /* Pick the sections flagged as containing strings */
+    if (opts->allSections)
+    {
+        for (i = 0; i < table->count; i++)
+        {
+            if (table->sections[i].size > 0 && isStrings(&table->sections[i]))
+                selected[(*count)++] = &table->sections[i];
+        }
+
+        if (*count == 0)
+        {
+            report_error("Failed to find any section containing strings!\n");
+            return 9;
+        }
+    }
+
+    /* Pick the sections by their names (or the default one in case none is specified) */
+    for (i = 0; i < (opts->sectionCount > 0 ? opts->sectionCount : (opts->allSections ? 0 : 1)); i++)
+    {
+        const char *name = opts->sectionCount > 0 ? opts->sections[i] : defaultSection;
+        const Section *s;
+
+        if ((s = sections_find(table, name)) == NULL)
+        {
+            report_error("Failed to find section named %s!\n", name);
+            return 9;
+        }
+
+        /* The uninitialized data isn't read, nothing of it lying in the file */
+        if (s->size == 0 && s->memSize > 0)
+        {
+            report_error("The section %s holds no data in the file!\n", name);
+            return 9;
+        }
+        selected[(*count)++] = s;
+    }
+
+    /* Walk the file sequentially, each section being processed once */
+    qsort(selected, *count, sizeof(const Section*), compare_sections);
+    for (i = 1; i < *count; i++)
+    {
+        if (selected[i] == selected[i - 1])
+        {
+            memmove(&selected[i], &selected[i + 1], (*count - i - 1) * sizeof(const Section*));
+            (*count)--;
+            i--;
+        }
+    }
+
+    return 0;
+}
+
+static int process_locate(FILE *in, const SectionTable *table, uint64_t address, const Section **selected, size_t *count, Arena *arena)
+{
+    const Section *s = sections_at(table, address, 1);
+    unsigned char chunk[256];
+    Section *string;
+    size_t start, len = 0, n, i;
+    int terminated = 0;
+
+    if (s == NULL)
+    {
+        report_error("Failed to find a section holding the address %lX!\n", (unsigned long)address);
+        return 9;
+    }
+
+    /* The string at the address is processed on its own, along with the null bytes up to the next one */
+    start = (size_t)(address - s->address);
+    while (start + len < s->size)
+    {
+        n = s->size - start - len < sizeof(chunk) ? s->size - start - len : sizeof(chunk);
+        if (fseek(in, s->offset + (long)(start + len), SEEK_SET) != 0 || fread(chunk, n, 1, in) != 1)
+        {
+            report_error("Failed to read the strings table: %s!\n", strerror(errno));
+            return 13;
+        }
+
+        for (i = 0; i < n && (chunk[i] == 0 || !terminated); i++)
+            terminated |= chunk[i] == 0;
+        len += i;
+        if (i < n)
+            break;
+    }
+
+    if ((string = arena_alloc(arena, sizeof(Section))) == NULL)
+    {
+        report_error("Failed to allocate memory for the sections: %s!\n", strerror(errno));
+        return 7;
+    }
+
+    *string = *s;
+    string->offset = s->offset + (long)start;
+    string->size = len;
+    string->memSize = len;
+    string->address = address;
+    selected[0] = string;
+    *count = 1;
+
+    return 0;
+}
+
+static int replace_indexed(char *data, const RuleSet *rules, size_t len, Cache *cache, size_t section, const Options *opts, RangeList *dirty, Plan *plan, Arena *arena, Tally *tally)
+{
+    StringIndex index;
+    size_t *lens, i;
+    int ret;
+
+    strindex_init(&index);
+
+    /* With an index, only the strings as long as a search are read (and checked against the table) */
+    if (cache_has_index(cache, section))
+    {
+        if ((lens = arena_alloc(arena, rules->count * sizeof(size_t))) != NULL)
+        {
+            for (i = 0; i < rules->count; i++)
+                lens[i] = rules->rules[i].searchLen;
+
+            if (cache_lookup(cache, section, lens, rules->count, &index))
+            {
+                ret = search_and_replace_indexed(data, rules, len, &index, dirty, plan, tally);
+                strindex_free(&index);
+                return ret;
+            }
+        }
+
+        strindex_free(&index);
+        return parallel_replace(data, rules, len, 1, opts->threads, dirty, plan, arena, tally);
+    }
+
+    /* Otherwise index the whole table once, for the next runs */
+    if (!parallel_index(data, len, opts->threads, &index))
+    {
+        strindex_free(&index);
+        return parallel_replace(data, rules, len, 1, opts->threads, dirty, plan, arena, tally);
+    }
+
+    ret = search_and_replace_indexed(data, rules, len, &index, dirty, plan, tally);
+    cache_put_index(cache, section, &index);
+
+    return ret;
+}
+
+static int process_table(char *data, const Section *s, size_t section, const RuleSet *rules, const Options *opts, Cache *cache, const RefList *refs, RefList *moved, RangeList *dirty, Plan *plan, Listing *listing, Arena *arena, Stats *stats)
+{
+    const int planned = opts->dryRun || refs != NULL;
+    Tally *tally = stats != NULL ? &stats->tally : NULL;
+    size_t c;
+    int r;
+
+    listing->section = s->name;
+
+    /* The strings are only counted when reported, it takes a pass over the table */
+    stats_strings(stats, data, s->size);
+
+    /* Just lay down the list of strings in the section (with their offset) */
+    if (rules == NULL)
+    {
+        parallel_print(listing, data, s->offset, s->size, opts->threads);
+        return 0;
+    }
+
+    /* Search for the occurrence of the search in the list of strings */
+    if (cache != NULL && opts->exact && rules->pattern == NULL && !rules->utf16)
+        r = replace_indexed(data, rules, s->size, cache, section, opts, dirty, planned ? plan : NULL, arena, tally);
+    else
+        r = parallel_replace(data, rules, s->size, opts->exact, opts->threads, dirty, planned ? plan : NULL, arena, tally);
+
+    /* The changes planned are dropped along with a failure */
+    if (r > 2)
+    {
+        plan_free(plan);
+        return r;
+    }
+
+    /* Apply the changes once checked against the merged strings, moving those which can't be written in place
+       (a dry run only modifies its private copy) */
+    if (refs != NULL)
+    {
+        if (!merged_check(data, s, rules, opts->exact, refs, plan, arena))
+        {
+            report_error("Failed to allocate memory for the merged strings: %s!\n", strerror(errno));
+            plan_free(plan);
+            return 7;
+        }
+        if (plan->count > 0)
+            r = relocate_plan(data, s, plan, refs, opts->relocate, moved, dirty, opts->dryRun ? listing : NULL);
+        plan_free(plan);
+        return r;
+    }
+
+    /* Report the changes which would have been made */
+    for (c = 0; c < plan->count; c++)
+    {
+        const Change *change = &plan->changes[c];
+
+        listing_change(listing, s->offset + change->offset, &data[change->offset], change->oldLen,
+            change->newLen <= change->available ? change->replacement : NULL, change->newLen, change->available);
+    }
+    plan_free(plan);
+
+    return r;
+}
+
+int process_sections(FILE *in, FILE *out, const SectionTable *table, const char *defaultSection, int (*isStrings)(const Section *), int (*findRefs)(FILE *, const SectionTable *, RefList *), const RuleSet *rules, const Options *opts, Cache *cache, Journal *journal, Delta *delta, Arena *arena, Stats *stats)
+{
+    const Section **selected;
+    size_t count, i;
+    Mapping strtab;
+    RangeList dirty;
+    RefList refs, moved;
+    Plan plan;
+    Listing listing;
+    double start;
+    int ret, status = 1, mode, referenced, written;
+
+    if ((selected = arena_alloc(arena, (table->count + opts->sectionCount + 1) * sizeof(const Section*))) == NULL)
+    {
+        report_error("Failed to allocate memory for the sections: %s!\n", strerror(errno));
+        return 7;
+    }
+
+    /* A string located by its address is found without going through its section */
+    if (opts->atVaddr)
+        ret = process_locate(in, table, opts->vaddr, selected, &count, arena);
+    else
+        ret = process_select(table, defaultSection, isStrings, opts, selected, &count);
+    if (ret != 0)
+        return ret;
+
+    /* Gather the references to the strings upfront, they're spread all over the executable */
+    refs_init(&refs);
+    refs_init(&moved);
+    referenced = rules != NULL && (opts->relocate || opts->merged);
+    start = stats_now();
+    if (referenced && !findRefs(in, table, &refs))
+    {
+        refs_free(&refs);
+        return 17;
+    }
+    if (referenced && !refs_sort(&refs))
+    {
+        report_error("Failed to allocate memory for the references: %s!\n", strerror(errno));
+        refs_free(&refs);
+        return 7;
+    }
+    stats_phase(stats, PHASE_REFS, start);
+
+    /* A dry run only reads the input (unless the strings are moved, which is rehearsed in memory),
+       and the input is written only once its former bytes are saved into the journal or the patch file */
+    if (rules == NULL || (opts->dryRun && !referenced))
+        mode = MAPPING_READ;
+    else
+        mode = out != NULL || opts->dryRun || journal != NULL || delta != NULL ? MAPPING_PRIVATE : MAPPING_SHARED;
+    written = rules != NULL && out == NULL && mode == MAPPING_PRIVATE && !opts->dryRun;
+
+    /* Clone the input into the output once, the modified strings are written over it */
+    start = stats_now();
+    if (rules != NULL && out != NULL && !file_clone(in, out))
+    {
+        refs_free(&refs);
+        return 14;
+    }
+    if (stats != NULL && rules != NULL && out != NULL && fseek(in, 0, SEEK_END) == 0)
+        stats->written += (unsigned long long)ftell(in);
+    stats_phase(stats, PHASE_WRITE, start);
+
+    listing_init(&listing, stdout, opts->listFormat);
+    listing.utf16 = opts->utf16;
+    plan_init(&plan);
+
+    for (i = 0; i < count && ret == 0; i++)
+    {
+        const Section *s = selected[i];
+        int r;
+
+        ranges_init(&dirty);
+
+        /* Map the whole strings table (so that the input is patched directly if no output is specified) */
+        start = stats_now();
+        if (!mapping_open(&strtab, in, s->offset, s->size, mode))
+        {
+            ret = 13;
+            break;
+        }
+        stats_phase(stats, PHASE_READ, start);
+
+        start = stats_now();
+        r = process_table(strtab.data, s, opts->atVaddr ? 0 : (size_t)(s - table->sections), rules, opts, opts->atVaddr ? NULL : cache, referenced ? &refs : NULL, &moved, &dirty, &plan, &listing, arena, stats);
+        stats_phase(stats, PHASE_MATCH, start);
+
+        start = stats_now();
+        if (rules != NULL)
+        {
+            /* Keep the worst outcome among the sections, a failure leaving the rest as it is */
+            if (r > 2)
+                ret = r;
+            else if (r == 2 || (r == 0 && status == 1))
+                status = r;
+
+            /* Overwrite the modified strings only */
+            if (ret == 0 && out != NULL && !file_write_ranges(out, s->offset, strtab.data, s->size, &dirty))
+            {
+                report_error("Failed to write to the output file: %s!\n", strerror(errno));
+                ret = 14;
+            }
+
+            /* Record the changes along with the former strings, read from the input before it's overwritten */
+            if (ret == 0 && delta != NULL && !delta_add_ranges(delta, in, s->offset, strtab.data, s->size, &dirty))
+            {
+                report_error("Failed to write the patch file: %s!\n", strerror(errno));
+                ret = 14;
+            }
+
+            /* Save the strings about to be overwritten in the input, the journal reaching the disk first */
+            if (ret == 0 && journal != NULL && !(journal_save_ranges(journal, in, s->offset, s->size, &dirty) && journal_sync(journal)))
+            {
+                report_error("Failed to write the journal: %s!\n", strerror(errno));
+                ret = 15;
+            }
+
+            /* Then overwrite them in the input */
+            if (ret == 0 && written && (dirty.whole || dirty.count > 0) && !file_write_ranges(in, s->offset, strtab.data, s->size, &dirty))
+            {
+                report_error("Failed to write to the input file: %s!\n", strerror(errno));
+                ret = 15;
+            }
+        }
+
+        /* Release the strings table, writing it back into the input if it was modified in place */
+        if (stats != NULL)
+        {
+            stats->sections++;
+            stats->loaded += s->size;
+            if (rules != NULL && (out != NULL || mode == MAPPING_SHARED || written))
+                stats->written += dirty.whole ? s->size : ranges_length(&dirty);
+        }
+        if (!mapping_close(&strtab, &dirty) && mode == MAPPING_SHARED)
+            ret = 15;
+        stats_phase(stats, PHASE_WRITE, start);
+
+        ranges_free(&dirty);
+    }
+
+    /* Redirect the references to the moved strings, once the tables are written */
+    start = stats_now();
+    for (i = 0; ret == 0 && !opts->dryRun && i < moved.count; i++)
+    {
+        unsigned char bytes[REF_MAX_SIZE];
+        const size_t len = refs_encode(&moved.refs[i], bytes);
+
+        if (delta != NULL && !delta_add(delta, in, moved.refs[i].offset, (const char*)bytes, len))
+        {
+            report_error("Failed to write the patch file: %s!\n", strerror(errno));
+            ret = 14;
+        }
+        else if (journal != NULL && (!journal_save(journal, in, moved.refs[i].offset, len) || (i + 1 == moved.count && !journal_sync(journal))))
+        {
+            report_error("Failed to write the journal: %s!\n", strerror(errno));
+            ret = 15;
+        }
+    }
+    if (ret == 0 && !opts->dryRun && moved.count > 0 && (fflush(out != NULL ? out : in) != 0 || !refs_write(out != NULL ? out : in, &moved)))
+    {
+        report_error("Failed to write the references: %s!\n", strerror(errno));
+        ret = out != NULL ? 14 : 15;
+    }
+    stats_phase(stats, PHASE_WRITE, start);
+
+    refs_free(&refs);
+    refs_free(&moved);
+
+    if (!listing_free(&listing) && ret == 0)
+    {
+        report_error("Failed to write the strings: %s!\n", strerror(errno));
+        ret = 14;
+    }
+
+    if (ret != 0 || rules == NULL)
+        return ret;
+
+    return status;
+}
+
+int process_probe(const char *data, size_t len, const SectionTable *table, const char *defaultSection, int (*isStrings)(const Section *), const RuleSet *rules, const Options *opts, Arena *arena, Stats *stats, unsigned long *count)
+{
+    const unsigned long limit = opts->probe == PROBE_FIRST ? 1 : 0;
+    unsigned long found;
+    const Section **selected;
+    size_t n, i;
+    double start = stats_now();
+    int ret;
+
+    *count = 0;
+
+    if ((selected = arena_alloc(arena, (table->count + opts->sectionCount + 1) * sizeof(const Section*))) == NULL)
+    {
+        report_error("Failed to allocate memory for the sections: %s!\n", strerror(errno));
+        return 7;
+    }
+
+    if ((ret = process_select(table, defaultSection, isStrings, opts, selected, &n)) != 0)
+        return ret;
+
+    /* The sections are searched right where the file is mapped, stopping at the first match if that's enough */
+    for (i = 0; i < n && (limit == 0 || *count < limit); i++)
+    {
+        const Section *s = selected[i];
+
+        if (s->offset < 0 || (size_t)s->offset > len || len - (size_t)s->offset < s->size)
+        {
+            report_error("Failed to read the strings table: the section exceeds the file!\n");
+            return 13;
+        }
+
+        ret = search_count(&data[s->offset], rules, s->size, opts->exact, limit > 0 ? limit - *count : 0, &found);
+        *count += found;
+
+        if (stats != NULL)
+        {
+            stats->sections++;
+            stats->loaded += s->size;
+        }
+
+        if (ret != 0)
+            return ret;
+    }
+
+    if (stats != NULL)
+        stats->tally.matches += *count;
+    stats_phase(stats, PHASE_MATCH, start);
+
+    return *count > 0 ? 0 : 1;
+}
+
+int process_stream(Source *in, FILE *out, const SectionTable *table, const char *defaultSection, int (*isStrings)(const Section *), const RuleSet *rules, const Options *opts, Arena *arena, Stats *stats)
+{
+    const Section **selected;
+    size_t count, i;
+    RangeList dirty;
+    Plan plan;
+    Listing listing;
+    char *data;
+    long end = 0;
+    double start;
+    int ret, status = 1;
+
+    if ((selected = arena_alloc(arena, (table->count + opts->sectionCount + 1) * sizeof(const Section*))) == NULL)
+    {
+        report_error("Failed to allocate memory for the sections: %s!\n", strerror(errno));
+        return 7;
+    }
+
+    if ((ret = process_select(table, defaultSection, isStrings, opts, selected, &count)) != 0)
+        return ret;
+
+    listing_init(&listing, stdout, opts->listFormat);
+    listing.utf16 = opts->utf16;
+    plan_init(&plan);
+
+    /* The sections are patched in the window of the input as they come, in their order in the file */
+    for (i = 0; i < count && ret == 0; i++)
+    {
+        const Section *s = selected[i];
+        int r;
+
+        /* An empty section doesn't hold any string */
+        if (s->size == 0)
+            continue;
+
+        if (s->offset < end)
+        {
+            report_error("Failed to read the strings table: the section %s overlaps the previous one!\n", s->name);
+            ret = 13;
+            break;
+        }
+
+        start = stats_now();
+        if ((data = source_fill(in, s->offset, s->size)) == NULL)
+        {
+            report_error("Failed to read the strings table: the section exceeds the input!\n");
+            ret = 13;
+            break;
+        }
+        stats_phase(stats, PHASE_READ, start);
+
+        start = stats_now();
+        ranges_init(&dirty);
+        r = process_table(data, s, (size_t)(s - table->sections), rules, opts, NULL, NULL, NULL, &dirty, &plan, &listing, arena, stats);
+        ranges_free(&dirty);
+        stats_phase(stats, PHASE_MATCH, start);
+
+        if (stats != NULL)
+        {
+            stats->sections++;
+            stats->loaded += s->size;
+        }
+
+        /* Keep the worst outcome among the sections, a failure stopping the stream */
+        if (rules != NULL && r > 2)
+        {
+            ret = r;
+            break;
+        }
+        if (rules != NULL && (r == 2 || (r == 0 && status == 1)))
+            status = r;
+
+        /* Pass everything up to the end of the section through, it won't be needed anymore */
+        start = stats_now();
+        end = s->offset + (long)s->size;
+        if (!source_write(in, out, end))
+        {
+            report_error("Failed to write to the output file: %s!\n", strerror(errno));
+            ret = 14;
+        }
+        stats_phase(stats, PHASE_WRITE, start);
+    }
+
+    /* The rest of the input is left as is */
+    start = stats_now();
+    if (ret == 0 && out != NULL && !source_drain(in, out))
+    {
+        report_error("Failed to write to the output file: %s!\n", strerror(errno));
+        ret = 14;
+    }
+    stats_phase(stats, PHASE_WRITE, start);
+    if (stats != NULL && out != NULL && ret == 0)
+        stats->written += (unsigned long long)in->base;
+
+    if (!listing_free(&listing) && ret == 0)
+    {
+        report_error("Failed to write the strings: %s!\n", strerror(errno));
+        ret = 14;
+    }
+
+    if (ret != 0 || rules == NULL)
+        return ret;
+
+    return status;
+}
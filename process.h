@@ -0,0 +1,52 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Apply the search and replace to the sections selected in an executable.
+ */
+
+#ifndef PROCESS_H_INCLUDED
+#define PROCESS_H_INCLUDED
+
+#include <stdio.h>
+#include "rules.h"
+#include "sections.h"
+#include "cache.h"
+#include "fileio.h"
+#include "refs.h"
+#include "arena.h"
+#include "stats.h"
+#include "journal.h"
+#include "delta.h"
+
+#define PROBE_NONE  0   /* The strings are replaced (or listed) */
+#define PROBE_FIRST 1   /* Only tell whether the strings are found */
+#define PROBE_COUNT 2   /* Only count the matches */
+
+/* Options of the processing, shared by all the executable formats */
+typedef struct Options
+{
+    const char *const *sections;
+    size_t sectionCount;
+    int allSections;
+    int exact;
+    unsigned int threads;
+    int listFormat;
+    const char *cacheDir;
+    int dryRun;
+    int relocate;
+    int merged;
+    int probe;
+    int utf16;
+    int journal;
+    int atVaddr;
+    uint64_t vaddr;
+} Options;
+
+int process_select(const SectionTable *table, const char *defaultSection, int (*isStrings)(const Section *), const Options *opts, const Section **selected, size_t *count);
+
+int process_sections(FILE *in, FILE *out, const SectionTable *table, const char *defaultSection, int (*isStrings)(const Section *), int (*findRefs)(FILE *, const SectionTable *, RefList *), const RuleSet *rules, const Options *opts, Cache *cache, Journal *journal, Delta *delta, Arena *arena, Stats *stats);
+int process_probe(const char *data, size_t len, const SectionTable *table, const char *defaultSection, int (*isStrings)(const Section *), const RuleSet *rules, const Options *opts, Arena *arena, Stats *stats, unsigned long *count);
+int process_stream(Source *in, FILE *out, const SectionTable *table, const char *defaultSection, int (*isStrings)(const Section *), const RuleSet *rules, const Options *opts, Arena *arena, Stats *stats);
+
+#endif
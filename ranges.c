@@ -0,0 +1,107 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Lists of modified ranges, kept in order and coalesced as they are recorded.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "ranges.h"
+
+/* Rewriting a few unchanged bytes is cheaper than issuing another write */
+#define COALESCE_GAP 64
+
+void ranges_init(RangeList *list)
+{
+    list->ranges = NULL;
+    list->count = 0;
+    list->capacity = 0;
+    list->whole = 0;
+}
+
+void ranges_free(RangeList *list)
+{
+    free(list->ranges);
+    ranges_init(list);
+}
+
+int ranges_add(RangeList *list, size_t offset, size_t len)
+{
+    size_t i = list->count, lo = 0, j;
+    Range *r;
+
+    if (len == 0)
+        return 1;
+
+    /* The ranges are mostly recorded in ascending order, otherwise (e.g. the moved strings) find the first one starting after */
+    if (i > 0 && list->ranges[i - 1].offset > offset)
+    {
+        while (lo < i)
+        {
+            const size_t mid = lo + (i - lo) / 2;
+
+            if (list->ranges[mid].offset <= offset)
+                lo = mid + 1;
+            else
+                i = mid;
+        }
+    }
+
+    /* Extend the range before when it's close enough, or insert a new one */
+    if (i > 0 && offset <= list->ranges[i - 1].offset + list->ranges[i - 1].len + COALESCE_GAP)
+    {
+        r = &list->ranges[--i];
+        if (offset + len > r->offset + r->len)
+            r->len = offset + len - r->offset;
+    }
+    else
+    {
+        if (list->count >= list->capacity)
+        {
+            const size_t capacity = list->capacity == 0 ? 32 : list->capacity * 2;
+            Range *grown;
+
+            /* Without memory, fall back on considering the whole table as modified */
+            if ((grown = realloc(list->ranges, capacity * sizeof(Range))) == NULL)
+            {
+                list->whole = 1;
+                return 0;
+            }
+
+            list->ranges = grown;
+            list->capacity = capacity;
+        }
+
+        memmove(&list->ranges[i + 1], &list->ranges[i], (list->count - i) * sizeof(Range));
+        r = &list->ranges[i];
+        r->offset = offset;
+        r->len = len;
+        list->count++;
+    }
+
+    /* The range may now reach the ones after it, which are absorbed */
+    for (j = i + 1; j < list->count && list->ranges[j].offset <= r->offset + r->len + COALESCE_GAP; j++)
+    {
+        if (list->ranges[j].offset + list->ranges[j].len > r->offset + r->len)
+            r->len = list->ranges[j].offset + list->ranges[j].len - r->offset;
+    }
+
+    if (j > i + 1)
+    {
+        memmove(&list->ranges[i + 1], &list->ranges[j], (list->count - j) * sizeof(Range));
+        list->count -= j - i - 1;
+    }
+
+    return 1;
+}
+
+size_t ranges_length(const RangeList *list)
+{
+    size_t i, len = 0;
+
+    for (i = 0; i < list->count; i++)
+        len += list->ranges[i].len;
+
+    return len;
+}
@@ -0,0 +1,33 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Lists of modified ranges, kept in order and coalesced as they are recorded.
+ */
+
+#ifndef RANGES_H_INCLUDED
+#define RANGES_H_INCLUDED
+
+#include <stddef.h>
+
+typedef struct Range
+{
+    size_t offset;
+    size_t len;
+} Range;
+
+typedef struct RangeList
+{
+    Range *ranges;
+    size_t count;
+    size_t capacity;
+    int whole;
+} RangeList;
+
+void ranges_init(RangeList *list);
+void ranges_free(RangeList *list);
+
+int ranges_add(RangeList *list, size_t offset, size_t len);
+size_t ranges_length(const RangeList *list);
+
+#endif
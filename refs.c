@@ -0,0 +1,353 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * References to the strings found in an executable, rewritten when the strings are moved.
+ */
+
+#include <stdlib.h>
+#include "refs.h"
+
+void refs_init(RefList *list)
+{
+    list->refs = NULL;
+    list->count = 0;
+    list->capacity = 0;
+    list->locations = NULL;
+    list->objects = NULL;
+    list->objectCount = 0;
+    list->objectCapacity = 0;
+    list->uses = NULL;
+    list->useCount = 0;
+    list->useCapacity = 0;
+}
+
+void refs_free(RefList *list)
+{
+    free(list->refs);
+    free(list->locations);
+    free(list->objects);
+    free(list->uses);
+    refs_init(list);
+}
+
+int refs_push(RefList *list, long offset, int kind, int bigEndian, uint64_t base, uint64_t target)
+{
+    Reference *r;
+
+    if (list->count >= list->capacity)
+    {
+        const size_t capacity = list->capacity > 0 ? list->capacity * 2 : 1024;
+        Reference *grown;
+
+        if ((grown = realloc(list->refs, capacity * sizeof(Reference))) == NULL)
+            return 0;
+
+        list->refs = grown;
+        list->capacity = capacity;
+    }
+
+    r = &list->refs[list->count++];
+    r->offset = offset;
+    r->kind = kind;
+    r->bigEndian = bigEndian;
+    r->base = base;
+    r->target = target;
+
+    return 1;
+}
+
+int refs_reserve(RefList *list, uint64_t address, uint64_t len)
+{
+    if (len == 0)
+        return 1;
+
+    if (list->objectCount >= list->objectCapacity)
+    {
+        const size_t capacity = list->objectCapacity > 0 ? list->objectCapacity * 2 : 1024;
+        Object *grown;
+
+        if ((grown = realloc(list->objects, capacity * sizeof(Object))) == NULL)
+            return 0;
+
+        list->objects = grown;
+        list->objectCapacity = capacity;
+    }
+
+    list->objects[list->objectCount].address = address;
+    list->objects[list->objectCount].end = address + len;
+    list->objectCount++;
+
+    return 1;
+}
+
+static int add_use(RefList *list, uint64_t address)
+{
+    if (list->useCount >= list->useCapacity)
+    {
+        const size_t capacity = list->useCapacity > 0 ? list->useCapacity * 2 : 1024;
+        uint64_t *grown;
+
+        if ((grown = realloc(list->uses, capacity * sizeof(uint64_t))) == NULL)
+            return 0;
+
+        list->uses = grown;
+        list->useCapacity = capacity;
+    }
+
+    list->uses[list->useCount++] = address;
+
+    return 1;
+}
+
+static int compare_objects(const void *a, const void *b)
+{
+    const Object *oa = a, *ob = b;
+
+    return oa->address < ob->address ? -1 : (oa->address > ob->address ? 1 : 0);
+}
+
+static void sort_objects(RefList *list)
+{
+    size_t i;
+
+    /* The objects may be nested, each one keeps the furthest end of those before it */
+    qsort(list->objects, list->objectCount, sizeof(Object), compare_objects);
+    for (i = 1; i < list->objectCount; i++)
+    {
+        if (list->objects[i].end < list->objects[i - 1].end)
+            list->objects[i].end = list->objects[i - 1].end;
+    }
+}
+
+static uint32_t get_32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+int refs_scan_code(RefList *list, const unsigned char *code, size_t len, long offset, uint64_t address)
+{
+    size_t i;
+
+    /* The data within the code (known from the symbols reserved beforehand) may look like instructions */
+    sort_objects(list);
+
+    /* Look for the x86-64 operands addressed relatively to the instruction pointer: a ModR/M with mod 00 and r/m 101 */
+    for (i = 0; i + 5 <= len; i++)
+    {
+        uint64_t next, target;
+
+        if ((code[i] & 0xc7) != 0x05)
+            continue;
+
+        next = address + i + 5;
+        target = next + (uint64_t)(int64_t)(int32_t)get_32(&code[i + 1]);
+
+        /* The loads of an address (lea disp32(%rip), %reg, REX.W possibly with REX.R) are redirected along with the string */
+        if (i >= 2 && code[i - 1] == 0x8d && (code[i - 2] & 0xfb) == 0x48)
+        {
+            if (!refs_reserved_within(list, address + i - 2, 7) && !refs_push(list, offset + (long)i + 1, REF_REL32, 0, next, target))
+                return 0;
+        }
+
+        /* The others only keep their data in place, its address being off by the immediate following the displacement */
+        else if (!refs_reserved_within(list, address + i, 5) && !add_use(list, target))
+            return 0;
+    }
+
+    return 1;
+}
+
+static int compare_refs(const void *a, const void *b)
+{
+    const Reference *ra = a, *rb = b;
+
+    if (ra->target != rb->target)
+        return ra->target < rb->target ? -1 : 1;
+    if (ra->offset != rb->offset)
+        return ra->offset < rb->offset ? -1 : 1;
+    return 0;
+}
+
+static int compare_locations(const void *a, const void *b)
+{
+    const long la = *(const long*)a, lb = *(const long*)b;
+
+    return la < lb ? -1 : (la > lb ? 1 : 0);
+}
+
+static int compare_uses(const void *a, const void *b)
+{
+    const uint64_t ua = *(const uint64_t*)a, ub = *(const uint64_t*)b;
+
+    return ua < ub ? -1 : (ua > ub ? 1 : 0);
+}
+
+int refs_sort(RefList *list)
+{
+    size_t i;
+
+    /* The references are looked up by their target, and their locations kept aside */
+    qsort(list->refs, list->count, sizeof(Reference), compare_refs);
+
+    free(list->locations);
+    if ((list->locations = malloc((list->count > 0 ? list->count : 1) * sizeof(long))) == NULL)
+        return 0;
+
+    for (i = 0; i < list->count; i++)
+        list->locations[i] = list->refs[i].offset;
+    qsort(list->locations, list->count, sizeof(long), compare_locations);
+
+    sort_objects(list);
+    qsort(list->uses, list->useCount, sizeof(uint64_t), compare_uses);
+
+    return 1;
+}
+
+static size_t lower_target(const RefList *list, uint64_t target)
+{
+    size_t lo = 0, hi = list->count;
+
+    while (lo < hi)
+    {
+        const size_t mid = lo + (hi - lo) / 2;
+
+        if (list->refs[mid].target < target)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+size_t refs_find(const RefList *list, uint64_t target, size_t *first)
+{
+    size_t i;
+
+    *first = lower_target(list, target);
+    for (i = *first; i < list->count && list->refs[i].target == target; i++);
+
+    return i - *first;
+}
+
+size_t refs_range(const RefList *list, uint64_t address, size_t len, size_t *first)
+{
+    *first = lower_target(list, address);
+
+    return lower_target(list, address + len) - *first;
+}
+
+int refs_target_within(const RefList *list, uint64_t address, size_t len)
+{
+    const size_t i = lower_target(list, address);
+
+    return i < list->count && list->refs[i].target < address + len;
+}
+
+int refs_located_within(const RefList *list, long offset, size_t len)
+{
+    size_t lo = 0, hi = list->count;
+
+    /* Find the first reference which may end past the offset */
+    while (lo < hi)
+    {
+        const size_t mid = lo + (hi - lo) / 2;
+
+        if (list->locations[mid] + REF_MAX_SIZE <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo < list->count && list->locations[lo] < offset + (long)len;
+}
+
+int refs_reserved_within(const RefList *list, uint64_t address, size_t len)
+{
+    size_t lo = 0, hi = list->objectCount;
+
+    /* Find the objects starting before the end of the range */
+    while (lo < hi)
+    {
+        const size_t mid = lo + (hi - lo) / 2;
+
+        if (list->objects[mid].address < address + len)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo > 0 && list->objects[lo - 1].end > address;
+}
+
+int refs_used_within(const RefList *list, uint64_t address, size_t len)
+{
+    size_t lo = 0, hi = list->useCount, next;
+
+    /* Find the first data used from the range */
+    while (lo < hi)
+    {
+        const size_t mid = lo + (hi - lo) / 2;
+
+        if (list->uses[mid] < address)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo < list->useCount && list->uses[lo] < address + len)
+        return 1;
+
+    /* The extent of the data used before is unknown, it runs up to the next address referenced after it */
+    if (lo == 0)
+        return 0;
+
+    next = lower_target(list, list->uses[lo - 1] + 1);
+
+    return next >= list->count || list->refs[next].target > address;
+}
+
+int refs_fit(const Reference *ref, uint64_t target)
+{
+    int64_t disp;
+
+    switch (ref->kind)
+    {
+        case REF_ABS32: return target <= 0xffffffffu;
+        case REF_REL32:
+            disp = (int64_t)(target - ref->base);
+            return disp >= -2147483647 - 1 && disp <= 2147483647;
+    }
+
+    return 1;
+}
+
+size_t refs_encode(const Reference *r, unsigned char *bytes)
+{
+    const uint64_t value = r->kind == REF_REL32 ? r->target - r->base : r->target;
+    const size_t len = r->kind == REF_ABS64 ? 8 : 4;
+    size_t j;
+
+    /* Encode the new value in the order of the executable */
+    for (j = 0; j < len; j++)
+        bytes[r->bigEndian ? len - 1 - j : j] = (unsigned char)(value >> (8 * j));
+
+    return len;
+}
+
+int refs_write(FILE *f, const RefList *list)
+{
+    unsigned char bytes[REF_MAX_SIZE];
+    size_t i, len;
+
+    for (i = 0; i < list->count; i++)
+    {
+        len = refs_encode(&list->refs[i], bytes);
+
+        if (fseek(f, list->refs[i].offset, SEEK_SET) != 0 || fwrite(bytes, len, 1, f) != 1)
+            return 0;
+    }
+
+    return 1;
+}
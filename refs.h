@@ -0,0 +1,72 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * References to the strings found in an executable, rewritten when the strings are moved.
+ */
+
+#ifndef REFS_H_INCLUDED
+#define REFS_H_INCLUDED
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define REF_ABS32 0     /* Address of 32 bits */
+#define REF_ABS64 1     /* Address of 64 bits */
+#define REF_REL32 2     /* Displacement of 32 bits from the next instruction */
+
+/* The widest reference, for the overlaps with their locations */
+#define REF_MAX_SIZE 8
+
+/* A location in the file holding the address of a string (or an offset to it) */
+typedef struct Reference
+{
+    long offset;
+    int kind;
+    int bigEndian;
+    uint64_t base;
+    uint64_t target;
+} Reference;
+
+/* An object of the image known from the symbols, which mustn't be overwritten */
+typedef struct Object
+{
+    uint64_t address;
+    uint64_t end;
+} Object;
+
+typedef struct RefList
+{
+    Reference *refs;
+    size_t count;
+    size_t capacity;
+    long *locations;
+    Object *objects;
+    size_t objectCount;
+    size_t objectCapacity;
+    uint64_t *uses;             /* The data operated on by the code (e.g. the constants), known by their address only */
+    size_t useCount;
+    size_t useCapacity;
+} RefList;
+
+void refs_init(RefList *list);
+void refs_free(RefList *list);
+
+int refs_push(RefList *list, long offset, int kind, int bigEndian, uint64_t base, uint64_t target);
+int refs_reserve(RefList *list, uint64_t address, uint64_t len);
+int refs_scan_code(RefList *list, const unsigned char *code, size_t len, long offset, uint64_t address);
+int refs_sort(RefList *list);
+
+size_t refs_find(const RefList *list, uint64_t target, size_t *first);
+size_t refs_range(const RefList *list, uint64_t address, size_t len, size_t *first);
+int refs_target_within(const RefList *list, uint64_t address, size_t len);
+int refs_located_within(const RefList *list, long offset, size_t len);
+int refs_reserved_within(const RefList *list, uint64_t address, size_t len);
+int refs_used_within(const RefList *list, uint64_t address, size_t len);
+
+int refs_fit(const Reference *ref, uint64_t target);
+size_t refs_encode(const Reference *r, unsigned char *bytes);
+int refs_write(FILE *f, const RefList *list);
+
+#endif
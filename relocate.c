@@ -0,0 +1,113 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Move the strings which don't fit (or can't be rewritten in place) elsewhere, their references following them.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "relocate.h"
+#include "scan.h"
+#include "report.h"
+
+static long find_slot(const char *data, const Section *s, size_t newLen, const RefList *refs)
+{
+    const size_t len = s->size;
+    size_t i = 0, end, next;
+
+    while (i < len)
+    {
+        /* Skip a string, up to the padding following its termination */
+        end = i + scan_find(&data[i], len - i, 0);
+        if (end >= len)
+            break;
+        next = end + scan_skip(&data[end], len - end, 0);
+
+        /* The string keeps its termination, and the moved one is terminated before the next string */
+        if (end > i && next - end >= newLen + 2 &&
+            !refs_target_within(refs, s->address + end + 1, newLen + 1) &&
+            !refs_reserved_within(refs, s->address + end + 1, newLen + 1) &&
+            !refs_used_within(refs, s->address + end + 1, newLen + 1) &&
+            !refs_located_within(refs, s->offset + (long)end + 1, newLen + 1))
+            return (long)end + 1;
+
+        i = next;
+    }
+
+    return -1;
+}
+
+int relocate_plan(char *data, const Section *s, const Plan *plan, const RefList *refs, int move, RefList *moved, RangeList *dirty, Listing *listing)
+{
+    size_t c, k, first, count;
+    long slot;
+    int ret = 0;
+
+    /* Write the replacements which fit in place first, the room left in the padding being known afterwards */
+    for (c = 0; c < plan->count; c++)
+    {
+        const Change *change = &plan->changes[c];
+
+        if (change->newLen > change->available || change->conflict >= 0)
+            continue;
+
+        if (listing != NULL)
+            listing_change(listing, s->offset + change->offset, &data[change->offset], change->oldLen,
+                change->replacement, change->newLen, change->available);
+
+        memcpy(&data[change->offset], change->replacement, change->newLen);
+        memset(&data[change->offset + change->newLen], 0, change->available - change->newLen);
+        ranges_add(dirty, change->offset, change->newLen > change->oldLen ? change->newLen : change->oldLen);
+    }
+
+    /* The others are written elsewhere, provided every known reference to them can be redirected */
+    for (c = 0; c < plan->count; c++)
+    {
+        const Change *change = &plan->changes[c];
+
+        if (change->newLen <= change->available && change->conflict < 0)
+            continue;
+
+        count = move ? refs_find(refs, s->address + change->offset, &first) : 0;
+        slot = count > 0 ? find_slot(data, s, change->newLen, refs) : -1;
+        for (k = 0; k < count && slot >= 0; k++)
+        {
+            if (!refs_fit(&refs->refs[first + k], s->address + (uint64_t)slot))
+                slot = -1;
+        }
+
+        if (slot < 0)
+        {
+            if (listing != NULL && change->conflict >= 0)
+                listing_conflict(listing, s->offset + change->offset, &data[change->offset], change->oldLen,
+                    change->replacement, change->newLen, s->offset + (size_t)change->conflict);
+            else if (listing != NULL)
+                listing_change(listing, s->offset + change->offset, &data[change->offset], change->oldLen,
+                    NULL, change->newLen, change->available);
+            else if (change->conflict >= 0)
+                report_error("The string at %08lX shares its bytes with the one at %08lX, it was left as is!\n",
+                    (unsigned long)(s->offset + (long)change->offset), (unsigned long)(s->offset + change->conflict));
+            ret = 2;
+            continue;
+        }
+
+        if (listing != NULL)
+            listing_move(listing, s->offset + change->offset, &data[change->offset], change->oldLen,
+                change->replacement, change->newLen, s->offset + (size_t)slot, count);
+
+        /* The original string is left as is, for the references into it which can't be known (e.g. suffixes) */
+        memcpy(&data[slot], change->replacement, change->newLen);
+        ranges_add(dirty, (size_t)slot, change->newLen);
+
+        for (k = 0; k < count; k++)
+        {
+            const Reference *r = &refs->refs[first + k];
+
+            if (!refs_push(moved, r->offset, r->kind, r->bigEndian, r->base, s->address + (uint64_t)slot))
+                ret = 2;
+        }
+    }
+
+    return ret;
+}
@@ -0,0 +1,19 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Move the strings which don't fit (or can't be rewritten in place) elsewhere, their references following them.
+ */
+
+#ifndef RELOCATE_H_INCLUDED
+#define RELOCATE_H_INCLUDED
+
+#include "sections.h"
+#include "ranges.h"
+#include "plan.h"
+#include "refs.h"
+#include "listing.h"
+
+int relocate_plan(char *data, const Section *s, const Plan *plan, const RefList *refs, int move, RefList *moved, RangeList *dirty, Listing *listing);
+
+#endif
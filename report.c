@@ -0,0 +1,71 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Reporting of the failures, on stderr for the program or to the handles of the library.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include "report.h"
+
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+static THREAD_LOCAL ReportSink threadSink = NULL;
+static THREAD_LOCAL void *threadContext = NULL;
+
+void report_set_thread(ReportSink sink, void *context)
+{
+    threadSink = sink;
+    threadContext = context;
+}
+
+void report_get_thread(ReportSink *sink, void **context)
+{
+    *sink = threadSink;
+    *context = threadContext;
+}
+
+void report_keep(void *context, const char *message)
+{
+    char *kept = context;
+
+    if (*kept == 0)
+    {
+        strncpy(kept, message, REPORT_LEN - 1);
+        kept[REPORT_LEN - 1] = 0;
+    }
+}
+
+void report_error(const char *format, ...)
+{
+    char message[REPORT_LEN];
+    va_list args;
+    size_t len;
+
+    va_start(args, format);
+
+    /* Without any sink, the message goes as is to stderr */
+    if (threadSink == NULL)
+    {
+        vfprintf(stderr, format, args);
+        va_end(args);
+        return;
+    }
+
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    len = strlen(message);
+    while (len > 0 && message[len - 1] == '\n')
+        message[--len] = 0;
+
+    threadSink(threadContext, message);
+}
@@ -0,0 +1,26 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Reporting of the failures, on stderr for the program or to the handles of the library.
+ */
+
+#ifndef REPORT_H_INCLUDED
+#define REPORT_H_INCLUDED
+
+/* The longest message kept, the longer ones being cut */
+#define REPORT_LEN 512
+
+/* Receives the message of a failure, without its new line */
+typedef void (*ReportSink)(void *context, const char *message);
+
+/* The sink of the current thread (NULL for stderr), the threads started having their own */
+void report_set_thread(ReportSink sink, void *context);
+void report_get_thread(ReportSink *sink, void **context);
+
+/* A sink keeping the first message in a buffer of REPORT_LEN characters, the following ones being its consequences */
+void report_keep(void *context, const char *message);
+
+void report_error(const char *format, ...);
+
+#endif
@@ -0,0 +1,370 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Sets of search and replace rules, loaded from the command-line or a file.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "rules.h"
+#include "automaton.h"
+#include "search.h"
+#include "pattern.h"
+#include "report.h"
+
+static char *duplicate(const char *str, size_t len)
+{
+    char *copy;
+
+    if ((copy = malloc(len + 1)) == NULL)
+        return NULL;
+
+    memcpy(copy, str, len);
+    copy[len] = 0;
+
+    return copy;
+}
+
+static int rules_add_len(RuleSet *set, const char *search, size_t searchLen, const char *replace, size_t replaceLen)
+{
+    Rule *rule;
+
+    /* An empty search would match everywhere */
+    if (searchLen == 0)
+    {
+        report_error("The string to search can't be empty!\n");
+        return 0;
+    }
+
+    /* Grow the list of rules if needed */
+    if (set->count >= set->capacity)
+    {
+        const size_t capacity = set->capacity == 0 ? 16 : set->capacity * 2;
+        Rule *rules;
+
+        if ((rules = realloc(set->rules, capacity * sizeof(Rule))) == NULL)
+        {
+            report_error("Failed to allocate memory for the rules: %s!\n", strerror(errno));
+            return 0;
+        }
+
+        set->rules = rules;
+        set->capacity = capacity;
+    }
+
+    rule = &set->rules[set->count];
+    rule->search = duplicate(search, searchLen);
+    rule->replace = duplicate(replace, replaceLen);
+    rule->searchLen = searchLen;
+    rule->replaceLen = replaceLen;
+
+    if (rule->search == NULL || rule->replace == NULL)
+    {
+        report_error("Failed to allocate memory for the rules: %s!\n", strerror(errno));
+        free(rule->search);
+        free(rule->replace);
+        return 0;
+    }
+
+    set->count++;
+
+    return 1;
+}
+
+/* Decode the escape sequences of a field in place and return its new length (those of the patterns being left to them) */
+static size_t unescape(char *str, size_t len, int patterns)
+{
+    size_t i, j = 0;
+
+    for (i = 0; i < len; i++)
+    {
+        if (str[i] == '\\' && i + 1 < len)
+        {
+            switch (str[++i])
+            {
+                case 't': str[j++] = '\t'; break;
+                case 'n': str[j++] = '\n'; break;
+                case 'r': str[j++] = '\r'; break;
+                default:
+                    if (patterns)
+                        str[j++] = '\\';
+                    str[j++] = str[i];
+                    break;
+            }
+        }
+        else
+            str[j++] = str[i];
+    }
+
+    return j;
+}
+
+static int parse_line(RuleSet *set, char *line, size_t len, unsigned long lineNum)
+{
+    size_t sep;
+
+    /* Ignore the empty lines and the comments */
+    if (len == 0 || line[0] == '#')
+        return 1;
+
+    /* Find the tabulation separating the search from the replacement */
+    for (sep = 0; sep < len; sep++)
+    {
+        if (line[sep] == '\\')
+            sep++;
+        else if (line[sep] == '\t')
+            break;
+    }
+
+    if (sep >= len)
+    {
+        report_error("Missing tabulation on line %lu of the rules!\n", lineNum);
+        return 0;
+    }
+
+    return rules_add_len(set,
+        line, unescape(line, sep, set->patterns != PATTERNS_NONE),
+        &line[sep + 1], unescape(&line[sep + 1], len - sep - 1, set->patterns != PATTERNS_NONE));
+}
+
+void rules_init(RuleSet *set)
+{
+    set->rules = NULL;
+    set->count = 0;
+    set->capacity = 0;
+    set->automaton = NULL;
+    set->needle = NULL;
+    set->patterns = PATTERNS_NONE;
+    set->pattern = NULL;
+    set->utf16 = 0;
+}
+
+void rules_free(RuleSet *set)
+{
+    size_t i;
+
+    for (i = 0; i < set->count; i++)
+    {
+        free(set->rules[i].search);
+        free(set->rules[i].replace);
+    }
+
+    if (set->automaton != NULL)
+        automaton_free(set->automaton);
+
+    if (set->needle != NULL)
+        needle_free(set->needle);
+
+    if (set->pattern != NULL)
+        pattern_free(set->pattern);
+
+    free(set->automaton);
+    free(set->needle);
+    free(set->pattern);
+    free(set->rules);
+    rules_init(set);
+}
+
+int rules_add(RuleSet *set, const char *search, const char *replace)
+{
+    return rules_add_len(set, search, strlen(search), replace, strlen(replace));
+}
+
+int rules_load(RuleSet *set, FILE *f)
+{
+    char *line = NULL;
+    size_t len = 0, capacity = 0;
+    unsigned long lineNum = 1;
+    int c, ret = 1;
+
+    /* Read the file line by line, each line being "<search>\t<replace>" */
+    while (ret)
+    {
+        c = fgetc(f);
+
+        if (c == '\n' || c == EOF)
+        {
+            /* Strip the carriage return of CRLF files */
+            if (len > 0 && line[len - 1] == '\r')
+                len--;
+
+            ret = parse_line(set, line, len, lineNum++);
+            len = 0;
+
+            if (c == EOF)
+                break;
+            continue;
+        }
+
+        /* Grow the line buffer if needed */
+        if (len >= capacity)
+        {
+            char *grown;
+
+            capacity = capacity == 0 ? 256 : capacity * 2;
+            if ((grown = realloc(line, capacity)) == NULL)
+            {
+                report_error("Failed to allocate memory for the rules: %s!\n", strerror(errno));
+                ret = 0; break;
+            }
+            line = grown;
+        }
+
+        line[len++] = (char)c;
+    }
+
+    if (ret && ferror(f))
+    {
+        report_error("Failed to read the rules: %s!\n", strerror(errno));
+        ret = 0;
+    }
+
+    free(line);
+
+    return ret;
+}
+
+/* Convert a string from UTF-8 to UTF-16LE, returning NULL if it isn't valid UTF-8 */
+static char *widen(const char *str, size_t len, size_t *wideLen)
+{
+    const unsigned char *s = (const unsigned char*)str;
+    unsigned long c;
+    size_t i = 0, j = 0, n, k;
+    char *wide;
+
+    /* Every byte takes at most a character of two bytes */
+    if ((wide = malloc(2 * len + 2)) == NULL)
+        return NULL;
+
+    while (i < len)
+    {
+        /* Decode the code point, rejecting the overlong forms, the surrogates and what's beyond U+10FFFF */
+        if (s[i] < 0x80)
+            n = 1;
+        else if (s[i] >= 0xc2 && s[i] <= 0xdf)
+            n = 2;
+        else if (s[i] >= 0xe0 && s[i] <= 0xef)
+            n = 3;
+        else if (s[i] >= 0xf0 && s[i] <= 0xf4)
+            n = 4;
+        else
+            goto INVALID;
+
+        c = s[i] & (0xff >> (n == 1 ? 1 : n + 1));
+
+        if (i + n > len)
+            goto INVALID;
+
+        for (k = 1; k < n; k++)
+        {
+            if ((s[i + k] & 0xc0) != 0x80)
+                goto INVALID;
+            c = (c << 6) | (s[i + k] & 0x3f);
+        }
+
+        if ((n == 3 && c < 0x800) || (n == 4 && (c < 0x10000 || c > 0x10ffff)) || (c >= 0xd800 && c <= 0xdfff))
+            goto INVALID;
+
+        /* The characters beyond the basic plane take a pair of surrogates */
+        if (c >= 0x10000)
+        {
+            c -= 0x10000;
+            wide[j++] = (char)((0xd800 | (c >> 10)) & 0xff);
+            wide[j++] = (char)((0xd800 | (c >> 10)) >> 8);
+            c = 0xdc00 | (c & 0x3ff);
+        }
+        wide[j++] = (char)(c & 0xff);
+        wide[j++] = (char)(c >> 8);
+
+        i += n;
+    }
+
+    wide[j] = wide[j + 1] = 0;
+    *wideLen = j;
+
+    return wide;
+
+INVALID:
+    free(wide);
+    errno = EILSEQ;
+    return NULL;
+}
+
+int rules_compile(RuleSet *set)
+{
+    size_t i, searchLen, replaceLen;
+    char *search, *replace;
+
+    /* The strings of UTF-16 tables are looked for as they're encoded there */
+    for (i = 0; set->utf16 && i < set->count; i++)
+    {
+        Rule *rule = &set->rules[i];
+
+        if ((search = widen(rule->search, rule->searchLen, &searchLen)) == NULL ||
+            (replace = widen(rule->replace, rule->replaceLen, &replaceLen)) == NULL)
+        {
+            report_error("Failed to convert the rule \"%s\" to UTF-16: %s!\n", rule->search, strerror(errno));
+            free(search);
+            return 0;
+        }
+
+        free(rule->search);
+        free(rule->replace);
+        rule->search = search;
+        rule->searchLen = searchLen;
+        rule->replace = replace;
+        rule->replaceLen = replaceLen;
+    }
+
+    /* The patterns are compiled into a single program, all the rules being tried at once */
+    if (set->patterns != PATTERNS_NONE)
+    {
+        if ((set->pattern = malloc(sizeof(Pattern))) == NULL)
+        {
+            report_error("Failed to allocate memory for the patterns: %s!\n", strerror(errno));
+            return 0;
+        }
+
+        if (!pattern_compile(set->pattern, set->rules, set->count, set->patterns == PATTERNS_WILDCARD))
+        {
+            free(set->pattern);
+            set->pattern = NULL;
+            return 0;
+        }
+
+        return 1;
+    }
+
+    /* A single search is better served by a dedicated search than by the automaton */
+    if (set->count == 1)
+    {
+        if ((set->needle = malloc(sizeof(Needle))) == NULL ||
+            !needle_init(set->needle, set->rules[0].search, set->rules[0].searchLen))
+        {
+            report_error("Failed to allocate memory for the search: %s!\n", strerror(errno));
+            free(set->needle);
+            set->needle = NULL;
+            return 0;
+        }
+
+        return 1;
+    }
+
+    /* Build the matching automaton once for all the searches */
+    if ((set->automaton = malloc(sizeof(Automaton))) == NULL)
+    {
+        report_error("Failed to allocate memory for the matching automaton: %s!\n", strerror(errno));
+        return 0;
+    }
+
+    if (!automaton_build(set->automaton, set->rules, set->count))
+    {
+        free(set->automaton);
+        set->automaton = NULL;
+        return 0;
+    }
+
+    return 1;
+}
@@ -0,0 +1,50 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Sets of search and replace rules, loaded from the command-line or a file.
+ */
+
+#ifndef RULES_H_INCLUDED
+#define RULES_H_INCLUDED
+
+#include <stdio.h>
+
+#define PATTERNS_NONE     0     /* The searches are plain strings */
+#define PATTERNS_REGEX    1     /* The searches are regular expressions */
+#define PATTERNS_WILDCARD 2     /* The searches are wildcards */
+
+/* A single search and replace pair */
+typedef struct Rule
+{
+    char *search;
+    char *replace;
+    size_t searchLen;
+    size_t replaceLen;
+} Rule;
+
+struct Automaton;
+struct Needle;
+struct Pattern;
+
+/* The whole list of rules applied during one pass */
+typedef struct RuleSet
+{
+    Rule *rules;
+    size_t count;
+    size_t capacity;
+    struct Automaton *automaton;
+    struct Needle *needle;
+    int patterns;
+    struct Pattern *pattern;
+    int utf16;                  /* The strings are converted from UTF-8 to UTF-16LE when compiled */
+} RuleSet;
+
+void rules_init(RuleSet *set);
+void rules_free(RuleSet *set);
+
+int rules_add(RuleSet *set, const char *search, const char *replace);
+int rules_load(RuleSet *set, FILE *f);
+int rules_compile(RuleSet *set);
+
+#endif
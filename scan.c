@@ -0,0 +1,205 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Vectorized scanning of the strings tables (SSE2, AVX2 or NEON, picked at runtime), of bytes or of UTF-16 characters.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define SCAN_X86
+#include <immintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__)
+#define SCAN_NEON
+#include <arm_neon.h>
+#endif
+#include "scan.h"
+
+/* Returns the index of the first byte equal (or not equal) to c, len if there's none */
+typedef size_t (*Kernel)(const unsigned char *data, size_t len, unsigned char c, int equal);
+
+/* Returns the index of the first null character (or not null) on an even offset, len if there's none */
+typedef size_t (*WideKernel)(const unsigned char *data, size_t len, int equal);
+
+static size_t scan_scalar(const unsigned char *data, size_t len, unsigned char c, int equal)
+{
+    size_t i;
+
+    for (i = 0; i < len && (data[i] == c) != equal; i++);
+
+    return i;
+}
+
+static size_t wide_scalar(const unsigned char *data, size_t len, int equal)
+{
+    size_t i;
+
+    for (i = 0; i + 2 <= len && ((data[i] | data[i + 1]) == 0) != equal; i += 2);
+
+    return i + 2 <= len ? i : len;
+}
+
+#ifdef SCAN_X86
+
+static size_t scan_sse2(const unsigned char *data, size_t len, unsigned char c, int equal)
+{
+    const __m128i v = _mm_set1_epi8((char)c);
+    const unsigned int flip = equal ? 0 : 0xffff;
+    size_t i;
+
+    /* Compare 16 bytes at once, the mask pointing at the matching ones */
+    for (i = 0; i + 16 <= len; i += 16)
+    {
+        const unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)&data[i]), v)) ^ flip;
+
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+
+    return i + scan_scalar(&data[i], len - i, c, equal);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_avx2(const unsigned char *data, size_t len, unsigned char c, int equal)
+{
+    const __m256i v = _mm256_set1_epi8((char)c);
+    const unsigned int flip = equal ? 0 : 0xffffffff;
+    size_t i;
+
+    /* Compare 32 bytes at once */
+    for (i = 0; i + 32 <= len; i += 32)
+    {
+        const unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)&data[i]), v)) ^ flip;
+
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+
+    return i + scan_sse2(&data[i], len - i, c, equal);
+}
+
+static size_t wide_sse2(const unsigned char *data, size_t len, int equal)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const unsigned int flip = equal ? 0 : 0xffff;
+    size_t i;
+
+    /* Compare 8 characters at once, each of them setting two bits of the mask */
+    for (i = 0; i + 16 <= len; i += 16)
+    {
+        const unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)&data[i]), zero)) ^ flip;
+
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+
+    return i + wide_scalar(&data[i], len - i, equal);
+}
+
+__attribute__((target("avx2")))
+static size_t wide_avx2(const unsigned char *data, size_t len, int equal)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const unsigned int flip = equal ? 0 : 0xffffffff;
+    size_t i;
+
+    /* Compare 16 characters at once */
+    for (i = 0; i + 32 <= len; i += 32)
+    {
+        const unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i*)&data[i]), zero)) ^ flip;
+
+        if (mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+
+    return i + wide_sse2(&data[i], len - i, equal);
+}
+
+#endif
+
+#ifdef SCAN_NEON
+
+static size_t scan_neon(const unsigned char *data, size_t len, unsigned char c, int equal)
+{
+    const uint8x16_t v = vdupq_n_u8(c);
+    size_t i;
+
+    for (i = 0; i + 16 <= len; i += 16)
+    {
+        uint8x16_t cmp = vceqq_u8(vld1q_u8(&data[i]), v);
+        uint64_t mask;
+
+        if (!equal)
+            cmp = vmvnq_u8(cmp);
+
+        /* Narrow the comparison to 4 bits per byte to locate the first matching one */
+        mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4)), 0);
+        if (mask != 0)
+            return i + (size_t)(__builtin_ctzll(mask) >> 2);
+    }
+
+    return i + scan_scalar(&data[i], len - i, c, equal);
+}
+
+static size_t wide_neon(const unsigned char *data, size_t len, int equal)
+{
+    const uint16x8_t zero = vdupq_n_u16(0);
+    size_t i;
+
+    for (i = 0; i + 16 <= len; i += 16)
+    {
+        uint16x8_t cmp = vceqq_u16(vreinterpretq_u16_u8(vld1q_u8(&data[i])), zero);
+        uint64_t mask;
+
+        if (!equal)
+            cmp = vmvnq_u16(cmp);
+
+        /* Both bytes of a character are set alike, the first one tells its index */
+        mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(cmp, 4)), 0);
+        if (mask != 0)
+            return i + (size_t)(__builtin_ctzll(mask) >> 2);
+    }
+
+    return i + wide_scalar(&data[i], len - i, equal);
+}
+
+#endif
+
+/* The portable kernels are used until scan_init, which must be called before any thread is started */
+static Kernel kernel = scan_scalar;
+static WideKernel wideKernel = wide_scalar;
+
+void scan_init(void)
+{
+    /* Pick the widest instructions supported by the processor, once and for all */
+#if defined(SCAN_X86)
+    __builtin_cpu_init();
+    kernel = __builtin_cpu_supports("avx2") ? scan_avx2 : scan_sse2;
+    wideKernel = __builtin_cpu_supports("avx2") ? wide_avx2 : wide_sse2;
+#elif defined(SCAN_NEON)
+    kernel = scan_neon;
+    wideKernel = wide_neon;
+#else
+    kernel = scan_scalar;
+    wideKernel = wide_scalar;
+#endif
+}
+
+size_t scan_find(const char *data, size_t len, int c)
+{
+    return kernel((const unsigned char*)data, len, (unsigned char)c, 1);
+}
+
+size_t scan_skip(const char *data, size_t len, int c)
+{
+    return kernel((const unsigned char*)data, len, (unsigned char)c, 0);
+}
+
+size_t scan_find_wide(const char *data, size_t len)
+{
+    return wideKernel((const unsigned char*)data, len, 1);
+}
+
+size_t scan_skip_wide(const char *data, size_t len)
+{
+    return wideKernel((const unsigned char*)data, len, 0);
+}
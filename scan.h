@@ -0,0 +1,21 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Vectorized scanning of the strings tables (SSE2, AVX2 or NEON, picked at runtime).
+ */
+
+#ifndef SCAN_H_INCLUDED
+#define SCAN_H_INCLUDED
+
+#include <stddef.h>
+
+void scan_init(void);
+
+size_t scan_find(const char *data, size_t len, int c);
+size_t scan_skip(const char *data, size_t len, int c);
+
+size_t scan_find_wide(const char *data, size_t len);
+size_t scan_skip_wide(const char *data, size_t len);
+
+#endif
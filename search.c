@@ -0,0 +1,78 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Linear-time search of a single string (Knuth-Morris-Pratt, accelerated with memchr).
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "search.h"
+
+int needle_init(Needle *needle, const char *str, size_t len)
+{
+    size_t i, k = 0;
+
+    needle->str = str;
+    needle->len = len;
+
+    if ((needle->fail = malloc(len * sizeof(size_t))) == NULL)
+        return 0;
+
+    /* Compute the length of the longest border of every prefix of the needle */
+    needle->fail[0] = 0;
+    for (i = 1; i < len; i++)
+    {
+        while (k > 0 && str[i] != str[k])
+            k = needle->fail[k - 1];
+
+        if (str[i] == str[k])
+            k++;
+
+        needle->fail[i] = k;
+    }
+
+    return 1;
+}
+
+void needle_free(Needle *needle)
+{
+    free(needle->fail);
+    needle->fail = NULL;
+}
+
+const char *needle_find(const Needle *needle, const char *data, size_t len)
+{
+    size_t i = 0, k = 0;
+
+    while (i < len)
+    {
+        if (k == 0)
+        {
+            /* Nothing matched yet, jump straight to the next candidate */
+            const char *p = memchr(&data[i], needle->str[0], len - i);
+
+            if (p == NULL)
+                return NULL;
+
+            i = (size_t)(p - data) + 1;
+            k = 1;
+        }
+        else if (data[i] == needle->str[k])
+        {
+            i++;
+            k++;
+        }
+        else
+        {
+            /* Fall back to the longest border without moving backward in the data */
+            k = needle->fail[k - 1];
+            continue;
+        }
+
+        if (k >= needle->len)
+            return &data[i - needle->len];
+    }
+
+    return NULL;
+}
@@ -0,0 +1,25 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Linear-time search of a single string (Knuth-Morris-Pratt, accelerated with memchr).
+ */
+
+#ifndef SEARCH_H_INCLUDED
+#define SEARCH_H_INCLUDED
+
+#include <stddef.h>
+
+typedef struct Needle
+{
+    const char *str;
+    size_t len;
+    size_t *fail;
+} Needle;
+
+int needle_init(Needle *needle, const char *str, size_t len);
+void needle_free(Needle *needle);
+
+const char *needle_find(const Needle *needle, const char *data, size_t len);
+
+#endif
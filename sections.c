@@ -0,0 +1,88 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Table of the sections of an executable, parsed once from its headers.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "sections.h"
+
+void sections_init(SectionTable *table)
+{
+    table->sections = NULL;
+    table->count = 0;
+    table->names = NULL;
+    table->nameMax = 0;
+}
+
+void sections_free(SectionTable *table)
+{
+    free(table->sections);
+    free(table->names);
+    sections_init(table);
+}
+
+int sections_copy(SectionTable *dst, const SectionTable *src)
+{
+    size_t i, namesLen = 0;
+    char *names;
+
+    sections_init(dst);
+
+    /* Gather the names in a single table, they may not all come from the same one */
+    for (i = 0; i < src->count; i++)
+        namesLen += strlen(src->sections[i].name) + 1;
+
+    dst->sections = malloc((src->count > 0 ? src->count : 1) * sizeof(Section));
+    dst->names = malloc(namesLen + 1);
+
+    if (dst->sections == NULL || dst->names == NULL)
+    {
+        sections_free(dst);
+        return 0;
+    }
+
+    for (i = 0, names = dst->names; i < src->count; i++)
+    {
+        dst->sections[i] = src->sections[i];
+        dst->sections[i].name = strcpy(names, src->sections[i].name);
+        names += strlen(names) + 1;
+    }
+
+    dst->count = src->count;
+    dst->nameMax = src->nameMax;
+
+    return 1;
+}
+
+const Section *sections_find(const SectionTable *table, const char *name)
+{
+    size_t i;
+
+    /* Some formats limit the length of the names, only this part is compared */
+    for (i = 0; i < table->count; i++)
+    {
+        if (table->nameMax > 0 ? strncmp(name, table->sections[i].name, table->nameMax) == 0 : strcmp(name, table->sections[i].name) == 0)
+            return &table->sections[i];
+    }
+
+    return NULL;
+}
+
+const Section *sections_at(const SectionTable *table, uint64_t address, size_t len)
+{
+    size_t i;
+
+    /* Find the section holding the whole range once loaded */
+    for (i = 0; i < table->count; i++)
+    {
+        const Section *s = &table->sections[i];
+
+        if (s->address != 0 && address >= s->address && address - s->address + len <= s->size)
+            return s;
+    }
+
+    return NULL;
+}
@@ -0,0 +1,41 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Table of the sections of an executable, parsed once from its headers.
+ */
+
+#ifndef SECTIONS_H_INCLUDED
+#define SECTIONS_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* The size is that of the bytes in the file, less than the size once loaded for the uninitialized data */
+typedef struct Section
+{
+    const char *name;
+    long offset;
+    size_t size;
+    uint64_t memSize;
+    uint64_t address;
+    uint32_t type;
+    uint64_t flags;
+} Section;
+
+typedef struct SectionTable
+{
+    Section *sections;
+    size_t count;
+    char *names;
+    size_t nameMax;
+} SectionTable;
+
+void sections_init(SectionTable *table);
+void sections_free(SectionTable *table);
+int sections_copy(SectionTable *dst, const SectionTable *src);
+
+const Section *sections_find(const SectionTable *table, const char *name);
+const Section *sections_at(const SectionTable *table, uint64_t address, size_t len);
+
+#endif
@@ -0,0 +1,316 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Long-running server patching the files sent over a Unix socket, the rules being compiled once.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "server.h"
+
+#ifdef _WIN32
+
+int server_run(const char *path, const ServerRules *sets, size_t count, const Options *opts, unsigned int workers, ServerJob job)
+{
+    (void)path; (void)sets; (void)count; (void)opts; (void)workers; (void)job;
+
+    fputs("The server needs Unix sockets!\n", stderr);
+
+    return 11;
+}
+
+#else
+
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "threads.h"
+
+/* The longest request, a rule set and two paths */
+#define SERVER_LINE 16384
+
+/* The standard input and output of the program, which belong to the server itself */
+#define SERVER_STDIO "-"
+
+/* The connections waiting for a worker */
+#define SERVER_BACKLOG 64
+
+/* Shared by the workers, which only read it */
+typedef struct Server
+{
+    int socket;
+    const ServerRules *sets;
+    size_t count;
+    const Options *opts;
+    ServerJob job;
+} Server;
+
+/* A worker serves a connection at a time, its memory going from one file to the next */
+typedef struct ServerWorker
+{
+    const Server *server;
+    Arena arena;
+} ServerWorker;
+
+/* Stopping wakes up the workers waiting for a connection */
+static volatile sig_atomic_t stopping = 0;
+static int listening = -1;
+
+static void server_stop(int sig)
+{
+    (void)sig;
+
+    stopping = 1;
+    if (listening >= 0)
+        shutdown(listening, SHUT_RDWR);
+}
+
+static const RuleSet *find_rules(const Server *server, const char *id)
+{
+    size_t i;
+
+    for (i = 0; i < server->count; i++)
+    {
+        if (strcmp(server->sets[i].id, id) == 0)
+            return &server->sets[i].rules;
+    }
+
+    return NULL;
+}
+
+/* Process a request, "<rules>\t<file>[\t<output>]", returning its exit code */
+static int serve_request(const Server *server, char *line, const char **path, Arena *arena)
+{
+    const RuleSet *rules;
+    char *file, *output;
+
+    *path = "";
+    if ((file = strchr(line, '\t')) == NULL)
+    {
+        fputs("Malformed request: missing the file!\n", stderr);
+        return 11;
+    }
+    *file++ = 0;
+    *path = file;
+
+    if ((output = strchr(file, '\t')) != NULL)
+        *output++ = 0;
+
+    /* Every path given must name a file, not the streams of the server */
+    if (*file == 0 || (output != NULL && *output == 0))
+    {
+        fputs("Malformed request: empty path!\n", stderr);
+        return 11;
+    }
+    if (strcmp(file, SERVER_STDIO) == 0 || (output != NULL && strcmp(output, SERVER_STDIO) == 0))
+    {
+        fputs("Malformed request: the standard input and output can't be patched by the server!\n", stderr);
+        return 11;
+    }
+
+    if ((rules = find_rules(server, line)) == NULL)
+    {
+        fprintf(stderr, "Unknown rules: %s!\n", line);
+        return 16;
+    }
+
+    return server->job(file, output, rules, server->opts, arena);
+}
+
+static void serve_connection(const Server *server, int fd, Arena *arena)
+{
+    char line[SERVER_LINE];
+    const char *path;
+    FILE *in, *out;
+    size_t len;
+    int ret, dropped;
+
+    in = fdopen(fd, "r");
+    out = in != NULL ? fdopen(dup(fd), "w") : NULL;
+    if (in == NULL || out == NULL)
+    {
+        fprintf(stderr, "Failed to open the connection: %s!\n", strerror(errno));
+        if (in != NULL)
+            fclose(in);
+        else
+            close(fd);
+        return;
+    }
+
+    /* The requests of a connection are processed in their order, each one being answered by "<code>\t<file>" */
+    while (fgets(line, sizeof(line), in) != NULL)
+    {
+        len = strlen(line);
+        dropped = 0;
+
+        /* A line too long is dropped whole */
+        if (len > 0 && line[len - 1] != '\n' && !feof(in))
+        {
+            int c;
+
+            while ((c = fgetc(in)) != EOF && c != '\n');
+            dropped = 1;
+        }
+
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+            line[--len] = 0;
+
+        if (len == 0 && !dropped)
+            continue;
+
+        if (strcmp(line, "stop") == 0)
+        {
+            server_stop(0);
+            break;
+        }
+
+        if (dropped)
+        {
+            fputs("Malformed request: the line is too long!\n", stderr);
+            path = "";
+            ret = 11;
+        }
+        else
+            ret = serve_request(server, line, &path, arena);
+        arena_reset(arena);
+
+        if (fprintf(out, "%d\t%s\n", ret, path) < 0 || fflush(out) != 0)
+            break;
+    }
+
+    fclose(out);
+    fclose(in);
+}
+
+static void serve_worker(void *arg)
+{
+    ServerWorker *worker = arg;
+    int fd;
+
+    while (!stopping)
+    {
+        if ((fd = accept(worker->server->socket, NULL, NULL)) < 0)
+        {
+            /* A client giving up before being accepted doesn't stop the server */
+            if (stopping)
+                break;
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+
+            fprintf(stderr, "Failed to accept a connection: %s!\n", strerror(errno));
+            server_stop(0);
+            break;
+        }
+
+        serve_connection(worker->server, fd, &worker->arena);
+    }
+}
+
+static int serving(const struct sockaddr_un *addr)
+{
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    int ret;
+
+    if (fd < 0)
+        return 0;
+
+    ret = connect(fd, (const struct sockaddr*)addr, sizeof(*addr)) == 0;
+    close(fd);
+
+    return ret;
+}
+
+int server_run(const char *path, const ServerRules *sets, size_t count, const Options *opts, unsigned int workers, ServerJob job)
+{
+    struct sockaddr_un addr;
+    struct sigaction action;
+    struct stat st;
+    ServerWorker *pool;
+    Server server;
+    unsigned int i;
+    int ret = 0;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        fputs("The path of the socket is too long!\n", stderr);
+        return 11;
+    }
+    strcpy(addr.sun_path, path);
+
+    /* A socket left by a server which is gone is replaced, anything else is kept */
+    if (stat(path, &st) == 0)
+    {
+        if (!S_ISSOCK(st.st_mode) || serving(&addr))
+        {
+            fprintf(stderr, "The socket %s is already in use!\n", path);
+            return 12;
+        }
+        unlink(path);
+    }
+
+    if ((pool = malloc(workers * sizeof(ServerWorker))) == NULL)
+    {
+        fprintf(stderr, "Failed to allocate memory for the workers: %s!\n", strerror(errno));
+        return 7;
+    }
+
+    if ((server.socket = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+        bind(server.socket, (const struct sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(server.socket, SERVER_BACKLOG) != 0)
+    {
+        fprintf(stderr, "Failed to open the socket: %s!\n", strerror(errno));
+        if (server.socket >= 0)
+            close(server.socket);
+        free(pool);
+        return 3;
+    }
+
+    server.sets = sets;
+    server.count = count;
+    server.opts = opts;
+    server.job = job;
+
+    /* Stop on a signal, once the requests being processed are done, and outlive the clients going away */
+    listening = server.socket;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = server_stop;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    /* Every worker waits for its own connections */
+    for (i = 0; i < workers; i++)
+    {
+        pool[i].server = &server;
+        arena_init(&pool[i].arena);
+    }
+
+    threads_run(serve_worker, pool, sizeof(ServerWorker), workers);
+
+    for (i = 0; i < workers; i++)
+        arena_free(&pool[i].arena);
+    free(pool);
+
+    listening = -1;
+    close(server.socket);
+    if (unlink(path) != 0)
+    {
+        fprintf(stderr, "Failed to remove the socket: %s!\n", strerror(errno));
+        ret = 3;
+    }
+
+    return ret;
+}
+
+#endif
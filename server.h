@@ -0,0 +1,28 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Long-running server patching the files sent over a Unix socket, the rules being compiled once.
+ */
+
+#ifndef SERVER_H_INCLUDED
+#define SERVER_H_INCLUDED
+
+#include <stddef.h>
+#include "rules.h"
+#include "process.h"
+#include "arena.h"
+
+/* Patch a file (into the output, unless it's NULL), returning the exit code of the program */
+typedef int (*ServerJob)(const char *path, const char *output, const RuleSet *rules, const Options *opts, Arena *arena);
+
+/* A compiled rule set, told apart by the name of its file */
+typedef struct ServerRules
+{
+    const char *id;
+    RuleSet rules;
+} ServerRules;
+
+int server_run(const char *path, const ServerRules *sets, size_t count, const Options *opts, unsigned int workers, ServerJob job);
+
+#endif
@@ -0,0 +1,176 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Timings and counters of a run, reported by --stats.
+ */
+
+#define _GNU_SOURCE
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <sys/resource.h>
+#endif
+#include <string.h>
+#include "stats.h"
+#include "scan.h"
+
+static const char *const phaseNames[PHASE_COUNT] = { "headers", "references", "read", "match", "write" };
+
+void stats_init(Stats *s)
+{
+    memset(s, 0, sizeof(Stats));
+}
+
+void tally_add(Tally *t, const Tally *other)
+{
+    t->matches += other->matches;
+    t->replaced += other->replaced;
+    t->skipped += other->skipped;
+}
+
+void stats_add(Stats *s, const Stats *other)
+{
+    int p;
+
+    for (p = 0; p < PHASE_COUNT; p++)
+        s->phases[p] += other->phases[p];
+
+    s->files += other->files;
+    s->sections += other->sections;
+    s->strings += other->strings;
+    s->loaded += other->loaded;
+    s->written += other->written;
+    tally_add(&s->tally, &other->tally);
+}
+
+double stats_now(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER count, frequency;
+
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+
+    return (double)count.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+#endif
+}
+
+void stats_phase(Stats *s, int phase, double start)
+{
+    if (s != NULL)
+        s->phases[phase] += stats_now() - start;
+}
+
+void stats_strings(Stats *s, const char *data, size_t len)
+{
+    size_t i = 0, l;
+
+    if (s == NULL)
+        return;
+
+    /* Count the terminated strings, as they're listed */
+    while (i < len)
+    {
+        i += scan_skip(&data[i], len - i, 0);
+        l = scan_find(&data[i], len - i, 0);
+        if (i + l >= len)
+            break;
+
+        s->strings++;
+        i += l;
+    }
+}
+
+#ifdef __linux__
+
+static void sample_io(Usage *u)
+{
+    char name[16];
+    unsigned long long value;
+    FILE *f;
+
+    /* The bytes and the calls of the reads and writes issued by the process (including the mappings' page-ins) */
+    if ((f = fopen("/proc/self/io", "r")) == NULL)
+        return;
+
+    while (fscanf(f, "%15s %llu", name, &value) == 2)
+    {
+        if (strcmp(name, "rchar:") == 0)
+            u->readBytes = value;
+        else if (strcmp(name, "wchar:") == 0)
+            u->writtenBytes = value;
+        else if (strcmp(name, "syscr:") == 0)
+            u->reads = value;
+        else if (strcmp(name, "syscw:") == 0)
+            u->writes = value;
+    }
+
+    u->io = 1;
+    fclose(f);
+}
+
+#endif
+
+void usage_sample(Usage *u)
+{
+    memset(u, 0, sizeof(Usage));
+    u->time = stats_now();
+
+#ifdef __linux__
+    sample_io(u);
+#endif
+
+#ifndef _WIN32
+    {
+        struct rusage r;
+
+        /* In kilobytes on Linux */
+        if (getrusage(RUSAGE_SELF, &r) == 0)
+            u->peakMemory = r.ru_maxrss;
+    }
+#endif
+}
+
+void stats_print(FILE *f, const Stats *s, const Usage *start, const Usage *end, int json)
+{
+    int p;
+
+    if (json)
+    {
+        fprintf(f, "{\"files\":%lu,\"sections\":%lu,\"wall\":%.6f,\"phases\":{", s->files, s->sections, end->time - start->time);
+        for (p = 0; p < PHASE_COUNT; p++)
+            fprintf(f, "%s\"%s\":%.6f", p > 0 ? "," : "", phaseNames[p], s->phases[p]);
+        fprintf(f, "},\"loaded\":%llu,\"written\":%llu,\"strings\":%lu,\"matches\":%lu,\"replaced\":%lu,\"skipped\":%lu",
+            s->loaded, s->written, s->strings, s->tally.matches, s->tally.replaced, s->tally.skipped);
+        if (end->io)
+            fprintf(f, ",\"readBytes\":%llu,\"writtenBytes\":%llu,\"readCalls\":%llu,\"writeCalls\":%llu",
+                end->readBytes - start->readBytes, end->writtenBytes - start->writtenBytes,
+                end->reads - start->reads, end->writes - start->writes);
+        if (end->peakMemory > 0)
+            fprintf(f, ",\"peakMemory\":%ld", end->peakMemory);
+        fputs("}\n", f);
+        return;
+    }
+
+    fprintf(f, "%lu files, %lu sections in %.3f ms\n", s->files, s->sections, (end->time - start->time) * 1e3);
+    for (p = 0; p < PHASE_COUNT; p++)
+        fprintf(f, "  %-12s %12.3f ms\n", phaseNames[p], s->phases[p] * 1e3);
+    fprintf(f, "  %-12s %12llu bytes\n  %-12s %12llu bytes\n", "loaded", s->loaded, "written", s->written);
+    fprintf(f, "  %-12s %12lu\n  %-12s %12lu\n  %-12s %12lu\n  %-12s %12lu\n",
+        "strings", s->strings, "matches", s->tally.matches, "replaced", s->tally.replaced, "skipped", s->tally.skipped);
+    if (end->io)
+        fprintf(f, "  %-12s %12llu bytes in %llu calls\n  %-12s %12llu bytes in %llu calls\n",
+            "reads", end->readBytes - start->readBytes, end->reads - start->reads,
+            "writes", end->writtenBytes - start->writtenBytes, end->writes - start->writes);
+    if (end->peakMemory > 0)
+        fprintf(f, "  %-12s %12ld KiB\n", "peak memory", end->peakMemory);
+}
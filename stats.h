@@ -0,0 +1,64 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Timings and counters of a run, reported by --stats.
+ */
+
+#ifndef STATS_H_INCLUDED
+#define STATS_H_INCLUDED
+
+#include <stdio.h>
+#include <stddef.h>
+
+#define PHASE_HEADERS 0     /* Parsing of the section table */
+#define PHASE_REFS    1     /* Gathering of the references to the strings */
+#define PHASE_READ    2     /* Loading of the strings tables */
+#define PHASE_MATCH   3     /* Search and replacement */
+#define PHASE_WRITE   4     /* Writing of the output (or of the input back) */
+#define PHASE_COUNT   5
+
+/* What the searches came across */
+typedef struct Tally
+{
+    unsigned long matches;
+    unsigned long replaced;
+    unsigned long skipped;
+} Tally;
+
+/* Gathered for each file, then summed */
+typedef struct Stats
+{
+    double phases[PHASE_COUNT];
+    unsigned long files;
+    unsigned long sections;
+    unsigned long strings;
+    unsigned long long loaded;
+    unsigned long long written;
+    Tally tally;
+} Stats;
+
+/* Counters of the whole process, as reported by the system */
+typedef struct Usage
+{
+    double time;
+    int io;
+    unsigned long long readBytes;
+    unsigned long long writtenBytes;
+    unsigned long long reads;
+    unsigned long long writes;
+    long peakMemory;
+} Usage;
+
+void stats_init(Stats *s);
+void stats_add(Stats *s, const Stats *other);
+void tally_add(Tally *t, const Tally *other);
+
+double stats_now(void);
+void stats_phase(Stats *s, int phase, double start);
+void stats_strings(Stats *s, const char *data, size_t len);
+
+void usage_sample(Usage *u);
+void stats_print(FILE *f, const Stats *s, const Usage *start, const Usage *end, int json);
+
+#endif
@@ -0,0 +1,71 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Index of the strings of a table (their location and the room available for them).
+ */
+
+#include <stdlib.h>
+#include "strindex.h"
+#include "scan.h"
+
+void strindex_init(StringIndex *index)
+{
+    index->spans = NULL;
+    index->count = 0;
+    index->capacity = 0;
+}
+
+void strindex_free(StringIndex *index)
+{
+    free(index->spans);
+    strindex_init(index);
+}
+
+int strindex_push(StringIndex *index, size_t offset, size_t len, size_t available)
+{
+    if (index->count >= index->capacity)
+    {
+        const size_t capacity = index->capacity > 0 ? index->capacity * 2 : 1024;
+        Span *grown;
+
+        if ((grown = realloc(index->spans, capacity * sizeof(Span))) == NULL)
+            return 0;
+
+        index->spans = grown;
+        index->capacity = capacity;
+    }
+
+    index->spans[index->count].offset = offset;
+    index->spans[index->count].len = len;
+    index->spans[index->count].available = available;
+    index->count++;
+
+    return 1;
+}
+
+int strindex_build(StringIndex *index, const char *data, size_t len)
+{
+    size_t i, l, next;
+
+    /* Skip the terminations leading the table */
+    i = scan_skip(data, len, 0);
+
+    while (i < len)
+    {
+        l = scan_find(&data[i], len - i, 0);
+
+        /* An unterminated string isn't indexed */
+        if (i + l >= len)
+            break;
+
+        /* The string may take over its termination and the padding following it, keeping a termination */
+        next = i + l + scan_skip(&data[i + l], len - i - l, 0);
+        if (!strindex_push(index, i, l, next - i - 1))
+            return 0;
+
+        i = next;
+    }
+
+    return 1;
+}
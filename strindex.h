@@ -0,0 +1,34 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Index of the strings of a table (their location and the room available for them).
+ */
+
+#ifndef STRINDEX_H_INCLUDED
+#define STRINDEX_H_INCLUDED
+
+#include <stddef.h>
+
+/* A terminated string of the table */
+typedef struct Span
+{
+    size_t offset;
+    size_t len;
+    size_t available;
+} Span;
+
+typedef struct StringIndex
+{
+    Span *spans;
+    size_t count;
+    size_t capacity;
+} StringIndex;
+
+void strindex_init(StringIndex *index);
+void strindex_free(StringIndex *index);
+
+int strindex_push(StringIndex *index, size_t offset, size_t len, size_t available);
+int strindex_build(StringIndex *index, const char *data, size_t len);
+
+#endif
@@ -0,0 +1,627 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Library altering the strings of executables, for the processes patching many files in a row.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "stringpatch.h"
+#include "elffile.h"
+#include "pefile.h"
+#include "parallel.h"
+#include "relocate.h"
+#include "threads.h"
+#include "scan.h"
+#include "report.h"
+
+#define MAGIC_ELF "\x7f\x45\x4c\x46"
+#define MAGIC_PE "MZ"
+
+
+/* A selected section, kept in memory from its changes until they're committed */
+typedef struct Table
+{
+    const Section *section;
+    Mapping mapping;
+    RangeList dirty;
+} Table;
+
+struct StringPatchRules
+{
+    RuleSet set;
+    int compiled;
+    char error[REPORT_LEN];
+};
+
+struct StringPatch
+{
+    Options opts;
+    char **sections;
+    size_t sectionCount;
+    Arena arena;
+    FILE *file;
+    char *path;
+    SectionTable table;
+    const char *defaultSection;
+    int (*isStrings)(const Section *);
+    Table *tables;
+    size_t tableCount;
+    StringPatchChange *changes;
+    size_t changeCount;
+    size_t changeCapacity;
+    char error[REPORT_LEN];
+};
+
+/* The messages of a call are kept by the handle instead of being printed */
+static void capture_errors(char *error)
+{
+    *error = 0;
+    report_set_thread(report_keep, error);
+}
+
+static int release_errors(char *error, int ret)
+{
+    report_set_thread(NULL, NULL);
+
+    /* A success forgets the messages, a failure always has one */
+    if (ret <= 2)
+        *error = 0;
+    else if (*error == 0)
+        sprintf(error, "Failed with the status %d!", ret);
+
+    return ret;
+}
+
+StringPatchRules *stringpatch_rules_new(void)
+{
+    StringPatchRules *rules;
+
+    if ((rules = malloc(sizeof(StringPatchRules))) == NULL)
+        return NULL;
+
+    rules_init(&rules->set);
+    rules->compiled = 0;
+    rules->error[0] = 0;
+
+    return rules;
+}
+
+void stringpatch_rules_free(StringPatchRules *rules)
+{
+    if (rules == NULL)
+        return;
+
+    rules_free(&rules->set);
+    free(rules);
+}
+
+const char *stringpatch_rules_error(const StringPatchRules *rules)
+{
+    return rules->error;
+}
+
+static int add_rule(StringPatchRules *rules, const char *search, const char *replace)
+{
+    /* The automaton is built once all the rules are known */
+    if (rules->compiled)
+    {
+        report_error("The rules can't be added to once compiled!\n");
+        return 16;
+    }
+
+    return rules_add(&rules->set, search, replace) ? 0 : 16;
+}
+
+int stringpatch_rules_add(StringPatchRules *rules, const char *search, const char *replace)
+{
+    capture_errors(rules->error);
+
+    return release_errors(rules->error, add_rule(rules, search, replace));
+}
+
+static int load_rules(StringPatchRules *rules, const char *path)
+{
+    FILE *f;
+    int ret;
+
+    if (rules->compiled)
+    {
+        report_error("The rules can't be added to once compiled!\n");
+        return 16;
+    }
+
+    if ((f = fopen(path, "rb")) == NULL)
+    {
+        report_error("Failed to open the rules file %s: %s!\n", path, strerror(errno));
+        return 3;
+    }
+
+    ret = rules_load(&rules->set, f) ? 0 : 16;
+    fclose(f);
+
+    return ret;
+}
+
+int stringpatch_rules_load(StringPatchRules *rules, const char *path)
+{
+    capture_errors(rules->error);
+
+    return release_errors(rules->error, load_rules(rules, path));
+}
+
+static int compile_rules(StringPatchRules *rules)
+{
+    if (!rules->compiled)
+    {
+        if (rules->set.count == 0)
+        {
+            report_error("There's no rule to compile!\n");
+            return 16;
+        }
+        if (!rules_compile(&rules->set))
+            return 16;
+        rules->compiled = 1;
+    }
+
+    return 0;
+}
+
+int stringpatch_rules_compile(StringPatchRules *rules)
+{
+    capture_errors(rules->error);
+
+    return release_errors(rules->error, compile_rules(rules));
+}
+
+StringPatch *stringpatch_new(void)
+{
+    StringPatch *sp;
+
+    if ((sp = malloc(sizeof(StringPatch))) == NULL)
+        return NULL;
+
+    /* The scanning kernels are picked for the processor before any thread is started */
+    scan_init();
+
+    /* The same defaults as the program */
+    sp->opts.sections = NULL;
+    sp->opts.sectionCount = 0;
+    sp->opts.allSections = 0;
+    sp->opts.exact = 0;
+    sp->opts.threads = threads_count();
+    sp->opts.listFormat = LISTING_TEXT;
+    sp->opts.cacheDir = NULL;
+    sp->opts.dryRun = 0;
+    sp->opts.relocate = 0;
+    sp->opts.merged = 0;
+    sp->opts.probe = PROBE_NONE;
+    sp->opts.utf16 = 0;
+    sp->opts.journal = 0;
+    sp->opts.atVaddr = 0;
+    sp->opts.vaddr = 0;
+
+    sp->sections = NULL;
+    sp->sectionCount = 0;
+    arena_init(&sp->arena);
+    sp->file = NULL;
+    sp->path = NULL;
+    sections_init(&sp->table);
+    sp->tables = NULL;
+    sp->tableCount = 0;
+    sp->changes = NULL;
+    sp->changeCount = 0;
+    sp->changeCapacity = 0;
+    sp->error[0] = 0;
+
+    return sp;
+}
+
+static void free_sections(StringPatch *sp)
+{
+    size_t i;
+
+    for (i = 0; i < sp->sectionCount; i++)
+        free(sp->sections[i]);
+    free(sp->sections);
+
+    sp->sections = NULL;
+    sp->sectionCount = 0;
+    sp->opts.sections = NULL;
+    sp->opts.sectionCount = 0;
+}
+
+void stringpatch_free(StringPatch *sp)
+{
+    if (sp == NULL)
+        return;
+
+    stringpatch_close(sp);
+    free_sections(sp);
+    arena_free(&sp->arena);
+    free(sp->changes);
+    free(sp);
+}
+
+const char *stringpatch_error(const StringPatch *sp)
+{
+    return sp->error;
+}
+
+void stringpatch_set_exact(StringPatch *sp, int exact)
+{
+    sp->opts.exact = exact;
+}
+
+void stringpatch_set_all_sections(StringPatch *sp, int all)
+{
+    sp->opts.allSections = all;
+}
+
+void stringpatch_set_threads(StringPatch *sp, unsigned int threads)
+{
+    sp->opts.threads = threads > 0 ? threads : 1;
+}
+
+static int select_sections(StringPatch *sp, const char *const *names, size_t count)
+{
+    size_t i;
+
+    free_sections(sp);
+
+    /* The names are kept for every executable opened afterwards */
+    if (count > 0 && (sp->sections = calloc(count, sizeof(char*))) == NULL)
+    {
+        report_error("Failed to allocate memory for the sections: %s!\n", strerror(errno));
+        return 7;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if ((sp->sections[i] = malloc(strlen(names[i]) + 1)) == NULL)
+        {
+            report_error("Failed to allocate memory for the sections: %s!\n", strerror(errno));
+            sp->sectionCount = count;
+            free_sections(sp);
+            return 7;
+        }
+        strcpy(sp->sections[i], names[i]);
+    }
+
+    sp->sectionCount = count;
+    sp->opts.sections = (const char *const *)sp->sections;
+    sp->opts.sectionCount = count;
+
+    return 0;
+}
+
+int stringpatch_set_sections(StringPatch *sp, const char *const *names, size_t count)
+{
+    capture_errors(sp->error);
+
+    return release_errors(sp->error, select_sections(sp, names, count));
+}
+
+static int open_executable(StringPatch *sp, const char *path)
+{
+    const Section **selected;
+    char magic[4];
+    size_t count, i;
+    int ret;
+
+    stringpatch_close(sp);
+
+    if ((sp->file = fopen(path, "rb")) == NULL)
+    {
+        report_error("Failed to open the input file %s: %s!\n", path, strerror(errno));
+        return 3;
+    }
+
+    /* Determine the type of executable using the magic number */
+    memset(magic, 0, sizeof(magic));
+    fread(magic, sizeof(char), 4, sp->file);
+
+    if (strncmp(magic, MAGIC_ELF, sizeof(MAGIC_ELF)-1) == 0)
+    {
+        sp->defaultSection = ELF_DEFAULT_SECTION;
+        sp->isStrings = elf_is_strings;
+        ret = elf_read_table(sp->file, &sp->table, &sp->arena);
+    }
+    else if (strncmp(magic, MAGIC_PE, sizeof(MAGIC_PE)-1) == 0)
+    {
+        sp->defaultSection = PE_DEFAULT_SECTION;
+        sp->isStrings = pe_is_strings;
+        ret = pe_read_table(sp->file, &sp->table, &sp->arena);
+    }
+    else
+    {
+        report_error("Executable format unrecognized: %2X%2X%2X%2X!\n", magic[0], magic[1], magic[2], magic[3]);
+        ret = 4;
+    }
+
+    if (ret != 0)
+        goto RET;
+
+    /* Everything about the executable is allocated from the arena, released at once when it's closed */
+    selected = arena_alloc(&sp->arena, (sp->table.count + sp->opts.sectionCount + 1) * sizeof(const Section*));
+    sp->path = arena_alloc(&sp->arena, strlen(path) + 1);
+    if (selected == NULL || sp->path == NULL)
+    {
+        report_error("Failed to allocate memory for the sections: %s!\n", strerror(errno));
+        ret = 7; goto RET;
+    }
+    strcpy(sp->path, path);
+
+    if ((ret = process_select(&sp->table, sp->defaultSection, sp->isStrings, &sp->opts, selected, &count)) != 0)
+        goto RET;
+
+    if ((sp->tables = arena_alloc(&sp->arena, (count > 0 ? count : 1) * sizeof(Table))) == NULL)
+    {
+        report_error("Failed to allocate memory for the sections: %s!\n", strerror(errno));
+        ret = 7; goto RET;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        sp->tables[i].section = selected[i];
+        sp->tables[i].mapping.data = NULL;
+        ranges_init(&sp->tables[i].dirty);
+    }
+    sp->tableCount = count;
+
+  RET:
+
+    if (ret != 0)
+        stringpatch_close(sp);
+
+    return ret;
+}
+
+int stringpatch_open(StringPatch *sp, const char *path)
+{
+    capture_errors(sp->error);
+
+    return release_errors(sp->error, open_executable(sp, path));
+}
+
+void stringpatch_close(StringPatch *sp)
+{
+    size_t i;
+
+    /* The strings tables are only written by a commit */
+    for (i = 0; i < sp->tableCount; i++)
+    {
+        if (sp->tables[i].mapping.data != NULL)
+            mapping_close(&sp->tables[i].mapping, &sp->tables[i].dirty);
+        ranges_free(&sp->tables[i].dirty);
+    }
+
+    if (sp->file != NULL)
+        fclose(sp->file);
+
+    sp->file = NULL;
+    sp->path = NULL;
+    sections_init(&sp->table);
+    sp->tables = NULL;
+    sp->tableCount = 0;
+    sp->changeCount = 0;
+    arena_reset(&sp->arena);
+}
+
+size_t stringpatch_section_count(const StringPatch *sp)
+{
+    return sp->table.count;
+}
+
+int stringpatch_section(const StringPatch *sp, size_t i, StringPatchSection *section)
+{
+    const Section *s;
+
+    if (i >= sp->table.count)
+        return 0;
+
+    s = &sp->table.sections[i];
+    section->name = s->name;
+    section->offset = s->offset;
+    section->size = s->size;
+    section->address = s->address;
+    section->strings = sp->isStrings(s);
+
+    return 1;
+}
+
+static char *copy_string(Arena *arena, const char *str, size_t len)
+{
+    char *copy;
+
+    if ((copy = arena_alloc(arena, len + 1)) == NULL)
+        return NULL;
+
+    memcpy(copy, str, len);
+    copy[len] = 0;
+
+    return copy;
+}
+
+static int record_change(StringPatch *sp, const Section *s, const char *data, const Change *change)
+{
+    StringPatchChange *c;
+
+    if (sp->changeCount >= sp->changeCapacity)
+    {
+        const size_t capacity = sp->changeCapacity > 0 ? sp->changeCapacity * 2 : 64;
+        StringPatchChange *grown;
+
+        if ((grown = realloc(sp->changes, capacity * sizeof(StringPatchChange))) == NULL)
+            return 0;
+
+        sp->changes = grown;
+        sp->changeCapacity = capacity;
+    }
+
+    /* The strings are copied, the table being modified afterwards */
+    c = &sp->changes[sp->changeCount];
+    c->section = s->name;
+    c->offset = s->offset + (long)change->offset;
+    c->len = change->oldLen;
+    c->replacementLen = change->newLen;
+    c->available = change->available;
+    c->applied = change->newLen <= change->available;
+    if ((c->string = copy_string(&sp->arena, &data[change->offset], change->oldLen)) == NULL ||
+        (c->replacement = copy_string(&sp->arena, change->replacement, change->newLen)) == NULL)
+        return 0;
+
+    sp->changeCount++;
+
+    return 1;
+}
+
+static int apply_rules(StringPatch *sp, const StringPatchRules *rules)
+{
+    RefList none;
+    Plan plan;
+    size_t i, c;
+    int ret = 0, status = 1;
+
+    if (sp->file == NULL)
+    {
+        report_error("No executable is open!\n");
+        return 12;
+    }
+
+    if (rules == NULL || !rules->compiled)
+    {
+        report_error("The rules must be compiled before being applied!\n");
+        return 16;
+    }
+
+    refs_init(&none);
+
+    for (i = 0; i < sp->tableCount && ret == 0; i++)
+    {
+        Table *t = &sp->tables[i];
+        const Section *s = t->section;
+        int r;
+
+        /* Load the strings table in memory, privately until the changes are committed */
+        if (t->mapping.data == NULL && !mapping_open(&t->mapping, sp->file, s->offset, s->size, MAPPING_PRIVATE))
+        {
+            ret = 13;
+            break;
+        }
+
+        /* Plan the changes so they're known, then write those which fit into the table */
+        plan_init(&plan);
+        r = parallel_replace(t->mapping.data, &rules->set, s->size, sp->opts.exact, sp->opts.threads, &t->dirty, &plan, &sp->arena, NULL);
+        if (r > 2)
+            ret = r;
+
+        for (c = 0; c < plan.count && ret == 0; c++)
+        {
+            if (!record_change(sp, s, t->mapping.data, &plan.changes[c]))
+            {
+                report_error("Failed to allocate memory for the changes: %s!\n", strerror(errno));
+                ret = 7;
+            }
+        }
+
+        if (ret == 0 && plan.count > 0 && relocate_plan(t->mapping.data, s, &plan, &none, 0, NULL, &t->dirty, NULL) == 2)
+            r = 2;
+        plan_free(&plan);
+
+        /* Keep the worst outcome among the sections */
+        if (r == 2 || (r == 0 && status == 1))
+            status = r;
+    }
+
+    return ret != 0 ? ret : status;
+}
+
+int stringpatch_apply(StringPatch *sp, const StringPatchRules *rules)
+{
+    capture_errors(sp->error);
+
+    return release_errors(sp->error, apply_rules(sp, rules));
+}
+
+static int commit_changes(StringPatch *sp, const char *output)
+{
+    FILE *f;
+    size_t i;
+    int ret = 0;
+
+    if (sp->file == NULL)
+    {
+        report_error("No executable is open!\n");
+        return 12;
+    }
+
+    /* Write into a copy of the executable, or into the executable itself */
+    if (output != NULL)
+    {
+        if (strcmp(sp->path, output) == 0)
+        {
+            report_error("The input and the output can't be the same!\n");
+            return 12;
+        }
+
+        if ((f = fopen(output, "wb")) == NULL)
+        {
+            report_error("Failed to open the output file: %s!\n", strerror(errno));
+            return 3;
+        }
+
+        if (!file_clone(sp->file, f))
+            ret = 14;
+    }
+    else if ((f = fopen(sp->path, "rb+")) == NULL)
+    {
+        report_error("Failed to open the input file %s: %s!\n", sp->path, strerror(errno));
+        return 3;
+    }
+
+    /* Overwrite the modified strings only */
+    for (i = 0; i < sp->tableCount && ret == 0; i++)
+    {
+        const Table *t = &sp->tables[i];
+
+        if (t->mapping.data != NULL && !file_write_ranges(f, t->section->offset, t->mapping.data, t->section->size, &t->dirty))
+        {
+            report_error("Failed to write to the %s file: %s!\n", output != NULL ? "output" : "input", strerror(errno));
+            ret = output != NULL ? 14 : 15;
+        }
+    }
+
+    if (fclose(f) != 0 && ret == 0)
+    {
+        report_error("Failed to write to the %s file: %s!\n", output != NULL ? "output" : "input", strerror(errno));
+        ret = output != NULL ? 14 : 15;
+    }
+
+    return ret;
+}
+
+int stringpatch_commit(StringPatch *sp, const char *output)
+{
+    capture_errors(sp->error);
+
+    return release_errors(sp->error, commit_changes(sp, output));
+}
+
+size_t stringpatch_change_count(const StringPatch *sp)
+{
+    return sp->changeCount;
+}
+
+int stringpatch_change(const StringPatch *sp, size_t i, StringPatchChange *change)
+{
+    if (i >= sp->changeCount)
+        return 0;
+
+    *change = sp->changes[i];
+
+    return 1;
+}
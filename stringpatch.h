@@ -0,0 +1,83 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Library altering the strings of executables, for the processes patching many files in a row.
+ */
+
+#ifndef STRINGPATCH_H_INCLUDED
+#define STRINGPATCH_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * The functions return the same status as the program: 0 on success, 1 if no string was found, 2 if some replacements
+ * didn't fit, and an error code otherwise, the failure being described by stringpatch_error (or stringpatch_rules_error)
+ * until the next call on the same handle. Nothing is printed, on the standard output nor on the standard error.
+ */
+
+typedef struct StringPatch StringPatch;
+typedef struct StringPatchRules StringPatchRules;
+
+/* A section of the open executable */
+typedef struct StringPatchSection
+{
+    const char *name;
+    long offset;
+    size_t size;
+    uint64_t address;
+    int strings;                /* Searched in by the default selection of --all-string-sections */
+} StringPatchSection;
+
+/* A string found by the rules, valid until the executable is closed */
+typedef struct StringPatchChange
+{
+    const char *section;
+    long offset;                /* In the file */
+    const char *string;         /* Before the change (terminated) */
+    size_t len;
+    const char *replacement;    /* Terminated as well */
+    size_t replacementLen;
+    size_t available;           /* Room for the replacement, without its termination */
+    int applied;                /* Whether it fit */
+} StringPatchChange;
+
+/* The rules are compiled once, then applied to any number of executables */
+StringPatchRules *stringpatch_rules_new(void);
+void stringpatch_rules_free(StringPatchRules *rules);
+
+int stringpatch_rules_add(StringPatchRules *rules, const char *search, const char *replace);
+int stringpatch_rules_load(StringPatchRules *rules, const char *path);
+int stringpatch_rules_compile(StringPatchRules *rules);
+
+/* The message of the failure of the last call on the rules, empty if it succeeded */
+const char *stringpatch_rules_error(const StringPatchRules *rules);
+
+/* A handle opens one executable at a time, its memory being reused by the next one
+   (the first handle sets the scanning up for the processor, it must be created before any other thread uses the library) */
+StringPatch *stringpatch_new(void);
+void stringpatch_free(StringPatch *sp);
+
+void stringpatch_set_exact(StringPatch *sp, int exact);
+void stringpatch_set_all_sections(StringPatch *sp, int all);
+void stringpatch_set_threads(StringPatch *sp, unsigned int threads);
+int stringpatch_set_sections(StringPatch *sp, const char *const *names, size_t count);
+
+int stringpatch_open(StringPatch *sp, const char *path);
+void stringpatch_close(StringPatch *sp);
+
+size_t stringpatch_section_count(const StringPatch *sp);
+int stringpatch_section(const StringPatch *sp, size_t i, StringPatchSection *section);
+
+/* The changes are made in memory, then written to the executable (or a copy of it when an output is given) */
+int stringpatch_apply(StringPatch *sp, const StringPatchRules *rules);
+int stringpatch_commit(StringPatch *sp, const char *output);
+
+size_t stringpatch_change_count(const StringPatch *sp);
+int stringpatch_change(const StringPatch *sp, size_t i, StringPatchChange *change);
+
+/* The message of the failure of the last call on the handle, empty if it succeeded */
+const char *stringpatch_error(const StringPatch *sp);
+
+#endif
@@ -0,0 +1,218 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Minimal portable threading (POSIX threads or Windows threads).
+ */
+
+#define _GNU_SOURCE
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#include <stdlib.h>
+#include "threads.h"
+
+/* A function to call with its argument */
+typedef struct Job
+{
+    void (*func)(void *);
+    void *arg;
+} Job;
+
+#ifdef _WIN32
+
+typedef HANDLE Thread;
+typedef CRITICAL_SECTION Mutex;
+
+#define mutex_init(m)    InitializeCriticalSection(m)
+#define mutex_lock(m)    EnterCriticalSection(m)
+#define mutex_unlock(m)  LeaveCriticalSection(m)
+#define mutex_destroy(m) DeleteCriticalSection(m)
+
+static DWORD WINAPI thread_main(LPVOID arg)
+{
+    const Job *job = arg;
+    job->func(job->arg);
+    return 0;
+}
+
+static int thread_start(Thread *t, Job *job)
+{
+    return (*t = CreateThread(NULL, 0, thread_main, job, 0, NULL)) != NULL;
+}
+
+static void thread_join(Thread t)
+{
+    WaitForSingleObject(t, INFINITE);
+    CloseHandle(t);
+}
+
+unsigned int threads_count(void)
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+}
+
+#else
+
+typedef pthread_t Thread;
+typedef pthread_mutex_t Mutex;
+
+#define mutex_init(m)    pthread_mutex_init(m, NULL)
+#define mutex_lock(m)    pthread_mutex_lock(m)
+#define mutex_unlock(m)  pthread_mutex_unlock(m)
+#define mutex_destroy(m) pthread_mutex_destroy(m)
+
+static void *thread_main(void *arg)
+{
+    const Job *job = arg;
+    job->func(job->arg);
+    return NULL;
+}
+
+static int thread_start(Thread *t, Job *job)
+{
+    return pthread_create(t, NULL, thread_main, job) == 0;
+}
+
+static void thread_join(Thread t)
+{
+    pthread_join(t, NULL);
+}
+
+unsigned int threads_count(void)
+{
+    const long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (unsigned int)n : 1;
+}
+
+#endif
+
+/* Items shared by the workers of a pool, handed out one at a time */
+typedef struct Pool
+{
+    void (*func)(void *, unsigned int);
+    char *items;
+    size_t itemSize;
+    size_t count;
+    size_t next;
+    Mutex lock;
+} Pool;
+
+/* A worker of a pool, told apart by its index (e.g. to keep its own memory) */
+typedef struct Worker
+{
+    Pool *pool;
+    unsigned int index;
+} Worker;
+
+void threads_run(void (*func)(void *), void *items, size_t itemSize, size_t count)
+{
+    Thread *threads = NULL;
+    Job *jobs = NULL;
+    int *started = NULL;
+    size_t i;
+
+    if (count > 1)
+    {
+        threads = malloc(count * sizeof(Thread));
+        jobs = malloc(count * sizeof(Job));
+        started = calloc(count, sizeof(int));
+    }
+
+    /* Without memory, run everything on the current thread */
+    if (threads == NULL || jobs == NULL || started == NULL)
+    {
+        for (i = 0; i < count; i++)
+            func((char*)items + i * itemSize);
+
+        free(threads);
+        free(jobs);
+        free(started);
+        return;
+    }
+
+    /* The first item is processed by the current thread, meanwhile */
+    for (i = 1; i < count; i++)
+    {
+        jobs[i].func = func;
+        jobs[i].arg = (char*)items + i * itemSize;
+        started[i] = thread_start(&threads[i], &jobs[i]);
+    }
+
+    func(items);
+
+    for (i = 1; i < count; i++)
+    {
+        if (started[i])
+            thread_join(threads[i]);
+        else
+            func(jobs[i].arg);
+    }
+
+    free(threads);
+    free(jobs);
+    free(started);
+}
+
+static void pool_worker(void *arg)
+{
+    const Worker *worker = arg;
+    Pool *pool = worker->pool;
+    size_t i;
+
+    for (;;)
+    {
+        /* Take the next pending item */
+        mutex_lock(&pool->lock);
+        i = pool->next < pool->count ? pool->next++ : pool->count;
+        mutex_unlock(&pool->lock);
+
+        if (i >= pool->count)
+            break;
+
+        pool->func(pool->items + i * pool->itemSize, worker->index);
+    }
+}
+
+void threads_pool(void (*func)(void *, unsigned int), void *items, size_t itemSize, size_t count, unsigned int threads)
+{
+    Pool pool;
+    Worker *workers;
+    size_t i, n = threads < count ? threads : count;
+
+    pool.func = func;
+    pool.items = items;
+    pool.itemSize = itemSize;
+    pool.count = count;
+    pool.next = 0;
+    mutex_init(&pool.lock);
+
+    /* Every worker shares the same pool, picking the items as soon as it's free */
+    if (n > 1 && (workers = malloc(n * sizeof(Worker))) != NULL)
+    {
+        for (i = 0; i < n; i++)
+        {
+            workers[i].pool = &pool;
+            workers[i].index = (unsigned int)i;
+        }
+
+        threads_run(pool_worker, workers, sizeof(Worker), n);
+        free(workers);
+    }
+    else
+    {
+        Worker self;
+
+        self.pool = &pool;
+        self.index = 0;
+        pool_worker(&self);
+    }
+
+    mutex_destroy(&pool.lock);
+}
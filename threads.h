@@ -0,0 +1,18 @@
+/*
+ * Author: Matthieu Carteron <rubisetcie@gmail.com>
+ * date:   2026-10-14
+ *
+ * Minimal portable threading (POSIX threads or Windows threads).
+ */
+
+#ifndef THREADS_H_INCLUDED
+#define THREADS_H_INCLUDED
+
+#include <stddef.h>
+
+unsigned int threads_count(void);
+
+void threads_run(void (*func)(void *), void *items, size_t itemSize, size_t count);
+void threads_pool(void (*func)(void *, unsigned int), void *items, size_t itemSize, size_t count, unsigned int threads);
+
+#endif